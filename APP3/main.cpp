@@ -11,10 +11,21 @@
 #include "utils/shader.hpp"
 #include "utils/rendering.hpp"
 #include "utils/lights.hpp"
+#include "utils/light_registry.hpp"
+#include "utils/animation.hpp"
 #include "utils/material.hpp"
 #include "utils/material_manager.hpp"
 #include "utils/material_setup.hpp"
 #include "utils/object_setup.hpp"
+#include "utils/bvh.hpp"
+#include "utils/portal_visibility.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/frame_uniforms.hpp"
+#include "utils/shadow.hpp"
+#include "utils/shadow_atlas.hpp"
+#include "utils/light_clusters.hpp"
+#include "utils/gbuffer.hpp"
+#include "utils/transparency.hpp"
 
 #include <src/stb_image.h>
 
@@ -34,12 +45,36 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/glm.hpp> // For vector calculations
 #include <algorithm>
+#include <numeric>
+#include <cmath>
 
 using namespace glimac;
 
 int main(int argc, char *argv[])
 {
-    (void)argc;
+    // Renderer of room 1, forward unless --deferred is given
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--deferred")
+        {
+            deferredShading = true;
+        }
+        else if (std::string(argv[i]) == "--forward")
+        {
+            deferredShading = false;
+        }
+        else if (std::string(argv[i]) == "--oit")
+        {
+            // Weighted blended transparency instead of the sorted transparent passes
+            weightedTransparency = true;
+        }
+        else if (std::string(argv[i]) == "--benchmark-animation")
+        {
+            // Times the animation kernels over 10k entities, no window is opened
+            utils_animation::runAnimationBenchmark(10000);
+            return EXIT_SUCCESS;
+        }
+    }
 
     auto windowManager = utils_init::initOpenGL(window_width, window_height);
 
@@ -84,15 +119,23 @@ int main(int argc, char *argv[])
         applicationPath.dirPath() + "APP3/shaders/room1.vs.glsl",
         applicationPath.dirPath() + "APP3/shaders/room1.fs.glsl");
 
-    // room 2 is to be acticaved when camera position is in the second room, i.e., x > 20.5, no condition on z or y
+    // room 2 is to be activated when the camera is in the room2 cell, its objects seen from room 1 through the doorway use it too
+    // its geometry stage emits the per-channel copies of the transparent objects from one draw
     utils_loader::Shader room2(
         applicationPath.dirPath() + "APP3/shaders/room2.vs.glsl",
+        applicationPath.dirPath() + "APP3/shaders/room2.gs.glsl",
         applicationPath.dirPath() + "APP3/shaders/room2.fs.glsl");
 
     utils_loader::Shader depthShader(
         applicationPath.dirPath() + "APP3/shaders/point_shadow_depth.vs.glsl",
         applicationPath.dirPath() + "APP3/shaders/point_shadow_depth.fs.glsl");
 
+    // layered depth shader, writes every cube map face in one pass
+    utils_loader::Shader layeredDepthShader(
+        applicationPath.dirPath() + "APP3/shaders/point_shadow_depth_layered.vs.glsl",
+        applicationPath.dirPath() + "APP3/shaders/point_shadow_depth_layered.gs.glsl",
+        applicationPath.dirPath() + "APP3/shaders/point_shadow_depth.fs.glsl");
+
     // skybox shader
     utils_loader::Shader skyboxShader(
         applicationPath.dirPath() + "APP3/shaders/skybox.vs.glsl",
@@ -103,8 +146,23 @@ int main(int argc, char *argv[])
         applicationPath.dirPath() + "APP3/shaders/light.vs.glsl",
         applicationPath.dirPath() + "APP3/shaders/light.fs.glsl");
 
+    // deferred path of room 1: G-buffer pass, then one full-screen lighting pass
+    utils_loader::Shader gbufferShader(
+        applicationPath.dirPath() + "APP3/shaders/room1.vs.glsl",
+        applicationPath.dirPath() + "APP3/shaders/deferred_gbuffer.fs.glsl");
+
+    utils_loader::Shader deferredLightingShader(
+        applicationPath.dirPath() + "APP3/shaders/deferred_lighting.vs.glsl",
+        applicationPath.dirPath() + "APP3/shaders/deferred_lighting.fs.glsl");
+
+    // weighted blended transparency: averages the accumulated transparent colors over the frame
+    utils_loader::Shader transparencyCompositeShader(
+        applicationPath.dirPath() + "APP3/shaders/deferred_lighting.vs.glsl",
+        applicationPath.dirPath() + "APP3/shaders/oit_composite.fs.glsl");
+
     // Check shaders
-    if (room1.getID() == 0 || room2.getID() == 0 || depthShader.getID() == 0 || skyboxShader.getID() == 0)
+    if (room1.getID() == 0 || room2.getID() == 0 || depthShader.getID() == 0 || layeredDepthShader.getID() == 0 || skyboxShader.getID() == 0
+        || gbufferShader.getID() == 0 || deferredLightingShader.getID() == 0 || transparencyCompositeShader.getID() == 0)
     {
         std::cerr << "Failed to compile/link one or more shaders. Exiting." << std::endl;
         return -1;
@@ -227,8 +285,47 @@ int main(int argc, char *argv[])
         GLuint skyboxTextureID = selectedSkyboxTextures[0];
     }
 
-    GLuint depthCubeMap, shadowMapFBO;
-    utils_loader::setupDepthCubeMap(depthCubeMap, shadowMapFBO);
+    // Static casters are rendered once into their own cube map and copied into depthCubeMap every frame
+    // The exponential filter also renders exp(c * depth) into momentCubeMap, sampled instead of depthCubeMap
+    GLuint depthCubeMap = 0, momentCubeMap = 0, shadowMapFBO = 0;
+    utils_shadow::StaticShadowCache staticShadows;
+    staticShadows.setSchedule(shadowFacesPerFrame, shadowCameraFacesFirst ? utils_shadow::ShadowUpdateOrder::CameraFirst : utils_shadow::ShadowUpdateOrder::RoundRobin);
+    utils_shadow::allocateShadowMaps(utils_shadow::SHADOW_TIERS[shadowTier], depthCubeMap, momentCubeMap, shadowMapFBO, staticShadows);
+
+    // Face matrices of the layered shadow pass
+    utils_shadow::ShadowMatrixBuffer shadowMatrices;
+    shadowMatrices.create();
+
+    // Shadow atlas of the additional lights
+    utils_shadow::ShadowAtlas shadowAtlas;
+    shadowAtlas.create();
+
+    // Froxel light lists of the additional lights
+    utils_light::LightClusters lightClusters;
+    lightClusters.create();
+
+    // Targets of the deferred path, only allocated when it is used
+    utils_scene::GBuffer gbuffer;
+    if (deferredShading)
+    {
+        gbuffer.create(window_width, window_height);
+    }
+    std::cout << "Room 1 renderer: " << (deferredShading ? "deferred" : "forward") << std::endl;
+
+    // Targets of the weighted transparency path, only allocated when it is used
+    utils_scene::WeightedTransparency transparencyTargets;
+    if (weightedTransparency)
+    {
+        transparencyTargets.create(window_width, window_height);
+        transparencyCompositeShader.use();
+        glUniform1i(transparencyCompositeShader.getUniformLocation("uAccumulation"), utils_scene::TRANSPARENCY_FIRST_UNIT);
+        glUniform1i(transparencyCompositeShader.getUniformLocation("uWeights"), utils_scene::TRANSPARENCY_FIRST_UNIT + 1);
+    }
+    std::cout << "Transparency: " << (weightedTransparency ? "weighted blended" : "sorted") << std::endl;
+
+    // Cube faces each caster overlaps, and the resulting draws per face
+    std::vector<unsigned char> shadowFaceMasks;
+    utils_shadow::ShadowFaceStats shadowStats;
 
     // Check depth shader uniforms
     std::cout << "Checking depth shader uniforms..." << std::endl;
@@ -260,8 +357,6 @@ int main(int argc, char *argv[])
     GLint uKdLocation = glGetUniformLocation(room1.getGLId(), "uKd");
     GLint uKsLocation = glGetUniformLocation(room1.getGLId(), "uKs");
     GLint uShininessLocation = glGetUniformLocation(room1.getGLId(), "uShininess");
-    GLint uLightPos_vsLocation = glGetUniformLocation(room1.getGLId(), "uLightPos_vs");
-    GLint uLightIntensityLocation = glGetUniformLocation(room1.getGLId(), "uLightIntensity");
 
     // Sanity check
     if (uMVPMatrixLocation == -1)
@@ -282,8 +377,6 @@ int main(int argc, char *argv[])
         std::cerr << "Failed to get 'uShininess' location" << std::endl;
     // if (uLightDir_vsLocation == -1)
     //     std::cerr << "Failed to get 'uLightDir_vs' location" << std::endl;
-    if (uLightIntensityLocation == -1)
-        std::cerr << "Failed to get 'uLightIntensity' location" << std::endl;
 
     // Retrieve uniform locations for room2
     room2.use();
@@ -299,8 +392,6 @@ int main(int argc, char *argv[])
     GLint room2_uKdLocation = glGetUniformLocation(room2.getGLId(), "uKd");
     GLint room2_uKsLocation = glGetUniformLocation(room2.getGLId(), "uKs");
     GLint room2_uShininessLocation = glGetUniformLocation(room2.getGLId(), "uShininess");
-    GLint room2_uLightPos_vsLocation = glGetUniformLocation(room2.getGLId(), "uLightPos_vs");
-    GLint room2_uLightIntensityLocation = glGetUniformLocation(room2.getGLId(), "uLightIntensity");
     GLint room2_uColorMaskLocation = glGetUniformLocation(room2.getGLId(), "uColorMask");
 
     // Sanity check for room2 uniforms
@@ -320,28 +411,78 @@ int main(int argc, char *argv[])
         std::cerr << "Failed to get 'uKs' location in room2 shader" << std::endl;
     if (room2_uShininessLocation == -1)
         std::cerr << "Failed to get 'uShininess' location in room2 shader" << std::endl;
-    if (room2_uLightIntensityLocation == -1)
-        std::cerr << "Failed to get 'uLightIntensity' location in room2 shader" << std::endl;
     if (room2_uColorMaskLocation == -1)
         std::cerr << "Failed to get 'uColorMask' location in room2 shader" << std::endl;
 
-    room1.use(); // Activate room1 shader program
+    // Frame and light data of both room shaders live in one uniform buffer
+    utils_loader::FrameUniformBuffer frameUniforms;
+    frameUniforms.create(MAX_ADDITIONAL_LIGHTS);
 
-    // Assign sampler uniforms to texture units
-    glUniform1i(glGetUniformLocation(room1.getID(), "uTexture"), 0);
-    glUniform1i(glGetUniformLocation(room1.getID(), "uSpecularMap"), 3);
-    glUniform1i(glGetUniformLocation(room1.getID(), "uNormalMap"), 2);
-    glUniform1i(glGetUniformLocation(room1.getID(), "depthMap"), 1);
-
-    room1.use(); // Unbind the shader program
+    // Shadow filter of the room shaders, compiled in, so switching to a tier with another filter rebuilds them
+    std::string activeShadowDefines;
+    auto applyShadowFilter = [&](const utils_shadow::ShadowTier &tier) -> bool
+    {
+        std::string defines = utils_shadow::shadowFilterDefines(tier);
+        if (defines == activeShadowDefines)
+        {
+            return true;
+        }
+        bool reloaded = room1.reload(defines) && room2.reload(defines) && depthShader.reload(defines) && layeredDepthShader.reload(defines)
+                        && deferredLightingShader.reload(defines);
+        activeShadowDefines = defines;
+
+        // Assign sampler uniforms to texture units
+        room1.use();
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::Texture), 0);
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::SpecularMap), 3);
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::NormalMap), 2);
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::DepthMap), 1);
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::ShadowAtlas), 4);
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::ClusterGrid), 5);
+        glUniform1i(room1.getUniformLocation(utils_loader::Uniform::ClusterLights), 6);
+
+        room2.use();
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::Texture), 0);
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::SpecularMap), 3);
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::NormalMap), 2);
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::DepthMap), 1);
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::ShadowAtlas), 4);
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::ClusterGrid), 5);
+        glUniform1i(room2.getUniformLocation(utils_loader::Uniform::ClusterLights), 6);
+
+        deferredLightingShader.use();
+        glUniform1i(deferredLightingShader.getUniformLocation(utils_loader::Uniform::DepthMap), 1);
+        glUniform1i(deferredLightingShader.getUniformLocation(utils_loader::Uniform::ShadowAtlas), 4);
+        glUniform1i(deferredLightingShader.getUniformLocation(utils_loader::Uniform::ClusterGrid), 5);
+        glUniform1i(deferredLightingShader.getUniformLocation(utils_loader::Uniform::ClusterLights), 6);
+        glUniform1i(deferredLightingShader.getUniformLocation("uGAlbedo"), utils_scene::GBUFFER_FIRST_UNIT + static_cast<int>(utils_scene::GBufferTarget::Albedo));
+        glUniform1i(deferredLightingShader.getUniformLocation("uGSurface"), utils_scene::GBUFFER_FIRST_UNIT + static_cast<int>(utils_scene::GBufferTarget::Surface));
+        glUniform1i(deferredLightingShader.getUniformLocation("uGNormal"), utils_scene::GBUFFER_FIRST_UNIT + static_cast<int>(utils_scene::GBufferTarget::Normal));
+        glUniform1i(deferredLightingShader.getUniformLocation("uGSpecular"), utils_scene::GBUFFER_FIRST_UNIT + static_cast<int>(utils_scene::GBufferTarget::Specular));
+        glUniform1i(deferredLightingShader.getUniformLocation("uGDepth"), utils_scene::GBUFFER_FIRST_UNIT + static_cast<int>(utils_scene::GBufferTarget::Count));
+
+        utils_loader::FrameUniformBuffer::bindBlocks(room1);
+        utils_loader::FrameUniformBuffer::bindBlocks(room2);
+        utils_loader::FrameUniformBuffer::bindBlocks(deferredLightingShader);
+        utils_shadow::ShadowAtlas::bindBlock(room1);
+        utils_shadow::ShadowAtlas::bindBlock(room2);
+        utils_shadow::ShadowAtlas::bindBlock(deferredLightingShader);
+        utils_shadow::ShadowMatrixBuffer::bindBlock(layeredDepthShader);
+        return reloaded;
+    };
+    if (!applyShadowFilter(utils_shadow::SHADOW_TIERS[shadowTier]))
+    {
+        std::cerr << "Failed to compile the shaders of the shadow filter. Exiting." << std::endl;
+        return -1;
+    }
 
-    // Repeat for room2 shader if necessary
-    room2.use();
-    glUniform1i(glGetUniformLocation(room2.getID(), "uTexture"), 0);
-    glUniform1i(glGetUniformLocation(room2.getID(), "uSpecularMap"), 3);
-    glUniform1i(glGetUniformLocation(room2.getID(), "uNormalMap"), 2);
-    glUniform1i(glGetUniformLocation(room2.getID(), "depthMap"), 1);
-    room2.use(); // Unbind the shader program
+    // The G-buffer pass samples the material maps on the units of the room shaders
+    gbufferShader.use();
+    glUniform1i(gbufferShader.getUniformLocation(utils_loader::Uniform::Texture), 0);
+    glUniform1i(gbufferShader.getUniformLocation(utils_loader::Uniform::NormalMap), 2);
+    glUniform1i(gbufferShader.getUniformLocation(utils_loader::Uniform::SpecularMap), 3);
+    utils_light::ObjectLightLists opaqueLightLists, transparentLightLists;
+    utils_loader::ObjectLightUniforms objectLights;
 
     // Set up skybox shader
     skyboxShader.use();
@@ -637,50 +778,40 @@ int main(int argc, char *argv[])
         true                                                 // Is static
     );
 
-    // add a std::vector of simple point lights from namespace utils_light
-    std::vector<utils_light::SimplePointLight> simpleLights;
-
-    std::vector<std::shared_ptr<utils_light::SimplePointLight>> sharedSimpleLights;
-
-    for (auto& light : simpleLights) {
-        sharedSimpleLights.push_back(std::make_shared<utils_light::SimplePointLight>(light));
-    }
+    // add a registry of simple point lights from namespace utils_light, lights are addressed by their handles
+    utils_light::LightRegistry lightRegistry;
+    lightRegistry.reserve(MAX_ADDITIONAL_LIGHTS);
 
     // Add a simple point light to the scene
-    // int newLightID = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID = lightRegistry.add(
     //     glm::vec3(5.0f, 2.5f, 15.0f), // position
     //     glm::vec3(1.0f, 1.0f, 1.0f),  // color
     //     1.8f                          // intensity
     // );
 
     // // // Add a simple point light to the scene 2
-    // int newLightID2 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID2 = lightRegistry.add(
     //     glm::vec3(5.0f, 1.0f, 19.0f), // position
     //     glm::vec3(0.3f, 0.4f, 1.0f),  // color
     //     1.8f                          // intensity
     // );
 
     // // light pos 32 2 11
-    // int newLightID3 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID3 = lightRegistry.add(
     //     glm::vec3(32.0f, 2.0f, 19.0f), // position
     //     glm::vec3(1.0f, 0.0f, 1.0f),   // color
     //     1.8f                           // intensity
     // );
 
     // // light pos 32 2 13
-    // int newLightID4 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID4 = lightRegistry.add(
     //     glm::vec3(37.0f, 2.0f, 13.0f), // position
     //     glm::vec3(1.0f, 1.0f, 1.0f),   // color
     //     1.8f                           // intensity
     // );
 
     // // pos 10 1 10
-    // int newLightID5 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID5 = lightRegistry.add(
     //     glm::vec3(10.0f, 1.0f, 10.0f), // position
     //     glm::vec3(1.0f, 0.0f, 1.0f),   // color
     //     1.8f                           // intensity
@@ -688,74 +819,67 @@ int main(int argc, char *argv[])
 
     // one light for each planet case, a little bit above the planet
     // mercury
-    int newLightID1 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID1 = lightRegistry.add(
         glm::vec3(4.0f, 3.0f, 3.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),  // color
         1.8f                          // intensity
     );
 
     // venus
-    int newLightID2 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID2 = lightRegistry.add(
         glm::vec3(8.0f, 3.0f, 3.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),  // color
         1.8f                        // intensity
     );
 
     // earth
-    int newLightID3 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID3 = lightRegistry.add(
         glm::vec3(12.0f, 3.0f, 3.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),  // color
         1.8f                          // intensity
     );
 
     // mars
-    int newLightID4 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID4 = lightRegistry.add(
         glm::vec3(16.0f, 3.0f, 3.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),  // color
         1.8f                          // intensity
     );
 
     // jupiter
-    int newLightID5 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID5 = lightRegistry.add(
         glm::vec3(16.0f, 3.0f, 20.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
         1.8f                           // intensity
     );
 
     // saturn
-    int newLightID6 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID6 = lightRegistry.add(
         glm::vec3(12.0f, 3.0f, 20.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
         1.8f                           // intensity
     );
 
     // uranus
-    int newLightID7 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID7 = lightRegistry.add(
         glm::vec3(8.0f, 3.0f, 20.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
         1.8f                           // intensity
     );
 
     // neptune
-    int newLightID8 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID8 = lightRegistry.add(
         glm::vec3(4.0f, 3.0f, 20.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
         1.8f                           // intensity
     );
 
-    int newLightID9 = utils_light::addLight(
-        simpleLights,
+    // nether portal light, lights the portal from the inside so no gizmo is drawn
+    utils_light::LightHandle newLightID9 = lightRegistry.add(
         glm::vec3(37.0f, 3.0f, 11.5f), // position
         glm::vec3(0.4f, 0.24f, 0.7f),   // color
-        1.3f                           // intensity
+        1.3f,                          // intensity
+        utils_light::LIGHT_SHADOWED    // flags
     );
 
     // add more lights to room 2
@@ -765,60 +889,62 @@ int main(int argc, char *argv[])
 
     // glm::vec3(30.0f, 2.0f, 4.0f), // Position
 
-    int newLightID10 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID10 = lightRegistry.add(
         glm::vec3(30.0f, 4.0f, 4.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
         3.5f                           // intensity
     );
 
-    int newLightID11 = utils_light::addLight(
-        simpleLights,
+    utils_light::LightHandle newLightID11 = lightRegistry.add(
         glm::vec3(30.0f, 4.0f, 20.0f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
         3.5f                           // intensity
     );
 
-    int newLightID12 = utils_light::addLight(
-        simpleLights,
+    // follows the camera, no gizmo in front of the view
+    utils_light::LightHandle newLightID12 = lightRegistry.add(
         glm::vec3(23.0f, 4.0f, 11.5f), // position
         glm::vec3(1.0f, 1.0f, 1.0f),   // color
-        1.5f                           // intensity
+        1.5f,                          // intensity
+        utils_light::LIGHT_SHADOWED    // flags
     );
 
+    // the planet case lights, animated by updateDynamicLights
+    std::vector<utils_light::LightHandle> planetLights = {newLightID1, newLightID2, newLightID3, newLightID4,
+                                                         newLightID5, newLightID6, newLightID7, newLightID8};
+    utils_animation::LightCycleBatch planetLightCycles;
+    utils_light::initDynamicLights(planetLightCycles, planetLights.size());
+
 
-    // int newLightID10 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID10 = lightRegistry.add(
     //     glm::vec3(39.0f, 3.0f, 11.5f), // position
     //     glm::vec3(0.4f, 0.24f, 0.7f),   // color
     //     1.8f                           // intensity
     // );
 
     // // light pos 32 2 13
-    // int newLightID10 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID10 = lightRegistry.add(
     //     glm::vec3(28.0f, 2.0f, 13.0f), // position
     //     glm::vec3(1.0f, 1.0f, 1.0f),   // color
     //     1.8f                           // intensity
     // );
 
     // // pos 26 1 3
-    // int newLightID11 = utils_light::addLight(
-    //     simpleLights,
+    // utils_light::LightHandle newLightID11 = lightRegistry.add(
     //     glm::vec3(28.0f, 4.0f, 3.0f), // position
     //     glm::vec3(1.0f, 1.0f, 1.0f),   // color
     //     1.8f                           // intensity
     // );
 
     // update a light position during the loop
-    // utils_light::updateLightPosition(simpleLights, newLightID, glm::vec3(5.0f, 2.0f, 1.0f));
+    // lightRegistry.setPosition(newLightID, glm::vec3(5.0f, 2.0f, 1.0f));
 
     // change colro and intensity of the light
-    // utils_light::updateLightColor(simpleLights, newLightID, glm::vec3(0.2f, 1.0f, 0.2f));
-    // utils_light::updateLightIntensity(simpleLights, newLightID, 3.5f);
+    // lightRegistry.setColor(newLightID, glm::vec3(0.2f, 1.0f, 0.2f));
+    // lightRegistry.setIntensity(newLightID, 3.5f);
 
     // remove the light from the scene
-    // bool lightRemoved = utils_light::removeLight(simpleLights, newLightID);
+    // bool lightRemoved = lightRegistry.remove(newLightID);
     // if (lightRemoved) {
     //     std::cout << "Light with ID " << newLightID << " removed from the scene." << std::endl;
     // } else {
@@ -830,6 +956,36 @@ int main(int argc, char *argv[])
 
     utils_scene::initializePlanetSpiralParameters();
 
+    // Resolve the handles of objects animated every frame once, instead of searching them by name
+    utils_scene::ObjectHandle sunHandle = utils_scene::findObject("sun", utils_scene::StoreKind::Transparent);
+    utils_scene::ObjectHandle whiteSphereHandle = utils_scene::findObject("whiteSphere", utils_scene::StoreKind::Transparent);
+    utils_scene::ObjectHandle torusHandle = utils_scene::findObject("torus", utils_scene::StoreKind::Opaque);
+
+    // Bounding volume hierarchies over the scene, used to skip objects outside the camera frustum
+    utils_scene::updateSceneMatrices();
+    utils_scene::ObjectBVH opaqueBVH;
+    utils_scene::ObjectBVH transparentBVH;
+    opaqueBVH.build(utils_scene::sceneObjects);
+    transparentBVH.build(utils_scene::sceneObjectsTransparent);
+    std::vector<unsigned char> opaqueVisible;
+    std::vector<unsigned char> transparentVisible;
+    std::vector<size_t> transparentOrder; // Draw order of the transparent slots, back to front in room 2
+    std::vector<const utils_loader::Shader *> opaquePrograms; // Program of each visible opaque slot
+
+    // Rooms and the openings between them, objects and lights in cells not seen through the openings are skipped
+    utils_scene::CellGraph roomCells;
+    setupRoomCells(roomCells, &room1, &room2);
+
+    // Sorted draw list of the opaque pass and the binding state it skips redundant binds against
+    utils_scene::RenderQueue opaqueQueue;
+    utils_scene::RenderStateCache renderState;
+    std::cout << "BVH nodes: " << opaqueBVH.nodeCount() << " opaque, " << transparentBVH.nodeCount() << " transparent" << std::endl;
+
+    // Broadphase grid for camera collision, only moving objects are re-inserted each frame
+    CollisionGrid collisionGrid;
+    collisionGrid.addStore(utils_scene::sceneObjects);
+    collisionGrid.addStore(utils_scene::sceneObjectsTransparent);
+
     // Main loop variables
     bool done = false;
     std::cout << "Entering main loop" << std::endl;
@@ -859,7 +1015,11 @@ int main(int argc, char *argv[])
 
 
         // Update window title with camera position every frame
-        std::string newTitle = "Boules - FPS: " + std::to_string(fps) + " - Position: (" + std::to_string(cameraPos.x) + ", " + std::to_string(cameraPos.z) + ")";
+        std::string newTitle = "Boules - FPS: " + std::to_string(fps) + " - Position: (" + std::to_string(cameraPos.x) + ", " + std::to_string(cameraPos.z) + ")"
+                             + " - Binds avoided: " + std::to_string(renderState.stats().bindsAvoided)
+                             + " - Shadow face draws: " + shadowStats.summary()
+                             + " - Atlas faces: " + std::to_string(shadowAtlas.lastFaceCount())
+                             + " - Cluster lights: " + std::to_string(lightClusters.indexCount());
         // std::string newTitle = std::to_string(cameraPos.x) + ", " + std::to_string(cameraPos.z);
         // std::string newTitle = "FPS: " + std::to_string(fps);
         SDL_WM_SetCaption(newTitle.c_str(), NULL);
@@ -921,25 +1081,8 @@ int main(int argc, char *argv[])
         // Apply movement speed
         proposedCameraPos += movementDirection * adjustedSpeed;
 
-        // Check collision against all objects
-        bool collisionDetected = false;
-        for (const auto &object : utils_scene::sceneObjects)
-        {
-            if (checkCollision(proposedCameraPos, cameraRadius, cameraHeight, object.boundingBox))
-            {
-                collisionDetected = true;
-                break; // Stop further checking if a collision is found
-            }
-        }
-        // Check collision against all objects with transparency
-        for (const auto &object : utils_scene::sceneObjectsTransparent)
-        {
-            if (checkCollision(proposedCameraPos, cameraRadius, cameraHeight, object.boundingBox))
-            {
-                collisionDetected = true;
-                break; // Stop further checking if a collision is found
-            }
-        }
+        // Check collision against the objects in the grid cells swept by the camera
+        bool collisionDetected = collisionGrid.collides(cameraPos, proposedCameraPos, cameraRadius, cameraHeight);
 
         // Update camera position only if no collision is detected
         if (!collisionDetected)
@@ -984,6 +1127,9 @@ int main(int argc, char *argv[])
             cameraUp                 // Up vector
         );
 
+        // The view is a rigid transform, so its rotation turns cached world normal matrices into view space ones
+        glm::mat3 viewNormalMatrix = glm::mat3(ViewMatrix);
+
 
 
         // Spiral movement around spiralCenter
@@ -1009,10 +1155,10 @@ int main(int argc, char *argv[])
         // lightPosWorld5.y = 1.0f;
         // lightPosWorld5.z = 10.0f + 1.0f * sin(currentFrame);
 
-        // simpleLights[4].position = lightPosWorld5;
+        // lightRegistry.setPosition(newLightID5, lightPosWorld5);
 
         // also change its color
-        // simpleLights[4].color = glm::vec3(
+        // lightRegistry.setColor(newLightID5, glm::vec3(
         //     (sin(currentFrame) + 1.0f) / 2.0f,       // Red oscillates between 0 and 1
         //     (cos(currentFrame) + 1.0f) / 2.0f,       // Green oscillates between 0 and 1
         //     (sin(currentFrame * 0.5f) + 1.0f) / 2.0f // Blue oscillates more slowly between 0 and 1
@@ -1025,42 +1171,31 @@ int main(int argc, char *argv[])
         if (isLightPaused)
         {
             // setobject position to 100 units below the scene
-            utils_scene::setObjectPosition("sun", glm::vec3(9.5f, -100.0f, 11.5f));
+            utils_scene::setObjectPosition(sunHandle, glm::vec3(9.5f, -100.0f, 11.5f));
         }
         else
         {
             // setobject position to the original position
-            utils_scene::setObjectPosition("sun", glm::vec3(9.5f, 34.0f, 11.5f));
+            utils_scene::setObjectPosition(sunHandle, glm::vec3(9.5f, 34.0f, 11.5f));
         }
 
         // set the main light position to the sun position
         // get the position of the sun using the transparent lsit of objects, name is "sun"
         // Fetch sun's position dynamically
-        glm::vec3 sunPosition = utils_scene::getTransparentObjectPosition("sun");
+        glm::vec3 sunPosition = utils_scene::getObjectPosition(sunHandle);
         lightPosWorld = sunPosition;
 
-        glm::vec3 spiralCenter = utils_scene::getTransparentObjectPosition("sun");
+        glm::vec3 spiralCenter = sunPosition;
 
         utils_scene::updatePlanetPositions(currentFrame, spiralCenter);
 
 
-        // update the display lights
-        // but we cant just send simpleLights, we need to send the first 8 lights of it
-        // Create a vector for the first 8 shared_ptr lights
-        std::vector<utils_light::SimplePointLight*> truncatedLights;
-
-        std::transform(simpleLights.begin(), simpleLights.begin() + std::min(8ul, simpleLights.size()),
-                    std::back_inserter(truncatedLights),
-                    [](utils_light::SimplePointLight& light) {
-                        return &light;
-                    });
-
-        utils_light::updateDynamicLights(truncatedLights, currentFrame);
+        // update the display lights, only the planet case lights
+        utils_light::updateDynamicLights(lightRegistry, planetLights, planetLightCycles, currentFrame);
 
         // update the light inside the nether portal, light ID = 9
         // we can here vary the light intensity, to change the shader vs effect
-        simpleLights[8].intensity = 1.0f + 0.9f * cos(currentFrame);
-        // simpleLights[9].intensity = 1.0f + 0.5f * cos(currentFrame);
+        lightRegistry.setIntensity(newLightID9, 1.0f + 0.9f * cos(currentFrame));
 
         // update the display planets (they should rotate)
         utils_scene::updateDisplayPlanetPositions(currentFrame);
@@ -1069,28 +1204,24 @@ int main(int argc, char *argv[])
         // move this light newLightID10 around the object with name "whiteSphere"
 
         // get the position of the object
-        glm::vec3 whiteSpherePosition = utils_scene::getTransparentObjectPosition("whiteSphere");
+        glm::vec3 whiteSpherePosition = utils_scene::getObjectPosition(whiteSphereHandle);
 
         // move the light around the object
-        simpleLights[9].position.x = whiteSpherePosition.x + 1.6f * cos(currentFrame);
-        simpleLights[9].position.y = whiteSpherePosition.y + 1.6f * sin(currentFrame);
-        simpleLights[9].position.z = whiteSpherePosition.z + 1.6f * sin(currentFrame);
+        lightRegistry.setPosition(newLightID10, whiteSpherePosition + 1.6f * glm::vec3(cos(currentFrame), sin(currentFrame), sin(currentFrame)));
 
         // also change the color
-        simpleLights[10].color = glm::vec3(
+        lightRegistry.setColor(newLightID11, glm::vec3(
             (sin(currentFrame) + 1.0f) / 2.0f,       // Red oscillates between 0 and 1
             (cos(currentFrame) + 1.0f) / 2.0f,       // Green oscillates between 0 and 1
             (sin(currentFrame * 2.5f) + 1.0f) / 2.0f // Blue oscillates faster
-        );
+        ));
 
-        // mvoe the simpleLights[11] as well, on the object torus
-        glm::vec3 torusPosition = utils_scene::getObjectPosition("torus");
-        simpleLights[10].position.x = torusPosition.x + 1.6f * cos(currentFrame);
-        simpleLights[10].position.y = torusPosition.y + 1.6f * sin(currentFrame);
-        simpleLights[10].position.z = torusPosition.z + 1.6f * sin(currentFrame);
+        // mvoe the newLightID11 as well, on the object torus
+        glm::vec3 torusPosition = utils_scene::getObjectPosition(torusHandle);
+        lightRegistry.setPosition(newLightID11, torusPosition + 1.6f * glm::vec3(cos(currentFrame), sin(currentFrame), sin(currentFrame)));
 
-        // keep the light id 11 to 1.0f above the camera
-        simpleLights[11].position = cameraPos + glm::vec3(0.0f, 1.0f, 0.0f);
+        // keep the light newLightID12 to 1.0f above the camera
+        lightRegistry.setPosition(newLightID12, cameraPos + glm::vec3(0.0f, 1.0f, 0.0f));
 
         // light position on the camera
         // glm::vec3 lightPosWorld = cameraPos + glm::vec3(0.0f, 1.0f, 0.0f); // Slightly elevate the light position above the camera
@@ -1104,23 +1235,30 @@ int main(int argc, char *argv[])
         glm::mat4 lightSpaceMatrix = lightProjection * lightView;
 
         // Create six view matrices for the cube map faces
-        std::vector<glm::mat4> shadowTransforms;
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPosWorld, lightPosWorld + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPosWorld, lightPosWorld + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPosWorld, lightPosWorld + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPosWorld, lightPosWorld + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPosWorld, lightPosWorld + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPosWorld, lightPosWorld + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
+        glm::mat4 shadowTransforms[utils_shadow::CUBE_FACES];
+        utils_shadow::computeCubeFaceMatrices(lightPosWorld, shadowProj, shadowTransforms);
+
+        // Reallocate the shadow maps when the quality tier was switched (U key)
+        const utils_shadow::ShadowTier &activeShadowTier = utils_shadow::SHADOW_TIERS[shadowTier];
+        bool shadowMapsReallocated = false;
+        if (shadowTierChanged)
+        {
+            utils_shadow::allocateShadowMaps(activeShadowTier, depthCubeMap, momentCubeMap, shadowMapFBO, staticShadows);
+            shadowMapsReallocated = true;
+            if (!applyShadowFilter(activeShadowTier))
+            {
+                std::cerr << "Failed to compile the shaders of the " << activeShadowTier.name << " shadow tier" << std::endl;
+            }
+            shadowTierChanged = false;
+        }
 
         // First Pass: Render scene from light's perspective to generate shadow map
-        glViewport(0, 0, 4096, 4096); // Match shadow map resolution
-        glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
+        glViewport(0, 0, activeShadowTier.resolution, activeShadowTier.resolution); // Match shadow map resolution
 
         // Use the depth shader program
         depthShader.use();
-        glUniform1f(glGetUniformLocation(depthShader.getGLId(), "farPlane"), farPlane);
-        glUniform3fv(glGetUniformLocation(depthShader.getGLId(), "lightPos"), 1, glm::value_ptr(lightPosWorld));
+        glUniform1f(depthShader.getUniformLocation(utils_loader::Uniform::FarPlane), farPlane);
+        glUniform3fv(depthShader.getUniformLocation(utils_loader::Uniform::LightPos), 1, glm::value_ptr(lightPosWorld));
 
         // Rocking chair parameters
         double frequency = 0.30; // Rocking frequency (cycles per second)
@@ -1130,267 +1268,353 @@ int main(int argc, char *argv[])
         // dynamic loop
         utils_game_loop::dynamic_loop(deltaTime, lastFrame, currentFrame, windowManager, cameraPos, cameraFront, cameraUp, cameraSpeed, done, isRockingChairPaused, rockingChairStartTime, rockingChairPausedTime, yaw, pitch, radius, frequency, radius, length, cameraHeight);
 
-        if (!isLightPaused)
+        // Rebuild the cached matrices of objects moved this frame, static objects keep theirs
+        utils_scene::updateSceneMatrices();
+        opaqueBVH.refit(utils_scene::sceneObjects);
+        transparentBVH.refit(utils_scene::sceneObjectsTransparent);
+        collisionGrid.refresh(utils_scene::sceneObjects);
+        collisionGrid.refresh(utils_scene::sceneObjectsTransparent);
+
+        // Casters are only drawn into the cube faces whose frustum their bounds overlap
+        // A paused light keeps its shadow maps, except new ones after a tier switch which start empty
+        bool renderLightShadows = !isLightPaused || shadowMapsReallocated;
+        shadowStats.reset();
+        if (renderLightShadows)
+        {
+            utils_shadow::computeFaceMasks(utils_scene::sceneObjects, shadowTransforms, shadowFaceMasks);
+        }
+
+        if (renderLightShadows && layeredShadows)
         {
+            // First Pass: Render every caster once, the geometry shader emits it into the six cube map faces it overlaps
+            shadowMatrices.upload(shadowTransforms);
+
+            layeredDepthShader.use();
+            glUniform1f(layeredDepthShader.getUniformLocation(utils_loader::Uniform::FarPlane), farPlane);
+            glUniform3fv(layeredDepthShader.getUniformLocation(utils_loader::Uniform::LightPos), 1, glm::value_ptr(lightPosWorld));
+
+            GLint layeredModelLocation = layeredDepthShader.getUniformLocation(utils_loader::Uniform::Model);
+            GLint layeredInstancingLocation = layeredDepthShader.getUniformLocation(utils_loader::Uniform::UseInstancing);
+            GLint layeredFaceMaskLocation = layeredDepthShader.getUniformLocation(utils_loader::Uniform::FaceMask);
+            const utils_scene::SceneStore &shadowCasters = utils_scene::sceneObjects;
+
+            // Static casters only into the cached faces made stale by the light or one of them moving, a few faces per frame,
+            // favouring the faces around what the camera saw last frame
+            staticShadows.track(shadowCasters, shadowFaceMasks);
+            unsigned char refreshFaces = staticShadows.scheduleFaces(lightPosWorld, utils_shadow::visibleFaces(shadowFaceMasks, opaqueVisible));
+            if (refreshFaces != 0)
+            {
+                staticShadows.beginUpdate(refreshFaces);
+                for (size_t slot = 0; slot < shadowCasters.size(); ++slot)
+                {
+                    if (staticShadows.isDynamic(shadowCasters, slot))
+                    {
+                        continue;
+                    }
+                    unsigned char faceMask = shadowFaceMasks[slot] & refreshFaces;
+                    if (faceMask == 0 && shadowFaceMasks[slot] != 0)
+                    {
+                        continue; // Only in faces kept from the cache
+                    }
+                    shadowStats.record(faceMask);
+                    if (faceMask == 0)
+                    {
+                        continue;
+                    }
+                    const utils_scene::RenderItem &item = shadowCasters.renderItems[slot];
+                    glUniformMatrix4fv(layeredModelLocation, 1, GL_FALSE, glm::value_ptr(shadowCasters.worldMatrices[slot]));
+                    glUniform1f(layeredInstancingLocation, item.instanceCount > 0 ? 1.0f : 0.0f);
+                    glUniform1i(layeredFaceMaskLocation, faceMask);
+                    utils_scene::drawRenderItem(item);
+                }
+            }
 
-            // First Pass: Render scene to depth cube map
+            // Start from the cached static depth, then draw the moving casters on top
+            staticShadows.copyTo(depthCubeMap, momentCubeMap);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubeMap, 0);
+            if (momentCubeMap != 0)
+            {
+                glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentCubeMap, 0);
+            }
+            glViewport(0, 0, activeShadowTier.resolution, activeShadowTier.resolution);
+
+            for (size_t slot = 0; slot < shadowCasters.size(); ++slot)
+            {
+                if (!staticShadows.isDynamic(shadowCasters, slot))
+                {
+                    continue;
+                }
+                shadowStats.record(shadowFaceMasks[slot]);
+                if (shadowFaceMasks[slot] == 0)
+                {
+                    continue;
+                }
+                const utils_scene::RenderItem &item = shadowCasters.renderItems[slot];
+                glUniformMatrix4fv(layeredModelLocation, 1, GL_FALSE, glm::value_ptr(shadowCasters.worldMatrices[slot]));
+                glUniform1f(layeredInstancingLocation, item.instanceCount > 0 ? 1.0f : 0.0f);
+                glUniform1i(layeredFaceMaskLocation, shadowFaceMasks[slot]);
+                utils_scene::drawRenderItem(item);
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        else if (renderLightShadows)
+        {
+
+            // First Pass: Render scene to depth cube map, one pass per face
             for (unsigned int i = 0; i < 6; ++i)
             {
                 // Bind the framebuffer and attach the current cube map face
                 glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
                 glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, depthCubeMap, 0);
-                glDrawBuffer(GL_NONE);
+                if (momentCubeMap != 0)
+                {
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, momentCubeMap, 0);
+                }
+                glDrawBuffer(momentCubeMap != 0 ? GL_COLOR_ATTACHMENT0 : GL_NONE);
                 glReadBuffer(GL_NONE);
 
                 // Set viewport and clear depth buffer
-                glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-                glClear(GL_DEPTH_BUFFER_BIT);
+                glViewport(0, 0, activeShadowTier.resolution, activeShadowTier.resolution);
+                utils_shadow::clearShadowTarget(momentCubeMap != 0);
 
                 // Use the depth shader program
                 depthShader.use();
-                glUniform1f(glGetUniformLocation(depthShader.getGLId(), "farPlane"), farPlane);
-                glUniform3fv(glGetUniformLocation(depthShader.getGLId(), "lightPos"), 1, glm::value_ptr(lightPosWorld));
+                glUniform1f(depthShader.getUniformLocation(utils_loader::Uniform::FarPlane), farPlane);
+                glUniform3fv(depthShader.getUniformLocation(utils_loader::Uniform::LightPos), 1, glm::value_ptr(lightPosWorld));
 
                 // Set the shadow matrix for the current face
-                glUniformMatrix4fv(glGetUniformLocation(depthShader.getGLId(), "shadowMatrix"), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
+                glUniformMatrix4fv(depthShader.getUniformLocation(utils_loader::Uniform::ShadowMatrix), 1, GL_FALSE, glm::value_ptr(shadowTransforms[i]));
 
                 // Render scene objects
-                for (const auto &object : utils_scene::sceneObjects)
+                const utils_scene::SceneStore &shadowCasters = utils_scene::sceneObjects;
+                unsigned char faceBit = static_cast<unsigned char>(1u << i);
+                for (size_t slot = 0; slot < shadowCasters.size(); ++slot)
                 {
-                    glm::mat4 modelMatrix = glm::mat4(1.0f);
-                    modelMatrix = glm::translate(modelMatrix, object.position);
-                    if (object.rotationAngle != 0.0f)
+                    if ((shadowFaceMasks[slot] & faceBit) == 0)
                     {
-                        modelMatrix = glm::rotate(modelMatrix, glm::radians(object.rotationAngle), object.rotationAxis);
+                        continue;
                     }
-                    modelMatrix = glm::scale(modelMatrix, object.scale);
+                    shadowStats.record(faceBit);
+
+                    const utils_scene::RenderItem &item = shadowCasters.renderItems[slot];
+
+                    const glm::mat4 &modelMatrix = shadowCasters.worldMatrices[slot];
 
                     // Set model matrix for depth shader
-                    glUniformMatrix4fv(glGetUniformLocation(depthShader.getGLId(), "model"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
+                    glUniformMatrix4fv(depthShader.getUniformLocation(utils_loader::Uniform::Model), 1, GL_FALSE, glm::value_ptr(modelMatrix));
+                    glUniform1f(depthShader.getUniformLocation(utils_loader::Uniform::UseInstancing), item.instanceCount > 0 ? 1.0f : 0.0f);
 
-                    glBindVertexArray(object.vaoID);
-                    if (object.type == utils_scene::ObjectType::Cube)
-                    {
-                        glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-                    }
-                    else if (object.type == utils_scene::ObjectType::Sphere)
-                    {
-                        glDrawArrays(GL_TRIANGLES, 0, object.indexCount);
-                    }
-                    else if (object.type == utils_scene::ObjectType::Model)
-                    {
-                        glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-                    }
-                    glBindVertexArray(0);
+                    utils_scene::drawRenderItem(item);
                 }
 
                 // Optional: Unbind the framebuffer after each face
                 glBindFramebuffer(GL_FRAMEBUFFER, 0);
             }
 
-        } // end of if (!isLightPaused)
-        else
+        } // end of if (renderLightShadows)
+
+        if (isLightPaused)
         {
             // set intensity to 0
             lightIntensity = glm::vec3(0.0f);
             // next loop will set back to Kd of the material, unless light is still paused
         }
 
+        // Cells seen from the camera cell through the portals
+        roomCells.computeVisibility(cameraPos, ProjMatrix * ViewMatrix);
+
+        // Additional light shadows: rank the lights seen through the visible cells, then re-render the most urgent
+        // atlas faces within the budget. Casters are not culled, objects of hidden cells may shadow visible ones.
+        shadowAtlas.assignSlots(lightRegistry, std::min(static_cast<int>(lightRegistry.size()), MAX_ADDITIONAL_LIGHTS),
+                                cameraPos, roomCells);
+        shadowAtlas.render(depthShader, utils_scene::sceneObjects);
+
         // Second Pass: Render the scene normally with point light
         glViewport(0, 0, window_width, window_height);
         glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Set the shader program to use, room1 for x udner 20.5 and room2 for x over 20.5
-        utils_loader::Shader *currentRoom = &room1;
-        bool inRoom2 = cameraPos.x >= 20.5f;
-        if (inRoom2)
+        // Set the shader program of the camera's cell, the other cells' objects are drawn with their own program
+        const utils_loader::Shader *currentRoom = roomCells.programFor(AABB(cameraPos, cameraPos));
+        if (currentRoom == nullptr)
         {
-            currentRoom = &room2;
+            currentRoom = &room1;
         }
+        bool inRoom2 = currentRoom == &room2;
 
         currentRoom->use();
 
+        // Room 1 opaque objects go through the G-buffer in the deferred path
+        bool deferredFrame = deferredShading && !inRoom2;
+
         // Retrieve uniform locations specific to the active shader
-        GLint uModelMatrixLocation = currentRoom->getUniformLocation("uModelMatrix");
-        GLint uMVPMatrixLocation = currentRoom->getUniformLocation("uMVPMatrix");
-        GLint uMVMatrixLocation = currentRoom->getUniformLocation("uMVMatrix");
-        GLint uNormalMatrixLocation = currentRoom->getUniformLocation("uNormalMatrix");
-        GLint uTextureLocation = currentRoom->getUniformLocation("uTexture");
-        GLint uUseTextureLocation = currentRoom->getUniformLocation("uUseTexture");
-        GLint uKdLocation = currentRoom->getUniformLocation("uKd");
-        GLint uKsLocation = currentRoom->getUniformLocation("uKs");
-        GLint uShininessLocation = currentRoom->getUniformLocation("uShininess");
-        GLint uLightPos_vsLocation = currentRoom->getUniformLocation("uLightPos_vs");
-        GLint uLightIntensityLocation = currentRoom->getUniformLocation("uLightIntensity");
+        GLint uModelMatrixLocation, uMVPMatrixLocation, uMVMatrixLocation, uNormalMatrixLocation, uUseInstancingLocation;
+        GLint uTextureLocation, uUseTextureLocation, uKdLocation, uKsLocation, uShininessLocation, uColorMaskLocation;
+        GLint uAlphaLocation, uNormalMapLocation, uUseNormalMapLocation, uSpecularMapLocation, uUseSpecularMapLocation;
+        auto fetchLocations = [&](const utils_loader::Shader &shader)
+        {
+            uModelMatrixLocation = shader.getUniformLocation(utils_loader::Uniform::ModelMatrix);
+            uMVPMatrixLocation = shader.getUniformLocation(utils_loader::Uniform::MVPMatrix);
+            uMVMatrixLocation = shader.getUniformLocation(utils_loader::Uniform::MVMatrix);
+            uNormalMatrixLocation = shader.getUniformLocation(utils_loader::Uniform::NormalMatrix);
+            uUseInstancingLocation = shader.getUniformLocation(utils_loader::Uniform::UseInstancing);
+            uTextureLocation = shader.getUniformLocation(utils_loader::Uniform::Texture);
+            uUseTextureLocation = shader.getUniformLocation(utils_loader::Uniform::UseTexture);
+            uKdLocation = shader.getUniformLocation(utils_loader::Uniform::Kd);
+            uKsLocation = shader.getUniformLocation(utils_loader::Uniform::Ks);
+            uShininessLocation = shader.getUniformLocation(utils_loader::Uniform::Shininess);
+            uColorMaskLocation = shader.getUniformLocation(utils_loader::Uniform::ColorMask);
+
+            // Retrieve 'uAlpha' regardless of room
+            uAlphaLocation = shader.getUniformLocation(utils_loader::Uniform::Alpha);
+
+            // Retrieve additional uniforms for Shader 2
+            uNormalMapLocation = shader.getUniformLocation(utils_loader::Uniform::NormalMap);
+            uUseNormalMapLocation = shader.getUniformLocation(utils_loader::Uniform::UseNormalMap);
+            uSpecularMapLocation = shader.getUniformLocation(utils_loader::Uniform::SpecularMap);
+            uUseSpecularMapLocation = shader.getUniformLocation(utils_loader::Uniform::UseSpecularMap);
+        };
+        fetchLocations(*currentRoom);
 
         // Retrieve 'uAlpha' only if in room2 (deprecated, we add transparency to room 1 as well)
         // GLint uAlphaLocation = -1;
         // if (inRoom2) {
-        //     uAlphaLocation = currentRoom->getUniformLocation("uAlpha");
+        //     uAlphaLocation = currentRoom->getUniformLocation(utils_loader::Uniform::Alpha);
         //     if (uAlphaLocation == -1) {
         //         std::cerr << "Failed to get 'uAlpha' location in room2 shader" << std::endl;
         //     }
         // }
 
-        // Retrieve 'uAlpha' regardless of room
-        GLint uAlphaLocation = currentRoom->getUniformLocation("uAlpha");
-
-        // Retrieve additional uniforms for Shader 2
-        GLint uNormalMapLocation = currentRoom->getUniformLocation("uNormalMap");
-        GLint uUseNormalMapLocation = currentRoom->getUniformLocation("uUseNormalMap");
-        GLint uSpecularMapLocation = currentRoom->getUniformLocation("uSpecularMap");
-        GLint uUseSpecularMapLocation = currentRoom->getUniformLocation("uUseSpecularMap");
-
         // Determine the number of additional lights, capped by MAX_ADDITIONAL_LIGHTS
-        int numLights = static_cast<int>(simpleLights.size());
+        int numLights = static_cast<int>(lightRegistry.size());
         if (numLights > MAX_ADDITIONAL_LIGHTS)
         {
             numLights = MAX_ADDITIONAL_LIGHTS;
         }
 
-        // Set the number of additional lights in the shader
-        GLint numLightsLoc = glGetUniformLocation(currentRoom->getGLId(), "uNumAdditionalLights");
-        glUniform1i(numLightsLoc, numLights);
-
-        // Convert additional light positions to view space
-        std::vector<glm::vec3> additionalLightPosViewSpace;
-        additionalLightPosViewSpace.reserve(numLights);
-        for (int i = 0; i < numLights; ++i)
+        // Upload the frame and light data once per frame, both room shaders read the same buffer
+        utils_loader::FrameData frameData;
+        frameData.lightPosView = lightPosViewSpace;
+        frameData.farPlane = farPlane;
+        frameData.mainLightIntensity = lightIntensity;
+        frameData.time = currentFrame;
+        frameData.lightPosWorld = lightPosWorld;
+        frameData.numAdditionalLights = numLights;
+        frameData.cameraPosWorld = cameraPos;
+        frameData.padding = 0.0f;
+        frameUniforms.upload(frameData, lightRegistry, shadowAtlas.lightSlots(), ViewMatrix);
+
+        // Lights reaching each froxel, fragments only shade the intersection with their object's list
+        lightClusters.build(lightRegistry.lights(), numLights, ViewMatrix, ProjMatrix);
+
+        // Both room programs may draw this frame, one per visible cell
+        const utils_loader::Shader *roomPrograms[] = {&room1, &room2};
+        for (const utils_loader::Shader *program : roomPrograms)
         {
-            glm::vec4 posView = ViewMatrix * glm::vec4(simpleLights[i].position, 1.0f);
-            additionalLightPosViewSpace.emplace_back(glm::vec3(posView));
-        }
+            program->use();
+            lightClusters.applyUniforms(*program);
 
-        // Set additional light positions and colors once per frame
-        for (int i = 0; i < numLights; ++i)
-        {
-            std::string idx = std::to_string(i);
-
-            // Position
-            GLint posLoc = glGetUniformLocation(
-                currentRoom->getGLId(),
-                ("uAdditionalLightPos[" + idx + "]").c_str());
-            glUniform3fv(posLoc, 1, glm::value_ptr(additionalLightPosViewSpace[i]));
-
-            // Color
-            GLint colorLoc = glGetUniformLocation(
-                currentRoom->getGLId(),
-                ("uAdditionalLightColor[" + idx + "]").c_str());
-            glUniform3fv(colorLoc, 1, glm::value_ptr(simpleLights[i].color));
-
-            // Initialize intensity to zero; will be set per object
-            GLint intenLoc = glGetUniformLocation(
-                currentRoom->getGLId(),
-                ("uAdditionalLightIntensity[" + idx + "]").c_str());
-            glUniform1f(intenLoc, 0.0f);
+            // Set the updated light space matrix
+            glUniformMatrix4fv(program->getUniformLocation(utils_loader::Uniform::LightSpaceMatrix), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
+            glUniform1i(program->getUniformLocation(utils_loader::Uniform::DepthMap), 1);
         }
+        currentRoom->use();
 
-        // Set main light properties once per frame
-        glUniform3fv(uLightPos_vsLocation, 1, glm::value_ptr(lightPosViewSpace));
-        glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(lightIntensity));
-
-        // Set the updated light space matrix
-        glUniformMatrix4fv(glGetUniformLocation(currentRoom->getGLId(), "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
-
-        // Bind the depth cube map to texture unit 1
+        // Bind the depth cube map to texture unit 1, or the prefiltered moments for the exponential filter
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
-        glUniform1i(glGetUniformLocation(currentRoom->getGLId(), "depthMap"), 1);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, momentCubeMap != 0 ? momentCubeMap : depthCubeMap);
+        if (momentCubeMap != 0 && renderLightShadows)
+        {
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        }
 
-        // Set light and camera positions in world space
-        glUniform3fv(glGetUniformLocation(currentRoom->getGLId(), "lightPosWorld"), 1, glm::value_ptr(lightPosWorld));
-        glUniform3fv(glGetUniformLocation(currentRoom->getGLId(), "cameraPosWorld"), 1, glm::value_ptr(cameraPos));
+        // Bind the additional light shadow atlas to texture unit 4
+        shadowAtlas.bindTexture(GL_TEXTURE4);
 
-        // Set far plane
-        glUniform1f(glGetUniformLocation(currentRoom->getGLId(), "farPlane"), farPlane);
+        // Bind the cluster grid and light indices to texture units 5 and 6
+        lightClusters.bindTextures(GL_TEXTURE5, GL_TEXTURE6);
 
-        // **Sort Transparent Objects Back-to-Front**
-        if (inRoom2 && !utils_scene::sceneObjectsTransparent.empty())
+        // **Sort Transparent Objects Back-to-Front**, the weighted path blends them in any order.
+        // Only the slot indices are sorted, the store keeps its layout
+        const std::vector<utils_scene::Transform> &transparentTransforms = utils_scene::sceneObjectsTransparent.transforms;
+        if (transparentOrder.size() != transparentTransforms.size())
+        {
+            transparentOrder.resize(transparentTransforms.size());
+            std::iota(transparentOrder.begin(), transparentOrder.end(), 0);
+        }
+        if (inRoom2 && !weightedTransparency)
         {
-            std::sort(utils_scene::sceneObjectsTransparent.begin(), utils_scene::sceneObjectsTransparent.end(),
-                    [&](const utils_scene::SceneObject &a, const utils_scene::SceneObject &b)
+            // Last frame's order is nearly sorted already
+            std::sort(transparentOrder.begin(), transparentOrder.end(),
+                    [&](size_t a, size_t b)
                     {
-                        float distanceA = glm::length(cameraPos - a.position);
-                        float distanceB = glm::length(cameraPos - b.position);
+                        float distanceA = glm::length(cameraPos - transparentTransforms[a].position);
+                        float distanceB = glm::length(cameraPos - transparentTransforms[b].position);
                         return distanceA > distanceB;
                     });
         }
 
         glDisable(GL_CULL_FACE);
 
-        auto deltaObj = 0.0f;
-        auto deltaLight = 0.0f;
-        bool sameRoom = false;
-
-        GLint uTimeLocation = currentRoom->getUniformLocation("uTime");
-        if (uTimeLocation != -1) {
-            glUniform1f(uTimeLocation, currentFrame);
-        }
-
-        // Render all scene objects (opaque)
-        for (const auto &object : utils_scene::sceneObjects)
+        // View frustum culling
+        utils_scene::Frustum cameraFrustum = utils_scene::extractFrustum(ProjMatrix * ViewMatrix);
+        opaqueBVH.cull(utils_scene::sceneObjects, cameraFrustum, opaqueVisible);
+        transparentBVH.cull(utils_scene::sceneObjectsTransparent, cameraFrustum, transparentVisible);
+
+        // Then drop the objects of the cells not seen through the portals, and narrow the others to their cell's frustum
+        roomCells.cullStore(utils_scene::sceneObjects, opaqueVisible);
+        roomCells.cullStore(utils_scene::sceneObjectsTransparent, transparentVisible);
+
+        // Lights whose influence sphere reaches each visible object
+        utils_light::buildObjectLightLists(lightRegistry.lights(), numLights, lightPosWorld, utils_scene::sceneObjects, opaqueLightLists, &opaqueVisible);
+        utils_light::buildObjectLightLists(lightRegistry.lights(), numLights, lightPosWorld, utils_scene::sceneObjectsTransparent, transparentLightLists, &transparentVisible);
+
+        // Render all scene objects (opaque), sorted by state so binds are only issued when the key changes.
+        // Each object is drawn with the program of its cell, room 1 objects go to the G-buffer in deferred frames.
+        const utils_scene::SceneStore &opaqueObjects = utils_scene::sceneObjects;
+        opaquePrograms.assign(opaqueObjects.size(), nullptr);
+        opaqueQueue.clear();
+        for (size_t slot = 0; slot < opaqueObjects.size(); ++slot)
         {
-            // Setup model matrix
-            glm::mat4 modelMatrix = glm::mat4(1.0f);
-            modelMatrix = glm::translate(modelMatrix, object.position);
-            if (object.rotationAngle != 0.0f)
+            if (!opaqueVisible[slot])
             {
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(object.rotationAngle), object.rotationAxis);
+                continue;
             }
-            modelMatrix = glm::scale(modelMatrix, object.scale);
-
-            // Calculate matrices
-            glm::mat4 mvMatrix = ViewMatrix * modelMatrix;
-            glm::mat4 mvpMatrix = ProjMatrix * mvMatrix;
-            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(mvMatrix)));
-
-            // Set uniforms for shaders
-            glUniformMatrix4fv(uModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-            glUniformMatrix4fv(uMVMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-            glUniformMatrix4fv(uMVPMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-            glUniformMatrix3fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-            // Determine if the object is in the same room as the main light
-            float deltaObj   = 20.5f - object.position.x;
-            float deltaLight = 20.5f - lightPosWorld.x;
-            bool sameRoom    = (deltaObj * deltaLight) > 0; // true if object & light are on the same side
-
-            if (sameRoom) {
-                // Main light affects this object
-                glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(lightIntensity));
-            } else {
-                // Main light does not affect this object
-                glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(glm::vec3(0.0f)));
+            const utils_loader::Shader *program = roomCells.programFor(opaqueObjects.bounds[slot]);
+            if (program == nullptr)
+            {
+                program = currentRoom;
             }
-
-            // **Additional Lights Uniforms**
-            for (int i = 0; i < numLights; ++i)
+            if (deferredFrame && program == &room1)
             {
-                float deltaObjForAddLight   = 20.5f - object.position.x;
-                float deltaAdditionalLight  = 20.5f - simpleLights[i].position.x;
-                bool sameRoomForAddLight    = (deltaObjForAddLight * deltaAdditionalLight) > 0;
+                program = &gbufferShader;
+            }
+            opaquePrograms[slot] = program;
 
-                std::string idx = std::to_string(i);
-                GLint intenLoc  = glGetUniformLocation(currentRoom->getGLId(), ("uAdditionalLightIntensity[" + idx + "]").c_str());
-                // also position
-                GLint posLoc    = glGetUniformLocation(currentRoom->getGLId(), ("uAdditionalLightPos[" + idx + "]").c_str());
+            const utils_scene::RenderItem &item = opaqueObjects.renderItems[slot];
+            float viewDepth = -(ViewMatrix * glm::vec4(opaqueObjects.transforms[slot].position, 1.0f)).z;
+            opaqueQueue.push(utils_scene::makeSortKey(utils_scene::RenderPass::Opaque, program->getGLId(),
+                                                      item.materialIndex, item.vaoID, viewDepth / 100.0f),
+                             slot);
+        }
+        opaqueQueue.sort();
 
-                if (sameRoomForAddLight)
-                {
-                    // Enable this additional light for the object
-                    glUniform1f(intenLoc, simpleLights[i].intensity);
-                }
-                else
-                {
-                    // Disable this additional light for the object
-                    glUniform1f(intenLoc, 0.0f);
-                }
-            }
+        // The transparent passes leave blending on, the sorted order must not change what opaque draws blend with
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
 
-            // Retrieve the material from the manager
-            const Material &mat = materialManager.getMaterial(object.materialIndex);
+        // The G-buffer pass draws the G-buffer part of the queue, the rest is drawn forward after the lighting pass
+        if (deferredFrame)
+        {
+            gbuffer.bindForWriting();
+        }
 
+        // Material uniforms and maps of the program whose locations were fetched last, textures bound through the cache
+        auto applyMaterial = [&](const Material &mat)
+        {
             // 1) Diffuse color
             if (uKdLocation != -1)
             {
@@ -1418,13 +1642,15 @@ int main(int argc, char *argv[])
             // Bind textures if applicable
             if (mat.hasDiffuseMap && mat.diffuseMapID != 0 && uUseTextureLocation != -1)
             {
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, mat.diffuseMapID);
+                renderState.bindTexture(0, mat.diffuseMapID);
                 glUniform1i(uTextureLocation, 0);
                 glUniform1f(uUseTextureLocation, 1.0f);
             }
             else
             {
+                // The shaders read the alpha of uTexture even without a diffuse map, do not let it
+                // come from whichever material happened to be drawn before in the sorted order
+                renderState.bindTexture(0, 0);
                 if (uUseTextureLocation != -1)
                 {
                     glUniform1f(uUseTextureLocation, 0.0f);
@@ -1434,8 +1660,7 @@ int main(int argc, char *argv[])
             // Bind normal map if applicable
             if (mat.hasNormalMap && mat.normalMapID != 0 && uUseNormalMapLocation != -1)
             {
-                glActiveTexture(GL_TEXTURE2); // Use texture unit 2 for normal maps
-                glBindTexture(GL_TEXTURE_2D, mat.normalMapID);
+                renderState.bindTexture(2, mat.normalMapID); // Use texture unit 2 for normal maps
                 glUniform1i(uNormalMapLocation, 2);
                 glUniform1f(uUseNormalMapLocation, 1.0f);
             }
@@ -1450,8 +1675,7 @@ int main(int argc, char *argv[])
             // Bind specular map if applicable
             if (mat.hasSpecularMap && mat.specularMapID != 0 && uUseSpecularMapLocation != -1)
             {
-                glActiveTexture(GL_TEXTURE3); // Use texture unit 3 for specular maps
-                glBindTexture(GL_TEXTURE_2D, mat.specularMapID);
+                renderState.bindTexture(3, mat.specularMapID); // Use texture unit 3 for specular maps
                 glUniform1i(uSpecularMapLocation, 3);
                 glUniform1f(uUseSpecularMapLocation, 1.0f);
             }
@@ -1462,44 +1686,126 @@ int main(int argc, char *argv[])
                     glUniform1f(uUseSpecularMapLocation, 0.0f);
                 }
             }
+        };
 
-            // Bind VAO and draw the object
-            glBindVertexArray(object.vaoID);
-            if (object.type == utils_scene::ObjectType::Cube)
-            {
-                glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-            }
-            else if (object.type == utils_scene::ObjectType::Sphere)
-            {
-                glDrawArrays(GL_TRIANGLES, 0, object.indexCount);
-            }
-            else if (object.type == utils_scene::ObjectType::Model)
+        renderState.beginFrame();
+        GLint uObjectSideLocation = -1;
+        auto drawOpaqueQueue = [&](bool gbufferPass)
+        {
+            const utils_loader::Shader *activeProgram = nullptr;
+            for (const utils_scene::DrawCommand &draw : opaqueQueue.draws())
             {
-                glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
+                size_t slot = draw.slot;
+                const utils_loader::Shader *program = opaquePrograms[slot];
+                if ((program == &gbufferShader) != gbufferPass)
+                {
+                    continue;
+                }
+                const utils_scene::RenderItem &item = opaqueObjects.renderItems[slot];
+
+                // Switch program when the cell changes, its locations and material state start over
+                if (program != activeProgram)
+                {
+                    activeProgram = program;
+                    program->use();
+                    fetchLocations(*program);
+                    objectLights.begin(*program);
+                    renderState.invalidate();
+                    uObjectSideLocation = gbufferPass ? program->getUniformLocation(utils_loader::Uniform::ObjectSide) : -1;
+                }
+
+                // Setup model matrix
+                const glm::mat4 &modelMatrix = opaqueObjects.worldMatrices[slot];
+
+                // Calculate matrices
+                glm::mat4 mvMatrix = ViewMatrix * modelMatrix;
+                glm::mat4 mvpMatrix = ProjMatrix * mvMatrix;
+                glm::mat3 normalMatrix = viewNormalMatrix * opaqueObjects.normalMatrices[slot];
+
+                // Set uniforms for shaders
+                glUniformMatrix4fv(uModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+                glUniformMatrix4fv(uMVMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
+                glUniformMatrix4fv(uMVPMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
+                glUniformMatrix3fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+                glUniform1f(uUseInstancingLocation, item.instanceCount > 0 ? 1.0f : 0.0f);
+
+                // Lights reaching the object, re-uploaded only when the list changes
+                // The deferred lighting pass finds the lights per pixel, it only needs the object's side
+                if (gbufferPass)
+                {
+                    glUniform1i(uObjectSideLocation, utils_light::roomSide(opaqueObjects.transforms[slot].position.x));
+                }
+                else
+                {
+                    objectLights.apply(opaqueLightLists, opaqueObjects.idAt(slot));
+                }
+
+                // Material uniforms and maps, only when the material differs from the previous draw
+                if (renderState.useMaterial(item.materialIndex))
+                {
+                    applyMaterial(materialManager.getMaterial(item.materialIndex));
+                }
+
+                // Bind the VAO if it changed and draw the object
+                renderState.draw(item);
             }
-            glBindVertexArray(0);
+            renderState.endPass();
+        };
+        drawOpaqueQueue(deferredFrame);
+
+        // Deferred lighting: shade every covered pixel once, writing its depth for the passes that follow
+        if (deferredFrame)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, window_width, window_height);
+
+            deferredLightingShader.use();
+            lightClusters.applyUniforms(deferredLightingShader);
+            glUniformMatrix4fv(deferredLightingShader.getUniformLocation(utils_loader::Uniform::InverseProjection), 1, GL_FALSE, glm::value_ptr(glm::inverse(ProjMatrix)));
+            glUniformMatrix4fv(deferredLightingShader.getUniformLocation(utils_loader::Uniform::InverseView), 1, GL_FALSE, glm::value_ptr(glm::inverse(ViewMatrix)));
+            glUniform1i(deferredLightingShader.getUniformLocation(utils_loader::Uniform::MainLightSide), utils_light::roomSide(lightPosWorld.x));
+            gbuffer.bindTextures();
+
+            glDepthFunc(GL_ALWAYS);
+            gbuffer.drawFullScreen();
+            glDepthFunc(GL_LESS);
+
+            // Objects of the other cells, seen through the portals, are shaded forward
+            drawOpaqueQueue(false);
         }
 
+        // The passes that follow draw with the camera cell's program
+        currentRoom->use();
+        fetchLocations(*currentRoom);
+        objectLights.begin(*currentRoom);
+
+        // Unbind material textures, the last opaque object drawn depends on culling and
+        // the following passes must not sample its maps
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+
         // =======================
         // Render Skybox Objects
         skyboxShader.use();
 
-        for (const auto &object : utils_scene::sceneObjectsSkybox)
+        const utils_scene::SceneStore &skyboxObjects = utils_scene::sceneObjectsSkybox;
+        for (size_t slot = 0; slot < skyboxObjects.size(); ++slot)
         {
+            const utils_scene::RenderItem &item = skyboxObjects.renderItems[slot];
+
             // print object name
-            // std::cout << "Object Name: " << object.name << std::endl;
+            // std::cout << "Object Name: " << skyboxObjects.names[slot] << std::endl;
             // Transformation Matrices
-            glm::mat4 modelMatrix = glm::mat4(1.0f);
-            modelMatrix = glm::translate(modelMatrix, object.position);
-            if (object.rotationAngle != 0.0f)
-            {
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(object.rotationAngle), object.rotationAxis);
-            }
-            modelMatrix = glm::scale(modelMatrix, object.scale);
+            const glm::mat4 &modelMatrix = skyboxObjects.worldMatrices[slot];
 
             glm::mat4 mvMatrix = ViewMatrix * modelMatrix;
             glm::mat4 mvpMatrix = ProjMatrix * mvMatrix;
-            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(mvMatrix)));
+            glm::mat3 normalMatrix = viewNormalMatrix * skyboxObjects.normalMatrices[slot];
 
             // Set Skybox Shader Uniforms
             glUniformMatrix4fv(sky_uMVPMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
@@ -1507,7 +1813,7 @@ int main(int argc, char *argv[])
             glUniformMatrix3fv(sky_uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
 
             // Retrieve the material for the object
-            const Material &mat = materialManager.getMaterial(object.materialIndex);
+            const Material &mat = materialManager.getMaterial(item.materialIndex);
 
             // 1) Diffuse Color
             if (sky_uKdLocation != -1)
@@ -1528,7 +1834,7 @@ int main(int argc, char *argv[])
             }
 
             // 4) Alpha (Transparency)
-            GLint sky_uAlphaLocation = glGetUniformLocation(skyboxShader.getGLId(), "uAlpha");
+            GLint sky_uAlphaLocation = skyboxShader.getUniformLocation(utils_loader::Uniform::Alpha);
             if (sky_uAlphaLocation != -1)
             {
                 glUniform1f(sky_uAlphaLocation, mat.alpha);
@@ -1557,8 +1863,8 @@ int main(int argc, char *argv[])
             }
 
             // 6) Normal Map
-            GLint sky_uNormalMapLocation = glGetUniformLocation(skyboxShader.getGLId(), "uNormalMap");
-            GLint sky_uUseNormalMapLocation = glGetUniformLocation(skyboxShader.getGLId(), "uUseNormalMap");
+            GLint sky_uNormalMapLocation = skyboxShader.getUniformLocation(utils_loader::Uniform::NormalMap);
+            GLint sky_uUseNormalMapLocation = skyboxShader.getUniformLocation(utils_loader::Uniform::UseNormalMap);
             if (mat.hasNormalMap && mat.normalMapID != 0)
             {
                 glActiveTexture(GL_TEXTURE2);
@@ -1581,8 +1887,8 @@ int main(int argc, char *argv[])
             }
 
             // 7) Specular Map
-            GLint sky_uSpecularMapLocation = glGetUniformLocation(skyboxShader.getGLId(), "uSpecularMap");
-            GLint sky_uUseSpecularMapLocation = glGetUniformLocation(skyboxShader.getGLId(), "uUseSpecularMap");
+            GLint sky_uSpecularMapLocation = skyboxShader.getUniformLocation(utils_loader::Uniform::SpecularMap);
+            GLint sky_uUseSpecularMapLocation = skyboxShader.getUniformLocation(utils_loader::Uniform::UseSpecularMap);
             if (mat.hasSpecularMap && mat.specularMapID != 0)
             {
                 glActiveTexture(GL_TEXTURE3);
@@ -1605,19 +1911,7 @@ int main(int argc, char *argv[])
             }
 
             // Draw Skybox Object
-            glBindVertexArray(object.vaoID);
-            if (object.type == utils_scene::ObjectType::Cube)
-            {
-                glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-            }
-            else if (object.type == utils_scene::ObjectType::Sphere)
-            {
-                glDrawArrays(GL_TRIANGLES, 0, object.indexCount);
-            }
-            else if (object.type == utils_scene::ObjectType::Model)
-            {
-                glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-            }
+            utils_scene::drawRenderItem(item);
 
             // Unbind Textures
             glBindTexture(GL_TEXTURE_2D, 0);
@@ -1678,10 +1972,11 @@ int main(int argc, char *argv[])
         glUniform3fv(light_uKdLocation, 1, glm::value_ptr(simpleLightMaterial.Kd));
         glUniform3fv(light_uKsLocation, 1, glm::value_ptr(simpleLightMaterial.Ks));
         glUniform1f(light_uShininessLocation, simpleLightMaterial.shininess);
-        glUniform1f(glGetUniformLocation(lightShader.getGLId(), "uAlpha"), simpleLightMaterial.alpha);
+        glUniform1f(lightShader.getUniformLocation(utils_loader::Uniform::Alpha), simpleLightMaterial.alpha);
 
-        for (const auto &light : simpleLights)
+        for (size_t slot = 0; slot < lightRegistry.size(); ++slot)
         {
+            const utils_light::SimplePointLight &light = lightRegistry.lights()[slot];
             if (light.intensity <= 0.0f)
                 continue;
 
@@ -1692,8 +1987,14 @@ int main(int argc, char *argv[])
             //     continue;
             // }
 
-            // skip specific light IDs
-            if (light.id == 8 || light.id == 11)
+            // skip the lights drawn without a gizmo
+            if (!(lightRegistry.flagsAt(slot) & utils_light::LIGHT_GIZMO))
+            {
+                continue;
+            }
+
+            // skip the lights in cells not seen through the portals
+            if (!roomCells.isVisible(AABB(light.position - glm::vec3(0.1f), light.position + glm::vec3(0.1f))))
             {
                 continue;
             }
@@ -1726,472 +2027,104 @@ int main(int argc, char *argv[])
         // check which room we are in
         // std::cout << "Camera Position: " << cameraPos.x << std::endl;
 
-        // Check if in Room 2 (assuming cameraPos.x >= 20.5f indicates Room 2)
-        if (cameraPos.x >= 20.5f)
+        // Transparent objects. The sorted path draws them all at once; the weighted path draws the opaque-like ones
+        // (alpha 0.9, depth written) first, then accumulates the blended ones in any order and composites them.
+        auto drawTransparentObjects = [&](bool drawOpaqueLike, bool drawBlended)
         {
-            // =======================
-            // **Multi-Pass Rendering for Room 2**
-            // =======================
+            bool accumulating = weightedTransparency && drawBlended;
 
-            // Enable additive blending for accumulating color channels
+            // In room 2 (the camera's cell is shaded by room2) the color channels of each object are added up,
+            // elsewhere objects are alpha blended over the scene. The weighted targets keep their own blending.
+            GLenum blendSource = inRoom2 ? GL_ONE : GL_SRC_ALPHA;
+            GLenum blendDestination = inRoom2 ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA;
             glEnable(GL_BLEND);
-            glBlendFunc(GL_ONE, GL_ONE); // Additive blending
+            if (!accumulating)
+            {
+                glBlendFunc(blendSource, blendDestination);
+            }
 
             // Disable depth writing to allow blending
             glDepthMask(GL_FALSE);
 
-            // Iterate over each color channel
-            for (int channel = 0; channel < 3; ++channel)
+            // In room 2 the geometry shader emits one copy per color channel, each object is drawn once
+            if (inRoom2)
             {
-                // Set the colorMask uniform
-                glUniform3fv(room2_uColorMaskLocation, 1, glm::value_ptr(colorMasks[channel]));
-
-                // Iterate over each transparent object
-                for (const auto &object : utils_scene::sceneObjectsTransparent)
-                {
-                    // Check material index validity
-                    if (object.materialIndex < 0 || object.materialIndex >= static_cast<int>(materialManager.materials.size()))
-                    {
-                        std::cerr << "Invalid material index for object: " << object.name << std::endl;
-                        continue; // Skip rendering this object
-                    }
-
-                    // **Main Light** (object vs. main light) for transparency
-                    float deltaObjectTrans = 20.5f - object.position.x;
-                    float deltaMainLight   = 20.5f - lightPosWorld.x;
-                    bool sameRoomTrans     = (deltaObjectTrans * deltaMainLight) > 0;
-
-                    if (sameRoomTrans)
-                    {
-                        glUniform3fv(uLightPos_vsLocation, 1, glm::value_ptr(lightPosViewSpace));
-                        glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(lightIntensity));
-                    }
-                    else
-                    {
-                        glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(glm::vec3(0.0f)));
-                    }
-
-                    // **Additional Lights** (object vs. each additional light)
-                    int numLights = static_cast<int>(simpleLights.size());
-                    for (int i = 0; i < numLights; ++i)
-                    {
-                        float deltaObjForAddLight   = 20.5f - object.position.x;
-                        float deltaAdditionalLight  = 20.5f - simpleLights[i].position.x;
-                        bool sameRoomForAddLight    = (deltaObjForAddLight * deltaAdditionalLight) > 0;
-
-                        std::string idx  = std::to_string(i);
-                        GLint intenLoc   = glGetUniformLocation(currentRoom->getGLId(), ("uAdditionalLightIntensity[" + idx + "]").c_str());
-
-                        if (sameRoomForAddLight)
-                        {
-                            // Position
-                            GLint posLoc = glGetUniformLocation(currentRoom->getGLId(),
-                                            ("uAdditionalLightPos[" + idx + "]").c_str());
-                            glUniform3fv(posLoc, 1, glm::value_ptr(additionalLightPosViewSpace[i]));
-
-                            // Color
-                            GLint colorLoc = glGetUniformLocation(currentRoom->getGLId(),
-                                            ("uAdditionalLightColor[" + idx + "]").c_str());
-                            glUniform3fv(colorLoc, 1, glm::value_ptr(simpleLights[i].color));
-
-                            // Intensity
-                            glUniform1f(intenLoc, simpleLights[i].intensity);
-                        }
-                        else
-                        {
-                            glUniform1f(intenLoc, 0.0f);
-                        }
-                    }
-
-                    // Retrieve the material
-                    const Material &mat = materialManager.getMaterial(object.materialIndex);
-
-                    // **Alpha Check for Special Opaque-like Rendering (alpha == 0.9)**
-                    if (abs(mat.alpha - 0.9f) < 0.001f) {
-                        // Treat object as opaque
-                        glEnable(GL_CULL_FACE); // Enable face culling to prevent inside rendering
-                        glDepthMask(GL_TRUE);   // Enable depth writing for proper occlusion
-                        glDisable(GL_BLEND);    // Disable blending for solid rendering
-                    } else {
-                        // Standard transparency handling
-                        glDisable(GL_CULL_FACE); // Disable face culling for transparency
-                        glDepthMask(GL_FALSE);   // Disable depth writing for blending
-                        glEnable(GL_BLEND);      // Ensure blending is enabled
-                    }
-
-                    // Set alpha uniform
-                    if (uAlphaLocation != -1) {
-                        glUniform1f(uAlphaLocation, mat.alpha);
-                    }
-
-                    // Calculate model matrix
-                    glm::mat4 modelMatrix = glm::mat4(1.0f);
-                    modelMatrix = glm::translate(modelMatrix, object.position);
-                    if (object.rotationAngle != 0.0f)
-                    {
-                        modelMatrix = glm::rotate(modelMatrix, glm::radians(object.rotationAngle), object.rotationAxis);
-                    }
-                    modelMatrix = glm::scale(modelMatrix, object.scale);
-
-                    glm::mat4 mvMatrix = ViewMatrix * modelMatrix;
-                    glm::mat4 mvpMatrix = ProjMatrix * mvMatrix;
-                    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(mvMatrix)));
-
-                    // Set transform uniforms
-                    glUniformMatrix4fv(uModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-                    glUniformMatrix4fv(uMVMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-                    glUniformMatrix4fv(uMVPMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-                    glUniformMatrix3fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-                    // 1) Diffuse color
-                    if (uKdLocation != -1)
-                    {
-                        glUniform3fv(uKdLocation, 1, glm::value_ptr(mat.Kd));
-                    }
-
-                    // 2) Specular color
-                    if (uKsLocation != -1)
-                    {
-                        glUniform3fv(uKsLocation, 1, glm::value_ptr(mat.Ks));
-                    }
-
-                    // 3) Shininess
-                    if (uShininessLocation != -1)
-                    {
-                        glUniform1f(uShininessLocation, mat.shininess);
-                    }
-
-                    // 4) Diffuse texture
-                    if (mat.hasDiffuseMap && mat.diffuseMapID != 0)
-                    {
-                        glActiveTexture(GL_TEXTURE0);
-                        glBindTexture(GL_TEXTURE_2D, mat.diffuseMapID);
-                        if (uTextureLocation != -1)
-                        {
-                            glUniform1i(uTextureLocation, 0);
-                        }
-                        if (uUseTextureLocation != -1)
-                        {
-                            glUniform1f(uUseTextureLocation, 1.0f);
-                        }
-                    }
-                    else
-                    {
-                        if (uUseTextureLocation != -1)
-                        {
-                            glUniform1f(uUseTextureLocation, 0.0f);
-                        }
-                    }
-
-                    // 5) Normal map
-                    GLint uNormalMapLoc = glGetUniformLocation(currentRoom->getGLId(), "uNormalMap");
-                    GLint uUseNormalMapLoc = glGetUniformLocation(currentRoom->getGLId(), "uUseNormalMap");
-                    if (mat.hasNormalMap && mat.normalMapID != 0)
-                    {
-                        glActiveTexture(GL_TEXTURE2);
-                        glBindTexture(GL_TEXTURE_2D, mat.normalMapID);
-                        if (uNormalMapLoc != -1)
-                        {
-                            glUniform1i(uNormalMapLoc, 2);
-                        }
-                        if (uUseNormalMapLoc != -1)
-                        {
-                            glUniform1f(uUseNormalMapLoc, 1.0f);
-                        }
-                    }
-                    else
-                    {
-                        if (uUseNormalMapLoc != -1)
-                        {
-                            glUniform1f(uUseNormalMapLoc, 0.0f);
-                        }
-                    }
-
-                    // 6) Specular map
-                    GLint uSpecularMapLocation = glGetUniformLocation(currentRoom->getGLId(), "uSpecularMap");
-                    GLint uUseSpecularMapLocation = glGetUniformLocation(currentRoom->getGLId(), "uUseSpecularMap");
-                    if (mat.hasSpecularMap && mat.specularMapID != 0)
-                    {
-                        glActiveTexture(GL_TEXTURE3); // Use texture unit 3 for specular maps
-                        glBindTexture(GL_TEXTURE_2D, mat.specularMapID);
-                        if (uSpecularMapLocation != -1)
-                        {
-                            glUniform1i(uSpecularMapLocation, 3); // Set sampler to texture unit 3
-                        }
-                        if (uUseSpecularMapLocation != -1)
-                        {
-                            glUniform1f(uUseSpecularMapLocation, 1.0f); // Enable specular map usage
-                        }
-                    }
-                    else
-                    {
-                        if (uUseSpecularMapLocation != -1)
-                        {
-                            glUniform1f(uUseSpecularMapLocation, 0.0f); // Disable specular map usage
-                        }
-                    }
-
-                    // Draw transparent object
-                    glBindVertexArray(object.vaoID);
-                    if (object.type == utils_scene::ObjectType::Cube)
-                    {
-                        glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-                    }
-                    else if (object.type == utils_scene::ObjectType::Sphere)
-                    {
-                        glDrawArrays(GL_TRIANGLES, 0, object.indexCount);
-                    }
-                    else if (object.type == utils_scene::ObjectType::Model)
-                    {
-                        glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-                    }
-                    glBindVertexArray(0);
-
-                    // (Optional) unbind textures afterwards
-                    glActiveTexture(GL_TEXTURE0);
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                    glActiveTexture(GL_TEXTURE2);
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                    glActiveTexture(GL_TEXTURE3);
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                }
+                glUniform1f(currentRoom->getUniformLocation(utils_loader::Uniform::ChromaticPass), 1.0f);
             }
 
-            // Restore default blending
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-            // Restore depth writing
-            glDepthMask(GL_TRUE);
-
-            // Reset colorMask to default (no shift)
-            glm::vec3 defaultColorMask = glm::vec3(1.0f, 1.0f, 1.0f);
-            glUniform3fv(room2_uColorMaskLocation, 1, glm::value_ptr(defaultColorMask));
-        }
-        else // ELSE (cameraPos.x < 20.5f, not in Room 2)
-        {
-            // =======================
-            // **Normal Rendering (No RGB Shift)**
-            // =======================
+            // Other passes changed the bindings since the opaque objects were drawn
+            renderState.invalidate();
 
-            // Render all transparent objects normally
-            if (!utils_scene::sceneObjectsTransparent.empty())
+            // Iterate over each transparent object
+            const utils_scene::SceneStore &transparentObjects = utils_scene::sceneObjectsTransparent;
+            for (size_t slot : transparentOrder)
             {
-                // Enable standard alpha blending
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-                // Disable depth writing for transparency
-                glDepthMask(GL_FALSE);
-
-                for (const auto &object : utils_scene::sceneObjectsTransparent)
+                if (!transparentVisible[slot])
                 {
-                    // Check material index validity
-                    if (object.materialIndex < 0 || object.materialIndex >= static_cast<int>(materialManager.materials.size()))
-                    {
-                        std::cerr << "Invalid material index for object: " << object.name << std::endl;
-                        continue; // Skip rendering this object
-                    }
-
-                    // **Main Light** (object vs. main light) for transparency
-                    float deltaObjectTrans = 20.5f - object.position.x;
-                    float deltaMainLight   = 20.5f - lightPosWorld.x;
-                    bool sameRoomTrans     = (deltaObjectTrans * deltaMainLight) > 0;
-
-                    if (sameRoomTrans)
-                    {
-                        glUniform3fv(uLightPos_vsLocation, 1, glm::value_ptr(lightPosViewSpace));
-                        glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(lightIntensity));
-                    }
-                    else
-                    {
-                        glUniform3fv(uLightIntensityLocation, 1, glm::value_ptr(glm::vec3(0.0f)));
-                    }
-
-                    // **Additional Lights** (object vs. each additional light)
-                    int numLights = static_cast<int>(simpleLights.size());
-                    for (int i = 0; i < numLights; ++i)
-                    {
-                        float deltaObjForAddLight   = 20.5f - object.position.x;
-                        float deltaAdditionalLight  = 20.5f - simpleLights[i].position.x;
-                        bool sameRoomForAddLight    = (deltaObjForAddLight * deltaAdditionalLight) > 0;
-
-                        std::string idx  = std::to_string(i);
-                        GLint intenLoc   = glGetUniformLocation(currentRoom->getGLId(), ("uAdditionalLightIntensity[" + idx + "]").c_str());
-
-                        if (sameRoomForAddLight)
-                        {
-                            // Position
-                            GLint posLoc = glGetUniformLocation(currentRoom->getGLId(),
-                                            ("uAdditionalLightPos[" + idx + "]").c_str());
-                            glUniform3fv(posLoc, 1, glm::value_ptr(additionalLightPosViewSpace[i]));
-
-                            // Color
-                            GLint colorLoc = glGetUniformLocation(currentRoom->getGLId(),
-                                            ("uAdditionalLightColor[" + idx + "]").c_str());
-                            glUniform3fv(colorLoc, 1, glm::value_ptr(simpleLights[i].color));
-
-                            // Intensity
-                            glUniform1f(intenLoc, simpleLights[i].intensity);
-                        }
-                        else
-                        {
-                            glUniform1f(intenLoc, 0.0f);
-                        }
-                    }
-
-                    // Retrieve the material
-                    const Material &mat = materialManager.getMaterial(object.materialIndex);
-
-                    // **Alpha Check for Special Opaque-like Rendering (alpha == 0.9)**
-                    if (abs(mat.alpha - 0.9f) < 0.001f) {
-                        // Treat object as opaque
-                        glEnable(GL_CULL_FACE); // Enable face culling to prevent inside rendering
-                        glDepthMask(GL_TRUE);   // Enable depth writing for proper occlusion
-                        glDisable(GL_BLEND);    // Disable blending for solid rendering
-                    } else {
-                        // Standard transparency handling
-                        glDisable(GL_CULL_FACE); // Disable face culling for transparency
-                        glDepthMask(GL_FALSE);   // Disable depth writing for blending
-                        glEnable(GL_BLEND);      // Ensure blending is enabled
-                        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Standard alpha blending
-                    }
+                    continue;
+                }
 
-                    // Set alpha uniform
-                    if (uAlphaLocation != -1) {
-                        glUniform1f(uAlphaLocation, mat.alpha);
-                    }
+                const utils_scene::RenderItem &item = transparentObjects.renderItems[slot];
 
-                    // Calculate model matrix
-                    glm::mat4 modelMatrix = glm::mat4(1.0f);
-                    modelMatrix = glm::translate(modelMatrix, object.position);
-                    if (object.rotationAngle != 0.0f)
-                    {
-                        modelMatrix = glm::rotate(modelMatrix, glm::radians(object.rotationAngle), object.rotationAxis);
-                    }
-                    modelMatrix = glm::scale(modelMatrix, object.scale);
+                // Check material index validity
+                if (item.materialIndex < 0 || item.materialIndex >= static_cast<int>(materialManager.materials.size()))
+                {
+                    std::cerr << "Invalid material index for object: " << transparentObjects.names[slot] << std::endl;
+                    continue; // Skip rendering this object
+                }
 
-                    glm::mat4 mvMatrix = ViewMatrix * modelMatrix;
-                    glm::mat4 mvpMatrix = ProjMatrix * mvMatrix;
-                    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(mvMatrix)));
+                // Retrieve the material
+                const Material &mat = materialManager.getMaterial(item.materialIndex);
 
-                    // Set transform uniforms
-                    glUniformMatrix4fv(uModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-                    glUniformMatrix4fv(uMVMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
-                    glUniformMatrix4fv(uMVPMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-                    glUniformMatrix3fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+                // **Alpha Check for Special Opaque-like Rendering (alpha == 0.9)**
+                bool opaqueLike = std::abs(mat.alpha - 0.9f) < 0.001f;
+                if (opaqueLike ? !drawOpaqueLike : !drawBlended)
+                {
+                    continue;
+                }
+                if (opaqueLike) {
+                    // Treat object as opaque
+                    glEnable(GL_CULL_FACE); // Enable face culling to prevent inside rendering
+                    glDepthMask(GL_TRUE);   // Enable depth writing for proper occlusion
+                    glDisable(GL_BLEND);    // Disable blending for solid rendering
+                } else {
+                    // Standard transparency handling
+                    glDisable(GL_CULL_FACE); // Disable face culling for transparency
+                    glDepthMask(GL_FALSE);   // Disable depth writing for blending
+                    glEnable(GL_BLEND);      // Ensure blending is enabled
+                }
 
-                    // 1) Diffuse color
-                    if (uKdLocation != -1)
-                    {
-                        glUniform3fv(uKdLocation, 1, glm::value_ptr(mat.Kd));
-                    }
+                // Lights reaching the object
+                objectLights.apply(transparentLightLists, transparentObjects.idAt(slot));
 
-                    // 2) Specular color
-                    if (uKsLocation != -1)
-                    {
-                        glUniform3fv(uKsLocation, 1, glm::value_ptr(mat.Ks));
-                    }
+                // Calculate model matrix
+                const glm::mat4 &modelMatrix = transparentObjects.worldMatrices[slot];
 
-                    // 3) Shininess
-                    if (uShininessLocation != -1)
-                    {
-                        glUniform1f(uShininessLocation, mat.shininess);
-                    }
+                glm::mat4 mvMatrix = ViewMatrix * modelMatrix;
+                glm::mat4 mvpMatrix = ProjMatrix * mvMatrix;
+                glm::mat3 normalMatrix = viewNormalMatrix * transparentObjects.normalMatrices[slot];
 
-                    // 4) Diffuse texture
-                    if (mat.hasDiffuseMap && mat.diffuseMapID != 0)
-                    {
-                        glActiveTexture(GL_TEXTURE0);
-                        glBindTexture(GL_TEXTURE_2D, mat.diffuseMapID);
-                        if (uTextureLocation != -1)
-                        {
-                            glUniform1i(uTextureLocation, 0);
-                        }
-                        if (uUseTextureLocation != -1)
-                        {
-                            glUniform1f(uUseTextureLocation, 1.0f);
-                        }
-                    }
-                    else
-                    {
-                        if (uUseTextureLocation != -1)
-                        {
-                            glUniform1f(uUseTextureLocation, 0.0f);
-                        }
-                    }
+                // Set transform uniforms
+                glUniformMatrix4fv(uModelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+                glUniformMatrix4fv(uMVMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvMatrix));
+                glUniformMatrix4fv(uMVPMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
+                glUniformMatrix3fv(uNormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+                glUniform1f(uUseInstancingLocation, item.instanceCount > 0 ? 1.0f : 0.0f);
 
-                    // 5) Normal map
-                    GLint uNormalMapLoc = glGetUniformLocation(currentRoom->getGLId(), "uNormalMap");
-                    GLint uUseNormalMapLoc = glGetUniformLocation(currentRoom->getGLId(), "uUseNormalMap");
-                    if (mat.hasNormalMap && mat.normalMapID != 0)
-                    {
-                        glActiveTexture(GL_TEXTURE2);
-                        glBindTexture(GL_TEXTURE_2D, mat.normalMapID);
-                        if (uNormalMapLoc != -1)
-                        {
-                            glUniform1i(uNormalMapLoc, 2);
-                        }
-                        if (uUseNormalMapLoc != -1)
-                        {
-                            glUniform1f(uUseNormalMapLoc, 1.0f);
-                        }
-                    }
-                    else
-                    {
-                        if (uUseNormalMapLoc != -1)
-                        {
-                            glUniform1f(uUseNormalMapLoc, 0.0f);
-                        }
-                    }
+                // Material uniforms and maps, only when the material differs from the previous draw
+                if (renderState.useMaterial(item.materialIndex))
+                {
+                    applyMaterial(mat);
+                }
 
-                    // 6) Specular map
-                    GLint uSpecularMapLocation = glGetUniformLocation(currentRoom->getGLId(), "uSpecularMap");
-                    GLint uUseSpecularMapLocation = glGetUniformLocation(currentRoom->getGLId(), "uUseSpecularMap");
-                    if (mat.hasSpecularMap && mat.specularMapID != 0)
-                    {
-                        glActiveTexture(GL_TEXTURE3); // Use texture unit 3 for specular maps
-                        glBindTexture(GL_TEXTURE_2D, mat.specularMapID);
-                        if (uSpecularMapLocation != -1)
-                        {
-                            glUniform1i(uSpecularMapLocation, 3); // Set sampler to texture unit 3
-                        }
-                        if (uUseSpecularMapLocation != -1)
-                        {
-                            glUniform1f(uUseSpecularMapLocation, 1.0f); // Enable specular map usage
-                        }
-                    }
-                    else
-                    {
-                        if (uUseSpecularMapLocation != -1)
-                        {
-                            glUniform1f(uUseSpecularMapLocation, 0.0f); // Disable specular map usage
-                        }
-                    }
+                // Draw transparent object
+                renderState.draw(item);
+            }
+            renderState.endPass();
 
-                    // Draw transparent object
-                    glBindVertexArray(object.vaoID);
-                    if (object.type == utils_scene::ObjectType::Cube)
-                    {
-                        glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-                    }
-                    else if (object.type == utils_scene::ObjectType::Sphere)
-                    {
-                        glDrawArrays(GL_TRIANGLES, 0, object.indexCount);
-                    }
-                    else if (object.type == utils_scene::ObjectType::Model)
-                    {
-                        glDrawElements(GL_TRIANGLES, object.indexCount, GL_UNSIGNED_INT, 0);
-                    }
-                    glBindVertexArray(0);
-
-                    // (Optional) unbind textures afterwards
-                    glActiveTexture(GL_TEXTURE0);
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                    glActiveTexture(GL_TEXTURE2);
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                    glActiveTexture(GL_TEXTURE3);
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                }
+            if (inRoom2)
+            {
+                glUniform1f(currentRoom->getUniformLocation(utils_loader::Uniform::ChromaticPass), 0.0f);
             }
 
             // Restore default blending
@@ -2202,7 +2135,21 @@ int main(int argc, char *argv[])
 
             // Reset colorMask to default (no shift)
             glm::vec3 defaultColorMask = glm::vec3(1.0f, 1.0f, 1.0f);
-            glUniform3fv(room2_uColorMaskLocation, 1, glm::value_ptr(defaultColorMask));
+            glUniform3fv(uColorMaskLocation, 1, glm::value_ptr(defaultColorMask));
+        };
+        if (weightedTransparency && !utils_scene::sceneObjectsTransparent.empty())
+        {
+            drawTransparentObjects(true, false);
+
+            transparencyTargets.beginAccumulation();
+            glUniform1f(currentRoom->getUniformLocation(utils_loader::Uniform::OITPass), 1.0f);
+            drawTransparentObjects(false, true);
+            glUniform1f(currentRoom->getUniformLocation(utils_loader::Uniform::OITPass), 0.0f);
+            transparencyTargets.composite(transparencyCompositeShader);
+        }
+        else
+        {
+            drawTransparentObjects(true, true);
         }
 
         
@@ -2261,9 +2208,38 @@ int main(int argc, char *argv[])
     glDeleteBuffers(1, &torusModelData.ebo);
     glDeleteVertexArrays(1, &torusModelData.vao);
 
+    // Clean up merged composite cube meshes
+    for (const auto &buffer : utils_scene::compositeMeshBuffers)
+    {
+        glDeleteBuffers(1, &buffer);
+    }
+    for (const auto &vao : utils_scene::compositeMeshVAOs)
+    {
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    // Clean up instanced groups, each owns its instance matrices and the VAO pairing them with the cube mesh
+    const utils_scene::SceneStore *instancedStores[] = {&utils_scene::sceneObjects, &utils_scene::sceneObjectsTransparent};
+    for (const utils_scene::SceneStore *store : instancedStores)
+    {
+        for (size_t slot = 0; slot < store->size(); ++slot)
+        {
+            if (store->instanceVBOs[slot] != 0)
+            {
+                glDeleteBuffers(1, &store->instanceVBOs[slot]);
+                glDeleteVertexArrays(1, &store->renderItems[slot].vaoID);
+            }
+        }
+    }
+
     // Clean up framebuffer and texture
     glDeleteFramebuffers(1, &shadowMapFBO);
     glDeleteTextures(1, &depthCubeMap);
+    glDeleteTextures(1, &momentCubeMap);
+    shadowAtlas.release();
+    lightClusters.release();
+    gbuffer.release();
+    transparencyTargets.release();
 
     // Clean up shaders
     // depthShader.deleteProgram();
@@ -2275,12 +2251,10 @@ int main(int argc, char *argv[])
     // materialManager.clear();
 
     // Clean up scene objects
-    utils_scene::sceneObjects.clear();
-    utils_scene::sceneObjectsTransparent.clear();
-    utils_scene::sceneObjectsSkybox.clear();
+    utils_scene::clearSceneObjects();
 
     // Clean up simple lights
-    simpleLights.clear();
+    lightRegistry.clear();
 
     // other cleanup
     utils_object::allTextures.clear();
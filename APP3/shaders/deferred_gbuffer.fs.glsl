@@ -0,0 +1,70 @@
+#version 330 core
+
+// G-buffer pass of the deferred path, drawn with room1.vs: stores what the room 1 lighting reads for each surface
+
+// Input from vertex shader
+in vec3 vNormal;
+in vec3 vFragPos;
+in vec3 vFragPosWorld;
+in vec2 vTexCoords;
+in mat3 TBN;
+
+// G-buffer targets (see utils_scene::GBufferTarget)
+layout(location = 0) out vec4 gAlbedo;   // rgb albedo, a material alpha
+layout(location = 1) out vec4 gSurface;  // rgb texture color, a specular map intensity
+layout(location = 2) out vec4 gNormal;   // xyz view space normal, w shininess
+layout(location = 3) out vec4 gSpecular; // rgb specular color, a room side of the object over 2
+
+// Material properties
+uniform vec3 uKd;
+uniform vec3 uKs;
+uniform float uShininess;
+
+// Transparency
+uniform float uAlpha;
+
+// Texture samplers
+uniform sampler2D uTexture;
+uniform float uUseTexture;
+
+// Normal map
+uniform sampler2D uNormalMap;
+uniform float uUseNormalMap;
+
+// Specular map
+uniform sampler2D uSpecularMap;
+uniform float uUseSpecularMap;
+
+// Side of the room boundary of the object (utils_light::roomSide), lights of the other side do not reach it
+uniform int uObjectSide;
+
+// Hardcoded map strength, as in room1.fs
+const float NORMAL_MAP_STRENGTH = 0.3;
+
+// **Normal Map Sampling with Strength**
+vec3 GetNormalFromMap(vec3 defaultNormal) {
+    vec3 normalMap = texture(uNormalMap, vTexCoords).rgb;
+    normalMap = normalMap * 2.0 - 1.0; // Transform from [0,1] to [-1,1]
+
+    // Blend geometry normal and normal map using strength
+    return normalize(mix(defaultNormal, TBN * normalMap, NORMAL_MAP_STRENGTH));
+}
+
+void main() {
+    vec3 albedo = (uUseTexture > 0.5) ? texture(uTexture, vTexCoords).rgb : uKd;
+    vec4 texColor = texture(uTexture, vTexCoords);
+
+    // The omni-directional lighting of translucent materials uses the geometry normal
+    vec3 N = normalize(vNormal);
+    if (uAlpha >= 0.9 && uUseNormalMap > 0.5) {
+        N = GetNormalFromMap(N);
+    }
+
+    // Specular map intensity before SPECULAR_MAP_STRENGTH, 1.0 without a map
+    float specularIntensity = (uUseSpecularMap > 0.5) ? texture(uSpecularMap, vTexCoords).r : 1.0;
+
+    gAlbedo = vec4(albedo, uAlpha);
+    gSurface = vec4(texColor.rgb, specularIntensity);
+    gNormal = vec4(N, uShininess);
+    gSpecular = vec4(uKs, float(uObjectSide) * 0.5);
+}
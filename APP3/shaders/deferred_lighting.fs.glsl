@@ -0,0 +1,413 @@
+#version 330 core
+
+// Lighting pass of the deferred path: one full-screen triangle shading the G-buffer with the room 1 light model.
+// Functions shared with room1.fs are kept identical, they read the globals below instead of varyings and uniforms.
+
+// Maximum number of additional point lights
+#define MAX_ADDITIONAL_LIGHTS 100
+
+// Per-frame data, uploaded once per frame (std140, binding 0)
+layout(std140) uniform FrameData {
+    vec3 uLightPos_vs;        // Main light position in view space
+    float farPlane;
+    vec3 uMainLightIntensity; // Main light color
+    float uTime;
+    vec3 lightPosWorld;       // Main light position in world space
+    int uNumAdditionalLights;
+    vec3 cameraPosWorld;      // Camera position in world space
+};
+
+// Additional point lights (std140, binding 1)
+struct AdditionalLight {
+    vec4 position; // xyz position in view space, w intensity
+    vec4 color;    // rgb color, w shadow atlas slot or -1
+    vec4 range;    // x distance past which the light contributes nothing, y room side of the light
+};
+layout(std140) uniform LightData {
+    AdditionalLight uAdditionalLights[MAX_ADDITIONAL_LIGHTS];
+};
+
+// Froxel light lists (texture buffers, rebuilt every frame): (offset, count) per cluster, then the light indices
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+uniform usamplerBuffer uClusterGrid;
+uniform usamplerBuffer uClusterLights;
+uniform vec4 uClusterParams; // xy projection scales, slice = log(depth) * z + w
+
+// Shadow atlas of the additional lights (std140, binding 3), six cube face tiles per shadowed light
+#define MAX_SHADOWED_LIGHTS 10
+#define SHADOW_ATLAS_TILES_PER_ROW 8
+layout(std140) uniform ShadowAtlasData {
+    mat4 uAtlasFaceMatrices[MAX_SHADOWED_LIGHTS * 6]; // View-projection each tile was rendered with
+    vec4 uAtlasFaceLights[MAX_SHADOWED_LIGHTS * 6];   // xyz light position each tile was rendered from, w far plane
+    vec4 uAtlasLights[MAX_SHADOWED_LIGHTS];           // xyz light position picking the face of a lookup
+};
+uniform sampler2DShadow uShadowAtlas;
+
+// G-buffer (see utils_scene::GBufferTarget), read texel for texel
+uniform sampler2D uGAlbedo;   // rgb albedo, a material alpha
+uniform sampler2D uGSurface;  // rgb texture color, a specular map intensity
+uniform sampler2D uGNormal;   // xyz view space normal, w shininess
+uniform sampler2D uGSpecular; // rgb specular color, a room side of the object over 2
+uniform sampler2D uGDepth;
+
+uniform mat4 uInverseProjection;
+uniform mat4 uInverseView;
+uniform int uMainLightSide; // Room side of the main light
+
+in vec2 vScreenUV;
+
+out vec4 FragColor;
+
+// Surface being shaded, named after the varyings and uniforms of room1.fs
+vec3 vFragPos = vec3(0.0);
+vec3 vFragPosWorld = vec3(0.0);
+vec3 uKs = vec3(0.0);
+float uShininess = 1.0;
+float uAlpha = 1.0;
+float uReceivesMainLight = 0.0;
+float specularMapIntensity = 1.0;
+int objectSide = 0;
+
+// Shadow filter, chosen by the application for the current shadow tier
+#define SHADOW_FILTER_SAMPLED 0     // Kernel of depth reads compared in the shader
+#define SHADOW_FILTER_PCF 1         // Hardware depth comparison over a fixed Poisson kernel
+#define SHADOW_FILTER_ADAPTIVE 2    // 4 comparison taps, the full kernel only in penumbrae
+#define SHADOW_FILTER_EXPONENTIAL 3 // Prefiltered exponential shadow map
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_SAMPLED
+#endif
+#ifndef SHADOW_FILTER_TAPS
+#define SHADOW_FILTER_TAPS 16
+#endif
+#ifndef ESM_EXPONENT
+#define ESM_EXPONENT 80.0
+#endif
+
+// Shadow mapping
+#if SHADOW_FILTER == SHADOW_FILTER_PCF || SHADOW_FILTER == SHADOW_FILTER_ADAPTIVE
+uniform samplerCubeShadow depthMap;
+#else
+uniform samplerCube depthMap; // Distance to the light over farPlane, exp(ESM_EXPONENT * distance) in the exponential mode
+#endif
+
+// Hardcoded map strength, as in room1.fs
+const float SPECULAR_MAP_STRENGTH = 3.0;
+
+// Sampling offsets for shadow mapping
+const vec3 gridSamplingDisk[20] = vec3[](
+    vec3( 1,  0,  0), vec3(-1,  0,  0), vec3( 0,  1,  0), vec3( 0, -1,  0), 
+    vec3( 0,  0,  1), vec3( 0,  0, -1), vec3( 1,  1,  0), vec3(-1,  1,  0), 
+    vec3( 1, -1,  0), vec3(-1, -1,  0), vec3( 1,  0,  1), vec3(-1,  0,  1), 
+    vec3( 1,  0, -1), vec3(-1,  0, -1), vec3( 0,  1,  1), vec3( 0, -1,  1), 
+    vec3( 0,  1, -1), vec3( 0, -1, -1), vec3( 1,  1,  1), vec3(-1, -1, -1)
+);
+
+// Fixed Poisson kernel of the comparison modes, the first 4 taps are spread for the adaptive pre-test
+const vec3 poissonKernel[16] = vec3[](
+    vec3( 0.491,  0.491,  0.491), vec3( 0.491, -0.491, -0.491),
+    vec3(-0.491,  0.491, -0.491), vec3(-0.491, -0.491,  0.491),
+    vec3( 0.140,  0.321,  0.000), vec3(-0.341,  0.525,  0.313),
+    vec3( 0.032,  0.262, -0.364), vec3( 0.442,  0.333,  0.577),
+    vec3(-0.524,  0.137, -0.093), vec3( 0.757,  0.075, -0.481),
+    vec3(-0.168, -0.054,  0.626), vec3(-0.179, -0.100, -0.344),
+    vec3( 0.640, -0.313,  0.234), vec3(-0.375, -0.292,  0.155),
+    vec3( 0.238, -0.637, -0.509), vec3( 0.072, -0.550,  0.229)
+);
+
+float Random(vec3 seed, int i) {
+    return fract(sin(dot(seed + vec3(i), vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
+// **Shadow Calculation**
+#if SHADOW_FILTER == SHADOW_FILTER_PCF || SHADOW_FILTER == SHADOW_FILTER_ADAPTIVE
+// Sum of the lit fraction of kernel taps [first, first + count), each tap is a hardware 2x2 comparison
+float LitTaps(vec3 fragToLight, float reference, float radius, int first, int count) {
+    float lit = 0.0;
+    for (int i = first; i < first + count; ++i) {
+        lit += texture(depthMap, vec4(fragToLight + poissonKernel[i] * radius, reference));
+    }
+    return lit;
+}
+#endif
+
+float ShadowCalculation(vec3 fragPosWorld) {
+#if SHADOW_FILTER != SHADOW_FILTER_SAMPLED
+    vec3 fragToLight = fragPosWorld - lightPosWorld;
+    float currentDepth = length(fragToLight);
+    float bias = 0.25;
+    float viewDistance = length(cameraPosWorld - fragPosWorld);
+    float diskRadius = (0.25 + (viewDistance / farPlane)) / 20.0;
+    float reference = (currentDepth - bias) / farPlane;
+#endif
+
+#if SHADOW_FILTER == SHADOW_FILTER_PCF
+    float lit = LitTaps(fragToLight, reference, diskRadius, 0, SHADOW_FILTER_TAPS);
+    return (1.0 - lit / float(SHADOW_FILTER_TAPS)) * 0.8;
+#elif SHADOW_FILTER == SHADOW_FILTER_ADAPTIVE
+    // Taps that all agree mean the fragment is not in a penumbra
+    float lit = LitTaps(fragToLight, reference, diskRadius, 0, 4);
+    if (lit < 0.001 || lit > 3.999) {
+        return (1.0 - lit / 4.0) * 0.8;
+    }
+    lit += LitTaps(fragToLight, reference, diskRadius, 4, SHADOW_FILTER_TAPS - 4);
+    return (1.0 - lit / float(SHADOW_FILTER_TAPS)) * 0.8;
+#elif SHADOW_FILTER == SHADOW_FILTER_EXPONENTIAL
+    // Mipmapped exp(c * occluder), visibility exp(c * (occluder - receiver)) saturates to 1 when lit
+    float occluder = texture(depthMap, fragToLight).r;
+    float visibility = clamp(occluder * exp(-ESM_EXPONENT * reference), 0.0, 1.0);
+    return (1.0 - visibility) * 0.8;
+#else
+    vec3 fragToLight = fragPosWorld - lightPosWorld;
+    float currentDepth = length(fragToLight);
+    float shadow = 0.0;
+    float bias = 0.25; // Reduced bias for accuracy
+    int samples = 25; // Number of random samples
+    float viewDistance = length(cameraPosWorld - fragPosWorld);
+    float diskRadius = (0.25 + (viewDistance / farPlane)) / 20.0; // Adjust blur radius (putting lwoer to hide the jagged edges)
+
+    float totalWeight = 0.0;
+
+    for (int i = 0; i < samples; ++i) {
+        // Random offsets based on the fragment position and loop index
+        float randX = Random(fragPosWorld, i) * 2.0 - 1.0;
+        float randY = Random(fragPosWorld, i + samples) * 2.0 - 1.0;
+        float randZ = Random(fragPosWorld, i + samples * 2) * 2.0 - 1.0;
+
+        vec3 offset = vec3(randX, randY, randZ) * diskRadius;
+        vec3 samplePos = fragToLight + offset;
+
+        float closestDepth = texture(depthMap, samplePos).r * farPlane;
+
+        if (currentDepth - bias > closestDepth) {
+            shadow += 1.0;
+        }
+        totalWeight += 1.0;
+    }
+
+    shadow /= totalWeight; // Normalize the shadow value
+    return shadow * 0.8;
+#endif
+}
+
+// **Specular Intensity from Map with Strength**
+float GetSpecularIntensity() {
+    return specularMapIntensity * SPECULAR_MAP_STRENGTH;
+}
+
+// Main light color as seen by the current object
+vec3 MainLightIntensity() {
+    return uMainLightIntensity * uReceivesMainLight;
+}
+
+// **Main Light - Diffuse**
+vec3 MainLightDiffuse(vec3 albedo, vec3 N) {
+    vec3 L = normalize(uLightPos_vs - vFragPos);
+    float distance = length(uLightPos_vs - vFragPos);
+    // float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
+    float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.010 * distance);
+
+    float NdotL = max(dot(N, L), 0.0);
+    return albedo * MainLightIntensity() * NdotL * attenuation;
+}
+
+// **Main Light - Specular**
+vec3 MainLightSpecular(vec3 N) {
+    vec3 L = normalize(uLightPos_vs - vFragPos);
+    vec3 V = normalize(-vFragPos); 
+    vec3 H = normalize(L + V);
+
+    float distance = length(uLightPos_vs - vFragPos);
+    // float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
+    float attenuation = 1.0 / (1.0 + 0.005 * distance + 0.021 * distance);
+
+    float NdotH = max(dot(N, H), 0.0);
+    float specularIntensity = GetSpecularIntensity();
+    return uKs * specularIntensity * MainLightIntensity() * pow(NdotH, uShininess) * attenuation;
+}
+
+// Cluster of a view space position, -1 outside the froxel grid
+int ClusterIndex(vec3 viewPos) {
+    float depth = -viewPos.z;
+    if (depth <= 0.0) {
+        return -1;
+    }
+    vec2 ndc = viewPos.xy / depth * uClusterParams.xy;
+    int slice = int(floor(log(depth) * uClusterParams.z + uClusterParams.w));
+    if (abs(ndc.x) > 1.0 || abs(ndc.y) > 1.0 || slice < 0 || slice >= CLUSTER_SLICES) {
+        return -1;
+    }
+    ivec2 tile = min(ivec2((ndc * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+// k-th light of the fragment's cluster, or the k-th light outside the grid
+int ClusterLight(int cluster, uvec2 entry, int k) {
+    return cluster >= 0 ? int(texelFetch(uClusterLights, int(entry.x) + k).r) : k;
+}
+
+// Fades an additional light out over the last quarter of its range
+float RangeWindow(int i, float distance) {
+    float range = uAdditionalLights[i].range.x;
+    return 1.0 - smoothstep(0.75 * range, range, distance);
+}
+
+// Shadow of an additional light from its atlas slot (color.w of the light), 0.0 without a slot
+float AtlasShadow(float atlasSlot) {
+    if (atlasSlot < 0.0) {
+        return 0.0;
+    }
+    int slot = int(atlasSlot);
+    vec3 toFrag = vFragPosWorld - uAtlasLights[slot].xyz;
+    vec3 axis = abs(toFrag);
+    int face = (axis.x >= axis.y && axis.x >= axis.z) ? (toFrag.x > 0.0 ? 0 : 1)
+             : (axis.y >= axis.z) ? (toFrag.y > 0.0 ? 2 : 3)
+             : (toFrag.z > 0.0 ? 4 : 5);
+    int tile = slot * 6 + face;
+
+    // Bias grows with the distance to the light, as the world size of a tile texel does
+    float lightDistance = length(vFragPosWorld - uAtlasFaceLights[tile].xyz);
+    float reference = (lightDistance - 0.05 - 0.02 * lightDistance) / uAtlasFaceLights[tile].w;
+    if (reference >= 1.0) {
+        return 0.0; // Out of the light's reach
+    }
+
+    // Tile coordinates, kept half a texel inside so the 2x2 comparison does not read the neighbouring tile
+    vec4 clip = uAtlasFaceMatrices[tile] * vec4(vFragPosWorld, 1.0);
+    float tileTexels = float(textureSize(uShadowAtlas, 0).x) / float(SHADOW_ATLAS_TILES_PER_ROW);
+    vec2 uv = clamp(clip.xy / clip.w * 0.5 + 0.5, 0.5 / tileTexels, 1.0 - 0.5 / tileTexels);
+    vec2 atlasUV = (vec2(tile % SHADOW_ATLAS_TILES_PER_ROW, tile / SHADOW_ATLAS_TILES_PER_ROW) + uv) / float(SHADOW_ATLAS_TILES_PER_ROW);
+    return 1.0 - texture(uShadowAtlas, vec3(atlasUV, reference));
+}
+
+// **Additional Lights**, the cluster lights of the object's side
+vec3 AdditionalLights(vec3 albedo, vec3 N) {
+    vec3 totalLight = vec3(0.0);
+
+    int cluster = ClusterIndex(vFragPos);
+    uvec2 entry = cluster >= 0 ? texelFetch(uClusterGrid, cluster).xy : uvec2(0u);
+    int lightCount = cluster >= 0 ? int(entry.y) : uNumAdditionalLights;
+    for (int k = 0; k < lightCount; ++k) {
+        int i = ClusterLight(cluster, entry, k);
+        if (int(uAdditionalLights[i].range.y) != objectSide) {
+            continue;
+        }
+        float distance = length(uAdditionalLights[i].position.xyz - vFragPos);
+        float window = RangeWindow(i, distance);
+        if (window <= 0.0) {
+            continue;
+        }
+
+        vec3 L = normalize(uAdditionalLights[i].position.xyz - vFragPos);
+        vec3 V = normalize(-vFragPos); 
+        vec3 H = normalize(L + V);
+
+        float attenuation = window / (1.0 + 0.06 * distance + 0.052 * distance * distance);
+
+        float NdotL = max(dot(N, L), 0.0);
+        float NdotH = max(dot(N, H), 0.0);
+
+        float specularIntensity = GetSpecularIntensity();
+
+        vec3 diffuse = albedo * uAdditionalLights[i].color.rgb * NdotL * uAdditionalLights[i].position.w * attenuation;
+        vec3 specular = uKs * specularIntensity * uAdditionalLights[i].color.rgb * pow(NdotH, uShininess) * uAdditionalLights[i].position.w * attenuation;
+
+        totalLight += (diffuse + specular) * (1.0 - AtlasShadow(uAdditionalLights[i].color.w));
+    }
+
+    return totalLight;
+}
+
+// **Omni-Directional Lighting for Transparency**
+vec3 CalculateOmniDirectionalLighting(vec3 albedo, vec3 N) {
+    vec3 omniLight = vec3(0.0);
+
+    // Main Light Contribution
+    float distance = length(uLightPos_vs - vFragPos);
+    float attenuation = 1.0 / (1.0 + 0.05 * distance + 0.01 * distance * distance);
+    vec3 L = normalize(uLightPos_vs - vFragPos);
+
+    float NdotL = max(dot(N, L), 0.0);       
+    float NdotL_inv = max(dot(-N, L), 0.0);  
+
+    // Reduce weight for side directions
+    float weight = (NdotL > 0.5 || NdotL_inv > 0.5) ? 1.0 : 0.5; 
+
+    omniLight += albedo * MainLightIntensity() * attenuation * weight;
+
+    // Additional Lights Contribution
+    int cluster = ClusterIndex(vFragPos);
+    uvec2 entry = cluster >= 0 ? texelFetch(uClusterGrid, cluster).xy : uvec2(0u);
+    int lightCount = cluster >= 0 ? int(entry.y) : uNumAdditionalLights;
+    for (int k = 0; k < lightCount; ++k) {
+        int i = ClusterLight(cluster, entry, k);
+        if (int(uAdditionalLights[i].range.y) != objectSide) {
+            continue;
+        }
+        float distance_add = length(uAdditionalLights[i].position.xyz - vFragPos);
+        float attenuation_add = RangeWindow(i, distance_add) / (1.0 + 0.05 * distance_add + 0.01 * distance_add * distance_add);
+        vec3 L_add = normalize(uAdditionalLights[i].position.xyz - vFragPos);
+
+        float NdotL_add = max(dot(N, L_add), 0.0);
+        float NdotL_inv_add = max(dot(-N, L_add), 0.0);
+
+        float weight_add = (NdotL_add > 0.5 || NdotL_inv_add > 0.5) ? 1.0 : 0.5; 
+
+        omniLight += albedo * uAdditionalLights[i].color.rgb * uAdditionalLights[i].position.w * attenuation_add * weight_add;
+    }
+
+    return omniLight * uAlpha;
+}
+
+void main() {
+    // Nothing was drawn here, keep the cleared color and depth
+    float depth = texture(uGDepth, vScreenUV).r;
+    if (depth >= 1.0) {
+        discard;
+    }
+    gl_FragDepth = depth;
+
+    vec4 view = uInverseProjection * vec4(vec3(vScreenUV, depth) * 2.0 - 1.0, 1.0);
+    vFragPos = view.xyz / view.w;
+    vFragPosWorld = (uInverseView * vec4(vFragPos, 1.0)).xyz;
+
+    vec4 albedoAlpha = texture(uGAlbedo, vScreenUV);
+    vec4 surface = texture(uGSurface, vScreenUV);
+    vec4 normalShininess = texture(uGNormal, vScreenUV);
+    vec4 specular = texture(uGSpecular, vScreenUV);
+
+    vec3 albedo = albedoAlpha.rgb;
+    vec3 N = normalize(normalShininess.xyz);
+    uKs = specular.rgb;
+    uShininess = normalShininess.w;
+    uAlpha = albedoAlpha.a;
+    specularMapIntensity = surface.a;
+    objectSide = int(specular.a * 2.0 + 0.5);
+    uReceivesMainLight = (objectSide != 0 && objectSide == uMainLightSide) ? 1.0 : 0.0;
+
+    // Same material paths as room1.fs, the alpha went through 8 bits
+    vec3 lighting = vec3(0.0);
+    if (abs(uAlpha - 0.9) < 0.004) {
+        // **Special Case: Flat Texture Render for alpha == 0.9**
+        lighting = albedo;
+    }
+    else if (uAlpha < 0.9) {
+        // **Transparent Material: Omni-Directional Lighting**
+        lighting = CalculateOmniDirectionalLighting(albedo, N);
+    }
+    else {
+        // **Fully Opaque Path: Standard Lighting with Shadows**
+        float shadow = ShadowCalculation(vFragPosWorld);
+
+        vec3 mainDiffuse = MainLightDiffuse(albedo, N);
+        vec3 mainSpecular = MainLightSpecular(N);
+        vec3 mainLighting = (mainDiffuse + mainSpecular) * (1.0 - shadow);
+
+        vec3 additionalLighting = AdditionalLights(albedo, N);
+
+        lighting = mainLighting + additionalLighting;
+    }
+
+    FragColor = vec4(lighting * surface.rgb, uAlpha);
+}
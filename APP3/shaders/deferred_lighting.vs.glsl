@@ -0,0 +1,11 @@
+#version 330 core
+
+// Full-screen triangle of the deferred lighting and transparency composite passes, drawn without vertex attributes
+
+out vec2 vScreenUV;
+
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    vScreenUV = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+// Weighted blended transparency composite: the weighted average of the transparent fragments of each pixel,
+// covering the opaque frame by one minus the product of their transparencies
+
+in vec2 vScreenUV;
+
+uniform sampler2D uAccumulation; // rgb sum of the weighted premultiplied colors, a revealage
+uniform sampler2D uWeights;      // rgb sum of the weights, per channel
+
+out vec4 FragColor;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(uAccumulation, texel, 0);
+    float revealage = accumulation.a;
+    if (revealage >= 1.0) {
+        discard;
+    }
+
+    vec3 weights = texelFetch(uWeights, texel, 0).rgb;
+    vec3 color = accumulation.rgb / max(weights, vec3(1e-5));
+
+    // Blended with (ONE_MINUS_SRC_ALPHA, SRC_ALPHA)
+    FragColor = vec4(color, revealage);
+}
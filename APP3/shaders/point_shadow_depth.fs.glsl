@@ -3,8 +3,25 @@ in vec4 FragPos;
 uniform vec3 lightPos;
 uniform float farPlane;
 
+// Shadow filter, chosen by the application for the current shadow tier (values as in the room shaders)
+#define SHADOW_FILTER_SAMPLED 0
+#define SHADOW_FILTER_EXPONENTIAL 3 // Also writes the exponential moment of the depth
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_SAMPLED
+#endif
+#ifndef ESM_EXPONENT
+#define ESM_EXPONENT 80.0
+#endif
+
+#if SHADOW_FILTER == SHADOW_FILTER_EXPONENTIAL
+layout(location = 0) out float FragMoment;
+#endif
+
 void main() {
     float lightDistance = length(FragPos.xyz - lightPos);
     lightDistance = lightDistance / farPlane;
     gl_FragDepth = lightDistance;
-}
\ No newline at end of file
+#if SHADOW_FILTER == SHADOW_FILTER_EXPONENTIAL
+    FragMoment = exp(ESM_EXPONENT * lightDistance);
+#endif
+}
@@ -1,10 +1,13 @@
 #version 330 core
 layout(location = 0) in vec3 aPosition;
+layout(location = 5) in mat4 aInstanceMatrix; // Per-instance model matrix (instanced groups)
 uniform mat4 model;
 uniform mat4 shadowMatrix;
+uniform float uUseInstancing; // 1.0 when drawing an instanced group
 out vec4 FragPos;
 
 void main() {
-    FragPos = model * vec4(aPosition, 1.0);
+    mat4 instanceMatrix = (uUseInstancing > 0.5) ? aInstanceMatrix : mat4(1.0);
+    FragPos = model * instanceMatrix * vec4(aPosition, 1.0);
     gl_Position = shadowMatrix * FragPos;
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 330 core
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 18) out;
+
+// View-projection matrix of each cube map face, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order
+layout(std140) uniform ShadowData {
+    mat4 uShadowMatrices[6];
+};
+
+// Bit f is set when the caster overlaps the frustum of face f
+uniform int uFaceMask;
+
+out vec4 FragPos;
+
+void main() {
+    // Emit every triangle once per overlapped face, gl_Layer selects the cube map face
+    for (int face = 0; face < 6; ++face) {
+        if ((uFaceMask & (1 << face)) == 0) {
+            continue;
+        }
+        gl_Layer = face;
+        for (int i = 0; i < 3; ++i) {
+            FragPos = gl_in[i].gl_Position;
+            gl_Position = uShadowMatrices[face] * FragPos;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
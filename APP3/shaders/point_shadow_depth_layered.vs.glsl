@@ -0,0 +1,11 @@
+#version 330 core
+layout(location = 0) in vec3 aPosition;
+layout(location = 5) in mat4 aInstanceMatrix; // Per-instance model matrix (instanced groups)
+uniform mat4 model;
+uniform float uUseInstancing; // 1.0 when drawing an instanced group
+
+void main() {
+    mat4 instanceMatrix = (uUseInstancing > 0.5) ? aInstanceMatrix : mat4(1.0);
+    // World space position, projected per cube face by the geometry shader
+    gl_Position = model * instanceMatrix * vec4(aPosition, 1.0);
+}
@@ -5,6 +5,7 @@ layout(location = 1) in vec3 aNormal;       // Vertex normal
 layout(location = 2) in vec2 aTexCoords;    // Texture coordinates
 layout(location = 3) in vec3 aTangent;      // Tangent vector
 layout(location = 4) in vec3 aBitangent;    // Bitangent vector
+layout(location = 5) in mat4 aInstanceMatrix; // Per-instance model matrix (instanced groups)
 
 // Uniforms
 uniform mat4 uMVPMatrix;
@@ -12,6 +13,7 @@ uniform mat4 uMVMatrix;
 uniform mat3 uNormalMatrix;
 uniform mat4 lightSpaceMatrix;
 uniform mat4 uModelMatrix;
+uniform float uUseInstancing; // 1.0 when drawing an instanced group
 
 out vec3 vNormal;
 out vec3 vFragPos;
@@ -22,21 +24,26 @@ out vec3 vFragPosWorld;
 
 void main()
 {
-    vNormal = normalize(uNormalMatrix * aNormal);
-    vFragPos = vec3(uMVMatrix * vec4(aPosition, 1.0));
+    // Instance matrices are relative to the object model matrix
+    mat4 instanceMatrix = (uUseInstancing > 0.5) ? aInstanceMatrix : mat4(1.0);
+    vec4 localPosition = instanceMatrix * vec4(aPosition, 1.0);
+    mat3 normalMatrix = uNormalMatrix * mat3(instanceMatrix);
+
+    vNormal = normalize(normalMatrix * aNormal);
+    vFragPos = vec3(uMVMatrix * localPosition);
     vTexCoords = aTexCoords;
     
     // Calculate world space fragment position
-    vFragPosWorld = vec3(uModelMatrix * vec4(aPosition, 1.0));
+    vFragPosWorld = vec3(uModelMatrix * localPosition);
 
     // Transform TBN vectors into view space
-    vec3 T = normalize(uNormalMatrix * aTangent);
-    vec3 B = normalize(uNormalMatrix * aBitangent);
-    vec3 N = normalize(uNormalMatrix * aNormal);
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 B = normalize(normalMatrix * aBitangent);
+    vec3 N = normalize(normalMatrix * aNormal);
     TBN = mat3(T, B, N);
 
     // Transform fragment position to light space
-    vFragPosLightSpace = lightSpaceMatrix * uModelMatrix * vec4(aPosition, 1.0);
+    vFragPosLightSpace = lightSpaceMatrix * uModelMatrix * localPosition;
 
-    gl_Position = uMVPMatrix * vec4(aPosition, 1.0);
+    gl_Position = uMVPMatrix * localPosition;
 }
\ No newline at end of file
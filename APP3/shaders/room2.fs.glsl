@@ -3,11 +3,50 @@
 // Maximum number of additional point lights
 #define MAX_ADDITIONAL_LIGHTS 100
 
-// Uniforms for additional point lights
-uniform int uNumAdditionalLights;
-uniform vec3 uAdditionalLightPos[MAX_ADDITIONAL_LIGHTS];      
-uniform vec3 uAdditionalLightColor[MAX_ADDITIONAL_LIGHTS];
-uniform float uAdditionalLightIntensity[MAX_ADDITIONAL_LIGHTS];
+// Per-frame data, uploaded once per frame (std140, binding 0)
+layout(std140) uniform FrameData {
+    vec3 uLightPos_vs;        // Main light position in view space
+    float farPlane;
+    vec3 uMainLightIntensity; // Main light color
+    float uTime;
+    vec3 lightPosWorld;       // Main light position in world space
+    int uNumAdditionalLights;
+    vec3 cameraPosWorld;      // Camera position in world space
+};
+
+// Additional point lights (std140, binding 1)
+struct AdditionalLight {
+    vec4 position; // xyz position in view space, w intensity
+    vec4 color;    // rgb color, w shadow atlas slot or -1
+    vec4 range;    // x distance past which the light contributes nothing, y room side of the light
+};
+layout(std140) uniform LightData {
+    AdditionalLight uAdditionalLights[MAX_ADDITIONAL_LIGHTS];
+};
+
+// Lights reaching the current object, ascending indices into uAdditionalLights
+#define MAX_OBJECT_LIGHTS 32
+uniform int uObjectLightCount;
+uniform int uObjectLights[MAX_OBJECT_LIGHTS];
+uniform float uReceivesMainLight; // 0.0 when the main light is in the other room
+
+// Froxel light lists (texture buffers, rebuilt every frame): (offset, count) per cluster, then the light indices
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+uniform usamplerBuffer uClusterGrid;
+uniform usamplerBuffer uClusterLights;
+uniform vec4 uClusterParams; // xy projection scales, slice = log(depth) * z + w
+
+// Shadow atlas of the additional lights (std140, binding 3), six cube face tiles per shadowed light
+#define MAX_SHADOWED_LIGHTS 10
+#define SHADOW_ATLAS_TILES_PER_ROW 8
+layout(std140) uniform ShadowAtlasData {
+    mat4 uAtlasFaceMatrices[MAX_SHADOWED_LIGHTS * 6]; // View-projection each tile was rendered with
+    vec4 uAtlasFaceLights[MAX_SHADOWED_LIGHTS * 6];   // xyz light position each tile was rendered from, w far plane
+    vec4 uAtlasLights[MAX_SHADOWED_LIGHTS];           // xyz light position picking the face of a lookup
+};
+uniform sampler2DShadow uShadowAtlas;
 
 // Input from vertex shader
 in vec3 vNormal;
@@ -16,9 +55,13 @@ in vec3 vFragPosWorld;
 in vec2 vTexCoords;
 in mat3 TBN;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragWeights; // Only written in the weighted transparency pass
 
-uniform vec3 uColorMask;
+// 1.0 while accumulating weighted blended transparency
+uniform float uOITPass;
+
+flat in vec3 vColorMask; // Channels of the copy emitted by the geometry shader
 
 // Material properties
 uniform vec3 uKd;           
@@ -28,14 +71,6 @@ uniform float uShininess;
 // Transparency
 uniform float uAlpha;
 
-// Main light properties (in view space)
-uniform vec3 uLightPos_vs;    
-uniform vec3 uLightIntensity; 
-uniform float farPlane;
-
-// Camera position in world space
-uniform vec3 cameraPosWorld;
-
 // Texture samplers
 uniform sampler2D uTexture;
 uniform float uUseTexture;        
@@ -48,11 +83,27 @@ uniform float uUseNormalMap;
 uniform sampler2D uSpecularMap;
 uniform float uUseSpecularMap;
 
-// Shadow mapping
-uniform samplerCube depthMap;
+// Shadow filter, chosen by the application for the current shadow tier
+#define SHADOW_FILTER_SAMPLED 0     // Kernel of depth reads compared in the shader
+#define SHADOW_FILTER_PCF 1         // Hardware depth comparison over a fixed Poisson kernel
+#define SHADOW_FILTER_ADAPTIVE 2    // 4 comparison taps, the full kernel only in penumbrae
+#define SHADOW_FILTER_EXPONENTIAL 3 // Prefiltered exponential shadow map
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_SAMPLED
+#endif
+#ifndef SHADOW_FILTER_TAPS
+#define SHADOW_FILTER_TAPS 16
+#endif
+#ifndef ESM_EXPONENT
+#define ESM_EXPONENT 80.0
+#endif
 
-// Light position in world space
-uniform vec3 lightPosWorld;
+// Shadow mapping
+#if SHADOW_FILTER == SHADOW_FILTER_PCF || SHADOW_FILTER == SHADOW_FILTER_ADAPTIVE
+uniform samplerCubeShadow depthMap;
+#else
+uniform samplerCube depthMap; // Distance to the light over farPlane, exp(ESM_EXPONENT * distance) in the exponential mode
+#endif
 
 // Hardcoded map strengths
 const float NORMAL_MAP_STRENGTH = 0.8;
@@ -67,8 +118,57 @@ const vec3 gridSamplingDisk[20] = vec3[](
     vec3( 0,  1, -1), vec3( 0, -1, -1), vec3( 1,  1,  1), vec3(-1, -1, -1)
 );
 
+// Fixed Poisson kernel of the comparison modes, the first 4 taps are spread for the adaptive pre-test
+const vec3 poissonKernel[16] = vec3[](
+    vec3( 0.491,  0.491,  0.491), vec3( 0.491, -0.491, -0.491),
+    vec3(-0.491,  0.491, -0.491), vec3(-0.491, -0.491,  0.491),
+    vec3( 0.140,  0.321,  0.000), vec3(-0.341,  0.525,  0.313),
+    vec3( 0.032,  0.262, -0.364), vec3( 0.442,  0.333,  0.577),
+    vec3(-0.524,  0.137, -0.093), vec3( 0.757,  0.075, -0.481),
+    vec3(-0.168, -0.054,  0.626), vec3(-0.179, -0.100, -0.344),
+    vec3( 0.640, -0.313,  0.234), vec3(-0.375, -0.292,  0.155),
+    vec3( 0.238, -0.637, -0.509), vec3( 0.072, -0.550,  0.229)
+);
+
 // **Shadow Calculation**
+#if SHADOW_FILTER == SHADOW_FILTER_PCF || SHADOW_FILTER == SHADOW_FILTER_ADAPTIVE
+// Sum of the lit fraction of kernel taps [first, first + count), each tap is a hardware 2x2 comparison
+float LitTaps(vec3 fragToLight, float reference, float radius, int first, int count) {
+    float lit = 0.0;
+    for (int i = first; i < first + count; ++i) {
+        lit += texture(depthMap, vec4(fragToLight + poissonKernel[i] * radius, reference));
+    }
+    return lit;
+}
+#endif
+
 float ShadowCalculation(vec3 fragPosWorld) {
+#if SHADOW_FILTER != SHADOW_FILTER_SAMPLED
+    vec3 fragToLight = fragPosWorld - lightPosWorld;
+    float currentDepth = length(fragToLight);
+    float bias = 0.25;
+    float viewDistance = length(cameraPosWorld - fragPosWorld);
+    float diskRadius = (0.0 + (viewDistance / farPlane)) / 50.0;
+    float reference = (currentDepth - bias) / farPlane;
+#endif
+
+#if SHADOW_FILTER == SHADOW_FILTER_PCF
+    float lit = LitTaps(fragToLight, reference, diskRadius, 0, SHADOW_FILTER_TAPS);
+    return 1.0 - lit / float(SHADOW_FILTER_TAPS);
+#elif SHADOW_FILTER == SHADOW_FILTER_ADAPTIVE
+    // Taps that all agree mean the fragment is not in a penumbra
+    float lit = LitTaps(fragToLight, reference, diskRadius, 0, 4);
+    if (lit < 0.001 || lit > 3.999) {
+        return 1.0 - lit / 4.0;
+    }
+    lit += LitTaps(fragToLight, reference, diskRadius, 4, SHADOW_FILTER_TAPS - 4);
+    return 1.0 - lit / float(SHADOW_FILTER_TAPS);
+#elif SHADOW_FILTER == SHADOW_FILTER_EXPONENTIAL
+    // Mipmapped exp(c * occluder), visibility exp(c * (occluder - receiver)) saturates to 1 when lit
+    float occluder = texture(depthMap, fragToLight).r;
+    float visibility = clamp(occluder * exp(-ESM_EXPONENT * reference), 0.0, 1.0);
+    return 1.0 - visibility;
+#else
     vec3 fragToLight = fragPosWorld - lightPosWorld;
     float currentDepth = length(fragToLight);
     float shadow = 0.0;
@@ -87,6 +187,7 @@ float ShadowCalculation(vec3 fragPosWorld) {
     }
     shadow /= float(samples);
     return shadow;
+#endif
 }
 
 // **Normal Map Sampling with Strength**
@@ -106,6 +207,11 @@ float GetSpecularIntensity() {
     return 1.0 * SPECULAR_MAP_STRENGTH; // Default intensity with strength
 }
 
+// Main light color as seen by the current object
+vec3 MainLightIntensity() {
+    return uMainLightIntensity * uReceivesMainLight;
+}
+
 // **Main Light - Diffuse**
 vec3 MainLightDiffuse(vec3 albedo, vec3 N) {
     vec3 L = normalize(uLightPos_vs - vFragPos);
@@ -113,7 +219,7 @@ vec3 MainLightDiffuse(vec3 albedo, vec3 N) {
     float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.132 * distance * distance);
 
     float NdotL = max(dot(N, L), 0.0);
-    return albedo * uLightIntensity * NdotL * attenuation;
+    return albedo * MainLightIntensity() * NdotL * attenuation;
 }
 
 // **Main Light - Specular**
@@ -127,31 +233,115 @@ vec3 MainLightSpecular(vec3 N) {
 
     float NdotH = max(dot(N, H), 0.0);
     float specularIntensity = GetSpecularIntensity();
-    return uKs * specularIntensity * uLightIntensity * pow(NdotH, uShininess) * attenuation;
+    return uKs * specularIntensity * MainLightIntensity() * pow(NdotH, uShininess) * attenuation;
+}
+
+// Cluster of a view space position, -1 outside the froxel grid
+int ClusterIndex(vec3 viewPos) {
+    float depth = -viewPos.z;
+    if (depth <= 0.0) {
+        return -1;
+    }
+    vec2 ndc = viewPos.xy / depth * uClusterParams.xy;
+    int slice = int(floor(log(depth) * uClusterParams.z + uClusterParams.w));
+    if (abs(ndc.x) > 1.0 || abs(ndc.y) > 1.0 || slice < 0 || slice >= CLUSTER_SLICES) {
+        return -1;
+    }
+    ivec2 tile = min(ivec2((ndc * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+// Lights of the current object listed in the fragment's cluster, every object light outside the grid.
+// Both lists are ascending, so one merge walk intersects them.
+int GatherLights(out int lights[MAX_OBJECT_LIGHTS]) {
+    int cluster = ClusterIndex(vFragPos);
+    if (cluster < 0) {
+        for (int k = 0; k < uObjectLightCount; ++k) {
+            lights[k] = uObjectLights[k];
+        }
+        return uObjectLightCount;
+    }
+
+    uvec2 entry = texelFetch(uClusterGrid, cluster).xy;
+    int count = 0;
+    int k = 0;
+    for (int c = 0; c < int(entry.y) && k < uObjectLightCount; ++c) {
+        int light = int(texelFetch(uClusterLights, int(entry.x) + c).r);
+        while (k < uObjectLightCount && uObjectLights[k] < light) {
+            k++;
+        }
+        if (k < uObjectLightCount && uObjectLights[k] == light) {
+            lights[count++] = light;
+            k++;
+        }
+    }
+    return count;
+}
+
+// Fades an additional light out over the last quarter of its range
+float RangeWindow(int i, float distance) {
+    float range = uAdditionalLights[i].range.x;
+    return 1.0 - smoothstep(0.75 * range, range, distance);
+}
+
+// Shadow of an additional light from its atlas slot (color.w of the light), 0.0 without a slot
+float AtlasShadow(float atlasSlot) {
+    if (atlasSlot < 0.0) {
+        return 0.0;
+    }
+    int slot = int(atlasSlot);
+    vec3 toFrag = vFragPosWorld - uAtlasLights[slot].xyz;
+    vec3 axis = abs(toFrag);
+    int face = (axis.x >= axis.y && axis.x >= axis.z) ? (toFrag.x > 0.0 ? 0 : 1)
+             : (axis.y >= axis.z) ? (toFrag.y > 0.0 ? 2 : 3)
+             : (toFrag.z > 0.0 ? 4 : 5);
+    int tile = slot * 6 + face;
+
+    // Bias grows with the distance to the light, as the world size of a tile texel does
+    float lightDistance = length(vFragPosWorld - uAtlasFaceLights[tile].xyz);
+    float reference = (lightDistance - 0.05 - 0.02 * lightDistance) / uAtlasFaceLights[tile].w;
+    if (reference >= 1.0) {
+        return 0.0; // Out of the light's reach
+    }
+
+    // Tile coordinates, kept half a texel inside so the 2x2 comparison does not read the neighbouring tile
+    vec4 clip = uAtlasFaceMatrices[tile] * vec4(vFragPosWorld, 1.0);
+    float tileTexels = float(textureSize(uShadowAtlas, 0).x) / float(SHADOW_ATLAS_TILES_PER_ROW);
+    vec2 uv = clamp(clip.xy / clip.w * 0.5 + 0.5, 0.5 / tileTexels, 1.0 - 0.5 / tileTexels);
+    vec2 atlasUV = (vec2(tile % SHADOW_ATLAS_TILES_PER_ROW, tile / SHADOW_ATLAS_TILES_PER_ROW) + uv) / float(SHADOW_ATLAS_TILES_PER_ROW);
+    return 1.0 - texture(uShadowAtlas, vec3(atlasUV, reference));
 }
 
 // **Additional Lights**
 vec3 AdditionalLights(vec3 albedo, vec3 N) {
     vec3 totalLight = vec3(0.0);
 
-    for (int i = 0; i < uNumAdditionalLights; ++i) {
-        vec3 L = normalize(uAdditionalLightPos[i] - vFragPos);
+    int lights[MAX_OBJECT_LIGHTS];
+    int lightCount = GatherLights(lights);
+    for (int k = 0; k < lightCount; ++k) {
+        int i = lights[k];
+        float distance = length(uAdditionalLights[i].position.xyz - vFragPos);
+        float window = RangeWindow(i, distance);
+        if (window <= 0.0) {
+            continue;
+        }
+
+        vec3 L = normalize(uAdditionalLights[i].position.xyz - vFragPos);
         vec3 V = normalize(-vFragPos); 
         vec3 H = normalize(L + V);
 
-        float distance = length(uAdditionalLightPos[i] - vFragPos);
         // float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
-        float attenuation = 1.0 / (1.0 + 0.06 * distance + 0.052 * distance * distance);
+        float attenuation = window / (1.0 + 0.06 * distance + 0.052 * distance * distance);
 
         float NdotL = max(dot(N, L), 0.0);
         float NdotH = max(dot(N, H), 0.0);
 
         float specularIntensity = GetSpecularIntensity();
 
-        vec3 diffuse = albedo * uAdditionalLightColor[i] * NdotL * uAdditionalLightIntensity[i] * attenuation;
-        vec3 specular = uKs * specularIntensity * uAdditionalLightColor[i] * pow(NdotH, uShininess) * uAdditionalLightIntensity[i] * attenuation;
+        vec3 diffuse = albedo * uAdditionalLights[i].color.rgb * NdotL * uAdditionalLights[i].position.w * attenuation;
+        vec3 specular = uKs * specularIntensity * uAdditionalLights[i].color.rgb * pow(NdotH, uShininess) * uAdditionalLights[i].position.w * attenuation;
 
-        totalLight += diffuse + specular;
+        totalLight += (diffuse + specular) * (1.0 - AtlasShadow(uAdditionalLights[i].color.w));
     }
 
     return totalLight;
@@ -169,17 +359,20 @@ vec3 TransmissionLighting(vec3 albedo, vec3 N) {
     float distance = length(uLightPos_vs - vFragPos);
     float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * distance * distance);
     float NdotL = max(dot(N_back, L), 0.0); // Use reversed normal
-    vec3 mainDiffuse = albedo * uLightIntensity * NdotL * attenuation;
+    vec3 mainDiffuse = albedo * MainLightIntensity() * NdotL * attenuation;
     transmissionLight += mainDiffuse;
 
     // --- Additional Lights Transmission ---
-    for (int i = 0; i < uNumAdditionalLights; ++i) {
-        vec3 L_add = normalize(uAdditionalLightPos[i] - vFragPos);
-        float distance_add = length(uAdditionalLightPos[i] - vFragPos);
-        float attenuation_add = 1.0 / (1.0 + 0.09 * distance_add + 0.032 * distance_add * distance_add);
+    int lights[MAX_OBJECT_LIGHTS];
+    int lightCount = GatherLights(lights);
+    for (int k = 0; k < lightCount; ++k) {
+        int i = lights[k];
+        vec3 L_add = normalize(uAdditionalLights[i].position.xyz - vFragPos);
+        float distance_add = length(uAdditionalLights[i].position.xyz - vFragPos);
+        float attenuation_add = RangeWindow(i, distance_add) / (1.0 + 0.09 * distance_add + 0.032 * distance_add * distance_add);
         float NdotL_add = max(dot(N_back, L_add), 0.0); // Use reversed normal
 
-        vec3 additionalDiffuse = albedo * uAdditionalLightColor[i] * NdotL_add * uAdditionalLightIntensity[i] * attenuation_add;
+        vec3 additionalDiffuse = albedo * uAdditionalLights[i].color.rgb * NdotL_add * uAdditionalLights[i].position.w * attenuation_add;
 
         transmissionLight += additionalDiffuse;
     }
@@ -221,6 +414,16 @@ vec3 filterTV(vec3 color) {
     }
 }
 
+// Weighted blended transparency: the premultiplied color scaled by a weight favouring near and opaque fragments,
+// and the coverage, go to the accumulation target; the weight of each channel goes to the weight target.
+// A copy drawn for some of the channels only takes its share of the coverage, so the copies add up to alpha.
+void WriteWeightedColor(vec3 color, float alpha, vec3 channels) {
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    float coverage = 1.0 - pow(max(1.0 - alpha, 0.0), dot(channels, vec3(1.0)) / 3.0);
+    FragColor = vec4(color * alpha * weight, coverage);
+    FragWeights = vec4(channels * alpha * weight, 0.0);
+}
+
 vec3 tempo;
 
 void main() {
@@ -325,21 +528,27 @@ void main() {
 
         // only output the color channel of the color mask
         // if all channels are zero or 1, output the original color
-        // uColorMask
-        if (uColorMask.r == 0.0 && uColorMask.g == 0.0 && uColorMask.b == 0.0) {
+        // vColorMask
+        if (vColorMask.r == 0.0 && vColorMask.g == 0.0 && vColorMask.b == 0.0) {
             // FragColor = vec4(colorToDither, finalAlpha);
             tempo = filterTV(colorToDither);
             FragColor = vec4(tempo, finalAlpha);
         } else {
             vec3 maskedColor = vec3(0.0);
-            maskedColor.r = colorToDither.r * uColorMask.r;
-            maskedColor.g = colorToDither.g * uColorMask.g;
-            maskedColor.b = colorToDither.b * uColorMask.b;
+            maskedColor.r = colorToDither.r * vColorMask.r;
+            maskedColor.g = colorToDither.g * vColorMask.g;
+            maskedColor.b = colorToDither.b * vColorMask.b;
             tempo = filterTV(maskedColor);
             FragColor = vec4(tempo, finalAlpha);
         }
 
         // debug
-        // FragColor = vec4(uColorMask, finalAlpha);
+        // FragColor = vec4(vColorMask, finalAlpha);
+    }
+
+    // The channel passes each accumulate their own channels
+    if (uOITPass > 0.5) {
+        vec3 channels = (vColorMask == vec3(0.0)) ? vec3(1.0) : vColorMask;
+        WriteWeightedColor(FragColor.rgb, finalAlpha, channels);
     }
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#version 330 core
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 9) out;
+
+// Vertex data of room2.vs.glsl, the gravitational pull is computed once and left unscaled
+in VertexData {
+    vec4 clipPosition;   // Undisplaced position in clip space
+    vec4 clipPull;       // Unscaled pull in clip space
+    vec4 clipToCenter;   // Offset to the triangle center in clip space
+    vec3 objectPull;     // Unscaled pull in object space
+    vec3 objectToCenter; // Offset to the triangle center in object space
+    float shrinkFactor;
+    vec3 viewPosition;
+    vec3 viewPull;       // Unscaled pull in view space
+    vec3 normal;
+    vec2 texCoords;
+    vec3 fragPosWorld;
+    mat3 TBN;            // Tangent-Bitangent-Normal matrix
+} gs_in[];
+
+// Color Mask
+uniform vec3 uColorMask;      // Color mask for distortion scaling, when drawing a single copy
+uniform float uChromaticPass; // 1.0 to emit one copy per color channel, each with its own distortion
+
+// Channel of each chromatic copy, in emission order
+const vec3 CHANNEL_MASKS[3] = vec3[3](vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+
+const float RED_SCALE = 1.5;    // More distortion
+const float GREEN_SCALE = 1.0;  // Normal distortion
+const float BLUE_SCALE = 0.5;   // Less distortion
+
+const float EPSILON = 0.01;
+
+// Limit of the displacement towards the triangle center
+const float MAX_SHRINK_DISPLACEMENT = 0.5;
+
+// Outputs to Fragment Shader
+out vec3 vNormal;
+out vec3 vFragPos;
+out vec2 vTexCoords;
+out vec3 vFragPosWorld;
+out mat3 TBN;
+flat out vec3 vColorMask; // Channels of the copy being shaded
+
+// Distortion scale of a color mask
+float distortionScale(vec3 mask) {
+    // Check if all channels are fully active (1.0) or fully inactive (0.0)
+    bool allActive = (abs(mask.r - 1.0) < EPSILON) &&
+                    (abs(mask.g - 1.0) < EPSILON) &&
+                    (abs(mask.b - 1.0) < EPSILON);
+
+    bool allInactive = (abs(mask.r) < EPSILON) &&
+                    (abs(mask.g) < EPSILON) &&
+                    (abs(mask.b) < EPSILON);
+
+    if (allActive || allInactive) {
+        return 1.0; // No extra scaling
+    }
+
+    // Apply cumulative scaling based on active channels
+    return (mask.r * RED_SCALE) + (mask.g * GREEN_SCALE) + (mask.b * BLUE_SCALE);
+}
+
+void main() {
+    int copies = (uChromaticPass > 0.5) ? 3 : 1;
+    for (int copy = 0; copy < copies; ++copy) {
+        vec3 mask = (uChromaticPass > 0.5) ? CHANNEL_MASKS[copy] : uColorMask;
+        float scale = distortionScale(mask);
+
+        for (int i = 0; i < 3; ++i) {
+            // Displaced position pulled towards the triangle center by the shrink factor, the offset clamped in object space
+            vec3 toCenter = gs_in[i].objectToCenter - gs_in[i].objectPull * scale;
+            float toCenterLength = length(toCenter);
+            float clampRatio = toCenterLength > 0.0 ? min(toCenterLength, MAX_SHRINK_DISPLACEMENT) / toCenterLength : 0.0;
+            vec4 clipToCenter = gs_in[i].clipToCenter - gs_in[i].clipPull * scale;
+            gl_Position = gs_in[i].clipPosition + gs_in[i].clipPull * scale + clipToCenter * (clampRatio * (1.0 - gs_in[i].shrinkFactor));
+
+            vNormal = gs_in[i].normal;
+            vFragPos = gs_in[i].viewPosition + gs_in[i].viewPull * scale;
+            vTexCoords = gs_in[i].texCoords;
+            vFragPosWorld = gs_in[i].fragPosWorld;
+            TBN = gs_in[i].TBN;
+            vColorMask = mask;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
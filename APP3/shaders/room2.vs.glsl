@@ -6,45 +6,73 @@ layout(location = 1) in vec3 aNormal;       // Vertex normal
 layout(location = 2) in vec2 aTexCoords;    // Texture coordinates
 layout(location = 3) in vec3 aTangent;      // Tangent vector
 layout(location = 4) in vec3 aBitangent;    // Bitangent vector
+layout(location = 5) in mat4 aInstanceMatrix; // Per-instance model matrix (instanced groups)
 
 // Uniform Matrices
 uniform mat4 uMVPMatrix;      // Model-View-Projection matrix
 uniform mat4 uMVMatrix;       // Model-View matrix
 uniform mat3 uNormalMatrix;   // Normal matrix
+uniform float uUseInstancing; // 1.0 when drawing an instanced group
 
-// Light Properties
-uniform vec3 uLightPos_vs;    // Main light position in view space
-uniform vec3 uLightIntensity; // Main light color
-
+// Maximum number of additional point lights
 #define MAX_ADDITIONAL_LIGHTS 100
-uniform int uNumAdditionalLights;          
-uniform vec3 uAdditionalLightPos[MAX_ADDITIONAL_LIGHTS]; // Additional lights in view space
-uniform float uAdditionalLightIntensity[MAX_ADDITIONAL_LIGHTS];
+
+// Per-frame data, uploaded once per frame (std140, binding 0)
+layout(std140) uniform FrameData {
+    vec3 uLightPos_vs;        // Main light position in view space
+    float farPlane;
+    vec3 uMainLightIntensity; // Main light color
+    float uTime;
+    vec3 lightPosWorld;       // Main light position in world space
+    int uNumAdditionalLights;
+    vec3 cameraPosWorld;      // Camera position in world space
+};
+
+// Additional point lights (std140, binding 1)
+struct AdditionalLight {
+    vec4 position; // xyz position in view space, w intensity
+    vec4 color;
+    vec4 range;
+};
+layout(std140) uniform LightData {
+    AdditionalLight uAdditionalLights[MAX_ADDITIONAL_LIGHTS];
+};
+
+// Lights reaching the current object, ascending indices into uAdditionalLights
+#define MAX_OBJECT_LIGHTS 32
+uniform int uObjectLightCount;
+uniform int uObjectLights[MAX_OBJECT_LIGHTS];
+uniform float uReceivesMainLight; // 0.0 when the main light is in the other room
+
+// Froxel light lists (texture buffers, rebuilt every frame): (offset, count) per cluster, then the light indices.
+// A light is listed in every cluster within GRAVITY_RANGE of it.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+uniform usamplerBuffer uClusterGrid;
+uniform usamplerBuffer uClusterLights;
+uniform vec4 uClusterParams; // xy projection scales, slice = log(depth) * z + w
 
 // Constants for Gravitational Pull
 const float GRAVITY_STRENGTH = 0.8;   // Controls intensity of gravitational pull
 const float GRAVITY_RANGE = 3.5;     // Maximum range of gravitational effect
 const float GRAVITY_FALLOFF = 0.9;    // Prevents division by zero
 
-// uTime
-uniform float uTime;
-
-// Color Mask
-uniform vec3 uColorMask; // Color mask for distortion scaling
-
-const float RED_SCALE = 1.5;    // More distortion
-const float GREEN_SCALE = 1.0;  // Normal distortion
-const float BLUE_SCALE = 0.5;   // Less distortion
-
-const float EPSILON = 0.01;
-
-// Outputs to Fragment Shader
-out vec3 vNormal;
-out vec3 vFragPos;
-out vec2 vTexCoords;
-out vec3 vFragPosWorld;
-out mat3 TBN; // Tangent-Bitangent-Normal matrix
-// out vec3 vTotalDisplacement; // Removed as it's no longer needed
+// Outputs to the Geometry Shader, which scales the pull per color channel and finishes the transform
+out VertexData {
+    vec4 clipPosition;   // Undisplaced position in clip space
+    vec4 clipPull;       // Unscaled pull in clip space
+    vec4 clipToCenter;   // Offset to the triangle center in clip space
+    vec3 objectPull;     // Unscaled pull in object space
+    vec3 objectToCenter; // Offset to the triangle center in object space
+    float shrinkFactor;
+    vec3 viewPosition;
+    vec3 viewPull;       // Unscaled pull in view space
+    vec3 normal;
+    vec2 texCoords;
+    vec3 fragPosWorld;
+    mat3 TBN;            // Tangent-Bitangent-Normal matrix
+} vs_out;
 
 // Pseudo-Random Function for Per-Triangle Variance
 float rand(vec2 co) {
@@ -78,14 +106,39 @@ float calculateShrinkFactor(vec3 vertexPos, vec3 lightPos, float intensity) {
     return 1.0; // No shrink beyond range
 }
 
+// Cluster of a view space position, -1 outside the froxel grid
+int ClusterIndex(vec3 viewPos) {
+    float depth = -viewPos.z;
+    if (depth <= 0.0) {
+        return -1;
+    }
+    vec2 ndc = viewPos.xy / depth * uClusterParams.xy;
+    int slice = int(floor(log(depth) * uClusterParams.z + uClusterParams.w));
+    if (abs(ndc.x) > 1.0 || abs(ndc.y) > 1.0 || slice < 0 || slice >= CLUSTER_SLICES) {
+        return -1;
+    }
+    ivec2 tile = min(ivec2((ndc * 0.5 + 0.5) * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+// k-th light of a cluster list, or the k-th light when the vertex is outside the grid
+int ClusterLight(int cluster, uvec2 entry, int k) {
+    return cluster >= 0 ? int(texelFetch(uClusterLights, int(entry.x) + k).r) : k;
+}
+
 // Triangle Center Approximation
 vec3 calculateTriangleCenter(vec3 v0, vec3 v1, vec3 v2) {
     return (v0 + v1 + v2) / 3.0;
 }
 
 void main() {
+    // Instance matrices are relative to the object model matrix
+    mat4 instanceMatrix = (uUseInstancing > 0.5) ? aInstanceMatrix : mat4(1.0);
+    mat4 modelView = uMVMatrix * instanceMatrix;
+    mat3 normalMatrix = uNormalMatrix * mat3(instanceMatrix);
+
     // Calculate view-space position of the vertex
-    vec3 viewPosition = (uMVMatrix * vec4(aPosition, 1.0)).xyz;
+    vec3 viewPosition = (modelView * vec4(aPosition, 1.0)).xyz;
     vec3 totalDisplacement = vec3(0.0);
 
     // Randomness Per Triangle (using TexCoords)
@@ -94,69 +147,60 @@ void main() {
     // Pull towards main light (View Space)
     totalDisplacement += calculateGravitationalPull(viewPosition, uLightPos_vs, GRAVITY_STRENGTH, triangleRandom);
 
-    // Pull towards additional lights (View Space)
-    for (int i = 0; i < uNumAdditionalLights; ++i) {
-        totalDisplacement += calculateGravitationalPull(viewPosition, uAdditionalLightPos[i], GRAVITY_STRENGTH, triangleRandom);
-    }
+    // Lights within GRAVITY_RANGE are all listed in the vertex's cluster, the others neither pull nor shrink.
+    // Vertices off screen have no cluster and walk every light.
+    int cluster = ClusterIndex(viewPosition);
+    uvec2 clusterEntry = cluster >= 0 ? texelFetch(uClusterGrid, cluster).xy : uvec2(0u);
+    int nearbyLights = cluster >= 0 ? int(clusterEntry.y) : uNumAdditionalLights;
 
-    // **Apply Color Mask-Based Distortion Scaling**
-    // Check if all channels are fully active (1.0) or fully inactive (0.0)
-    bool allActive = (abs(uColorMask.r - 1.0) < EPSILON) && 
-                    (abs(uColorMask.g - 1.0) < EPSILON) && 
-                    (abs(uColorMask.b - 1.0) < EPSILON);
-
-    bool allInactive = (abs(uColorMask.r) < EPSILON) && 
-                    (abs(uColorMask.g) < EPSILON) && 
-                    (abs(uColorMask.b) < EPSILON);
-
-    float distortionScale = 1.0;
-
-    if (allActive) {
-        distortionScale = 1.0; // No extra scaling
-    } else if (allInactive) {
-        distortionScale = 1.0;
-    } else {
-        // Apply cumulative scaling based on active channels
-        distortionScale = (uColorMask.r * RED_SCALE) + 
-                        (uColorMask.g * GREEN_SCALE) + 
-                        (uColorMask.b * BLUE_SCALE);
+    // Pull towards additional lights (View Space)
+    for (int k = 0; k < nearbyLights; ++k) {
+        int i = ClusterLight(cluster, clusterEntry, k);
+        totalDisplacement += calculateGravitationalPull(viewPosition, uAdditionalLights[i].position.xyz, GRAVITY_STRENGTH, triangleRandom);
     }
 
-    // Apply the distortion scale to the total displacement
-    vec3 totalDisplacementScaled = totalDisplacement * distortionScale;
-
-    // Apply gravitational pull displacement
-    vec3 displacedPosition = aPosition + (inverse(uMVMatrix) * vec4(totalDisplacementScaled, 0.0)).xyz;
+    // The pull is scaled per color channel in the geometry shader, every channel copy shares this vertex
+    vec3 objectPull = (inverse(modelView) * vec4(totalDisplacement, 0.0)).xyz;
 
     // Calculate triangle center (approximate using neighboring vertices)
     vec3 triangleCenter = calculateTriangleCenter(aPosition, aTangent, aBitangent);
 
     // Apply shrink factor based on gravitational pull
-    float shrinkFactor = calculateShrinkFactor(viewPosition, uLightPos_vs, uLightIntensity.x);
-    for (int i = 0; i < uNumAdditionalLights; ++i) {
-        shrinkFactor *= calculateShrinkFactor(viewPosition, uAdditionalLightPos[i], uAdditionalLightIntensity[i]);
+    // Every light shrinks, only the ones reaching this object add their intensity
+    float shrinkFactor = calculateShrinkFactor(viewPosition, uLightPos_vs, uMainLightIntensity.x * uReceivesMainLight);
+    int nextObjectLight = 0;
+    for (int k = 0; k < nearbyLights; ++k) {
+        int i = ClusterLight(cluster, clusterEntry, k);
+        float intensity = 0.0;
+        while (nextObjectLight < uObjectLightCount && uObjectLights[nextObjectLight] < i) {
+            nextObjectLight++;
+        }
+        if (nextObjectLight < uObjectLightCount && uObjectLights[nextObjectLight] == i) {
+            intensity = uAdditionalLights[i].position.w;
+            nextObjectLight++;
+        }
+        shrinkFactor *= calculateShrinkFactor(viewPosition, uAdditionalLights[i].position.xyz, intensity);
     }
 
-    // Limit the maximum displacement towards the triangle center
-    vec3 toCenter = triangleCenter - displacedPosition;
-    float maxDisplacement = 0.5;
-    vec3 clampedToCenter = normalize(toCenter) * min(length(toCenter), maxDisplacement);
-
-    // Interpolate vertex towards triangle center for shrink effect
-    vec3 shrunkPosition = displacedPosition + clampedToCenter * (1.0 - shrinkFactor);
-
-    // Final transformation
-    gl_Position = uMVPMatrix * vec4(shrunkPosition, 1.0);
+    // Positions in clip space are affine in the object space ones, the geometry shader combines them per channel
+    mat4 clipMatrix = uMVPMatrix * instanceMatrix;
+    vs_out.clipPosition = clipMatrix * vec4(aPosition, 1.0);
+    vs_out.clipPull = clipMatrix * vec4(objectPull, 0.0);
+    vs_out.objectToCenter = triangleCenter - aPosition;
+    vs_out.clipToCenter = clipMatrix * vec4(vs_out.objectToCenter, 0.0);
+    vs_out.objectPull = objectPull;
+    vs_out.shrinkFactor = shrinkFactor;
+    vs_out.viewPosition = viewPosition;
+    vs_out.viewPull = totalDisplacement;
 
     // Pass data to Fragment Shader
-    vNormal = uNormalMatrix * aNormal;
-    vFragPos = viewPosition + totalDisplacementScaled;
-    vTexCoords = aTexCoords;
-    vFragPosWorld = (inverse(uMVMatrix) * vec4(viewPosition, 1.0)).xyz;
+    vs_out.normal = normalMatrix * aNormal;
+    vs_out.texCoords = aTexCoords;
+    vs_out.fragPosWorld = (inverse(modelView) * vec4(viewPosition, 1.0)).xyz;
 
     // Construct TBN Matrix
-    vec3 T = normalize(uNormalMatrix * aTangent);
-    vec3 B = normalize(uNormalMatrix * aBitangent);
-    vec3 N = normalize(uNormalMatrix * aNormal);
-    TBN = mat3(T, B, N);
-}
\ No newline at end of file
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 B = normalize(normalMatrix * aBitangent);
+    vec3 N = normalize(normalMatrix * aNormal);
+    vs_out.TBN = mat3(T, B, N);
+}
@@ -0,0 +1,311 @@
+// animation.cpp
+#include "animation.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ANIMATION_USE_SSE 1
+#endif
+
+namespace utils_animation
+{
+
+    // Range reduction and minimax polynomials of the Cephes sinf/cosf: the argument is reduced to [-pi/4, pi/4]
+    // around the nearest multiple of pi/2 (pi/4 split in three parts so the reduction stays exact), then both
+    // polynomials are evaluated and the quadrant picks and signs them. Accurate to a few float ulps for |x| < 8192.
+    static const float FOUR_OVER_PI = 1.27323954473516f;
+    static const float PI_OVER_4_A = 0.78515625f;
+    static const float PI_OVER_4_B = 2.4187564849853515625e-4f;
+    static const float PI_OVER_4_C = 3.77489497744594108e-8f;
+    static const float SIN_C0 = -1.9515295891e-4f;
+    static const float SIN_C1 = 8.3321608736e-3f;
+    static const float SIN_C2 = -1.6666654611e-1f;
+    static const float COS_C0 = 2.443315711809948e-5f;
+    static const float COS_C1 = -1.388731625493765e-3f;
+    static const float COS_C2 = 4.166664568298827e-2f;
+
+    // Scalar version of the kernel, used for the entries left after the last group of four
+    static inline void sinCosScalar(float x, float &sine, float &cosine)
+    {
+        float ax = std::fabs(x);
+        int j = static_cast<int>(ax * FOUR_OVER_PI);
+        j = (j + 1) & ~1;
+        float y = static_cast<float>(j);
+        float r = ((ax - y * PI_OVER_4_A) - y * PI_OVER_4_B) - y * PI_OVER_4_C;
+        float z = r * r;
+        float polyCos = ((COS_C0 * z + COS_C1) * z + COS_C2) * z * z - 0.5f * z + 1.0f;
+        float polySin = ((SIN_C0 * z + SIN_C1) * z + SIN_C2) * z * r + r;
+
+        // Odd quadrants swap the polynomials, sine is negative in quadrants 2 and 3, cosine in 1 and 2
+        bool swap = (j & 2) != 0;
+        sine = swap ? polyCos : polySin;
+        cosine = swap ? polySin : polyCos;
+        if (((j & 4) != 0) != (x < 0.0f))
+        {
+            sine = -sine;
+        }
+        if ((j + 2) & 4)
+        {
+            cosine = -cosine;
+        }
+    }
+
+#ifdef ANIMATION_USE_SSE
+    // Same steps as sinCosScalar on four lanes, quadrant tests become masks and sign flips xor the sign bit
+    static inline void sinCos4(__m128 x, __m128 &sine, __m128 &cosine)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128i two = _mm_set1_epi32(2);
+        const __m128i four = _mm_set1_epi32(4);
+
+        __m128 ax = _mm_andnot_ps(signMask, x);
+        __m128 xSign = _mm_and_ps(x, signMask);
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(ax, _mm_set1_ps(FOUR_OVER_PI)));
+        j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(j);
+
+        __m128 r = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(PI_OVER_4_A)));
+        r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(PI_OVER_4_B)));
+        r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(PI_OVER_4_C)));
+        __m128 z = _mm_mul_ps(r, r);
+
+        __m128 polyCos = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C0), z), _mm_set1_ps(COS_C1));
+        polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(COS_C2));
+        polyCos = _mm_mul_ps(_mm_mul_ps(polyCos, z), z);
+        polyCos = _mm_add_ps(_mm_sub_ps(polyCos, _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+
+        __m128 polySin = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C0), z), _mm_set1_ps(SIN_C1));
+        polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(SIN_C2));
+        polySin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polySin, z), r), r);
+
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), two));
+        __m128 sineValue = _mm_or_ps(_mm_and_ps(swap, polyCos), _mm_andnot_ps(swap, polySin));
+        __m128 cosineValue = _mm_or_ps(_mm_and_ps(swap, polySin), _mm_andnot_ps(swap, polyCos));
+
+        // Bit 2 of the quadrant index shifted into the sign bit
+        __m128 sineSign = _mm_xor_ps(xSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29)));
+        __m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, two), four), 29));
+        sine = _mm_xor_ps(sineValue, sineSign);
+        cosine = _mm_xor_ps(cosineValue, cosineSign);
+    }
+#endif
+
+    size_t OrbitBatch::add(float bodyPhase, float bodySpeed, float bodyRadius, float bodyHeight)
+    {
+        phase.push_back(bodyPhase);
+        speed.push_back(bodySpeed);
+        radius.push_back(bodyRadius);
+        height.push_back(bodyHeight);
+        x.push_back(0.0f);
+        y.push_back(bodyHeight);
+        z.push_back(0.0f);
+        return phase.size() - 1;
+    }
+
+    void OrbitBatch::clear()
+    {
+        phase.clear();
+        speed.clear();
+        radius.clear();
+        height.clear();
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+
+    LightCycleBatch::LightCycleBatch()
+        : baseColor(1.0f), channelPhase(0.0f), minIntensity(0.0f), maxIntensity(1.0f) {}
+
+    size_t LightCycleBatch::add(float lightPhase, float lightSpeed, float lightHeight, float lightColorPhase, float lightColorSpeed)
+    {
+        phase.push_back(lightPhase);
+        speed.push_back(lightSpeed);
+        height.push_back(lightHeight);
+        colorPhase.push_back(lightColorPhase);
+        colorSpeed.push_back(lightColorSpeed);
+        offsetY.push_back(0.0f);
+        r.push_back(0.0f);
+        g.push_back(0.0f);
+        b.push_back(0.0f);
+        intensity.push_back(0.0f);
+        return phase.size() - 1;
+    }
+
+    void LightCycleBatch::clear()
+    {
+        phase.clear();
+        speed.clear();
+        height.clear();
+        colorPhase.clear();
+        colorSpeed.clear();
+        offsetY.clear();
+        r.clear();
+        g.clear();
+        b.clear();
+        intensity.clear();
+    }
+
+    void animateOrbits(OrbitBatch &batch, float time)
+    {
+        size_t count = batch.size();
+        size_t i = 0;
+#ifdef ANIMATION_USE_SSE
+        const __m128 t = _mm_set1_ps(time);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 angle = _mm_add_ps(_mm_mul_ps(t, _mm_loadu_ps(&batch.speed[i])), _mm_loadu_ps(&batch.phase[i]));
+            __m128 sine, cosine;
+            sinCos4(angle, sine, cosine);
+            __m128 radius = _mm_loadu_ps(&batch.radius[i]);
+            _mm_storeu_ps(&batch.x[i], _mm_mul_ps(radius, cosine));
+            _mm_storeu_ps(&batch.y[i], _mm_loadu_ps(&batch.height[i]));
+            _mm_storeu_ps(&batch.z[i], _mm_mul_ps(radius, sine));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float sine, cosine;
+            sinCosScalar(time * batch.speed[i] + batch.phase[i], sine, cosine);
+            batch.x[i] = batch.radius[i] * cosine;
+            batch.y[i] = batch.height[i];
+            batch.z[i] = batch.radius[i] * sine;
+        }
+    }
+
+    void animateLightCycles(LightCycleBatch &batch, float time)
+    {
+        // The shifted channels come from the sine and cosine of the color angle: sin(a + p) = sin a cos p + cos a sin p
+        glm::vec3 shiftCos = glm::cos(batch.channelPhase);
+        glm::vec3 shiftSin = glm::sin(batch.channelPhase);
+
+        size_t count = batch.size();
+        size_t i = 0;
+#ifdef ANIMATION_USE_SSE
+        const __m128 t = _mm_set1_ps(time);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 minIntensity = _mm_set1_ps(batch.minIntensity);
+        const __m128 maxIntensity = _mm_set1_ps(batch.maxIntensity);
+        const __m128 shiftCos4[3] = {_mm_set1_ps(shiftCos.x), _mm_set1_ps(shiftCos.y), _mm_set1_ps(shiftCos.z)};
+        const __m128 shiftSin4[3] = {_mm_set1_ps(shiftSin.x), _mm_set1_ps(shiftSin.y), _mm_set1_ps(shiftSin.z)};
+        const __m128 base4[3] = {_mm_set1_ps(batch.baseColor.r), _mm_set1_ps(batch.baseColor.g), _mm_set1_ps(batch.baseColor.b)};
+        float *channels[3] = {batch.r.data(), batch.g.data(), batch.b.data()};
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 sine, cosine;
+            sinCos4(_mm_add_ps(_mm_mul_ps(t, _mm_loadu_ps(&batch.speed[i])), _mm_loadu_ps(&batch.phase[i])), sine, cosine);
+            _mm_storeu_ps(&batch.offsetY[i], _mm_mul_ps(sine, _mm_loadu_ps(&batch.height[i])));
+
+            sinCos4(_mm_add_ps(_mm_mul_ps(t, _mm_loadu_ps(&batch.colorSpeed[i])), _mm_loadu_ps(&batch.colorPhase[i])), sine, cosine);
+            for (int c = 0; c < 3; ++c)
+            {
+                __m128 shifted = _mm_add_ps(_mm_mul_ps(sine, shiftCos4[c]), _mm_mul_ps(cosine, shiftSin4[c]));
+                __m128 factor = _mm_mul_ps(_mm_add_ps(shifted, _mm_set1_ps(1.0f)), half);
+                _mm_storeu_ps(channels[c] + i, _mm_mul_ps(base4[c], factor));
+            }
+            __m128 factor = _mm_mul_ps(_mm_add_ps(sine, _mm_set1_ps(1.0f)), half);
+            _mm_storeu_ps(&batch.intensity[i], _mm_min_ps(_mm_max_ps(factor, minIntensity), maxIntensity));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float sine, cosine;
+            sinCosScalar(time * batch.speed[i] + batch.phase[i], sine, cosine);
+            batch.offsetY[i] = sine * batch.height[i];
+
+            sinCosScalar(time * batch.colorSpeed[i] + batch.colorPhase[i], sine, cosine);
+            glm::vec3 factor = (sine * shiftCos + cosine * shiftSin + 1.0f) * 0.5f;
+            batch.r[i] = batch.baseColor.r * factor.r;
+            batch.g[i] = batch.baseColor.g * factor.g;
+            batch.b[i] = batch.baseColor.b * factor.b;
+            batch.intensity[i] = glm::clamp((sine + 1.0f) * 0.5f, batch.minIntensity, batch.maxIntensity);
+        }
+    }
+
+    // Function to return the time per call of an update over a number of runs, in microseconds
+    template <typename Update>
+    static double timeUpdate(Update update, int runs)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int run = 0; run < runs; ++run)
+        {
+            update(run * 0.016f);
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+        return elapsed.count() / runs;
+    }
+
+    void runAnimationBenchmark(size_t count)
+    {
+        const int RUNS = 500;
+
+        // Spread parameters, angles reach a few hundred radians like after minutes of running
+        OrbitBatch orbits;
+        LightCycleBatch cycles;
+        cycles.baseColor = glm::vec3(1.0f, 0.8f, 0.6f);
+        cycles.channelPhase = glm::vec3(0.0f, 2.0f, 4.0f);
+        cycles.minIntensity = 0.2f;
+        cycles.maxIntensity = 0.8f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            float f = static_cast<float>(i);
+            float phase = std::fmod(f * 2.5f, 300.0f);
+            orbits.add(phase, 0.05f + std::fmod(f * 0.013f, 1.0f), 2.0f + std::fmod(f * 0.7f, 8.0f), -5.0f - std::fmod(f, 25.0f));
+            cycles.add(phase, 0.5f, 0.004f, phase, 1.0f);
+        }
+
+        // The same updates written with the standard library, into their own columns
+        std::vector<float> refX(count), refZ(count), refOffsetY(count), refR(count), refG(count), refB(count), refIntensity(count);
+        auto referenceOrbits = [&](float time)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                float angle = time * orbits.speed[i] + orbits.phase[i];
+                refX[i] = orbits.radius[i] * std::cos(angle);
+                refZ[i] = orbits.radius[i] * std::sin(angle);
+            }
+        };
+        auto referenceCycles = [&](float time)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                refOffsetY[i] = std::sin(time * cycles.speed[i] + cycles.phase[i]) * cycles.height[i];
+                float angle = time * cycles.colorSpeed[i] + cycles.colorPhase[i];
+                refR[i] = cycles.baseColor.r * (std::sin(angle + cycles.channelPhase.x) + 1.0f) * 0.5f;
+                refG[i] = cycles.baseColor.g * (std::sin(angle + cycles.channelPhase.y) + 1.0f) * 0.5f;
+                refB[i] = cycles.baseColor.b * (std::sin(angle + cycles.channelPhase.z) + 1.0f) * 0.5f;
+                refIntensity[i] = glm::clamp((std::sin(angle) + 1.0f) * 0.5f, cycles.minIntensity, cycles.maxIntensity);
+            }
+        };
+
+        double orbitTime = timeUpdate([&](float time) { animateOrbits(orbits, time); }, RUNS);
+        double orbitReferenceTime = timeUpdate(referenceOrbits, RUNS);
+        double cycleTime = timeUpdate([&](float time) { animateLightCycles(cycles, time); }, RUNS);
+        double cycleReferenceTime = timeUpdate(referenceCycles, RUNS);
+
+        // Both sides of the last run, compared entry by entry
+        float maxError = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            maxError = std::max(maxError, std::fabs(orbits.x[i] - refX[i]));
+            maxError = std::max(maxError, std::fabs(orbits.z[i] - refZ[i]));
+            maxError = std::max(maxError, std::fabs(cycles.offsetY[i] - refOffsetY[i]));
+            maxError = std::max(maxError, std::fabs(cycles.r[i] - refR[i]));
+            maxError = std::max(maxError, std::fabs(cycles.g[i] - refG[i]));
+            maxError = std::max(maxError, std::fabs(cycles.b[i] - refB[i]));
+            maxError = std::max(maxError, std::fabs(cycles.intensity[i] - refIntensity[i]));
+        }
+
+#ifdef ANIMATION_USE_SSE
+        const char *path = "SSE2";
+#else
+        const char *path = "scalar";
+#endif
+        std::cout << "Animation benchmark, " << count << " entities, " << path << " kernels:" << std::endl;
+        std::cout << "  Orbits: " << orbitTime << " us per update (std::sin/std::cos: " << orbitReferenceTime << " us)" << std::endl;
+        std::cout << "  Light cycles: " << cycleTime << " us per update (std::sin: " << cycleReferenceTime << " us)" << std::endl;
+        std::cout << "  Largest difference to the standard library: " << maxError << std::endl;
+    }
+
+} // namespace utils_animation
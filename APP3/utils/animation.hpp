@@ -0,0 +1,75 @@
+// animation.hpp
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace utils_animation
+{
+
+    // Bodies orbiting a center on a horizontal circle, stored column-wise so the kernel streams over each parameter.
+    // The angle of a body at time t is t * speed + phase.
+    struct OrbitBatch
+    {
+        // Parameters
+        std::vector<float> phase;
+        std::vector<float> speed;
+        std::vector<float> radius;
+        std::vector<float> height;
+
+        // Offsets from the orbit center, written by animateOrbits
+        std::vector<float> x, y, z;
+
+        // Function to append a body, returns its index in the batch
+        size_t add(float phase, float speed, float radius, float height);
+
+        size_t size() const { return phase.size(); }
+        void clear();
+    };
+
+    // Lights bobbing up and down while cycling their color and intensity, stored column-wise.
+    // The bobbing angle is t * speed + phase, the color angle t * colorSpeed + colorPhase; each color channel
+    // follows the sine of the color angle shifted by channelPhase, the intensity the unshifted one.
+    struct LightCycleBatch
+    {
+        // Parameters shared by the batch
+        glm::vec3 baseColor;
+        glm::vec3 channelPhase;
+        float minIntensity, maxIntensity;
+
+        // Per-light parameters
+        std::vector<float> phase;
+        std::vector<float> speed;
+        std::vector<float> height; // Bobbing amplitude
+        std::vector<float> colorPhase;
+        std::vector<float> colorSpeed;
+
+        // Results, written by animateLightCycles
+        std::vector<float> offsetY; // Vertical displacement of this update
+        std::vector<float> r, g, b;
+        std::vector<float> intensity;
+
+        LightCycleBatch();
+
+        // Function to append a light, returns its index in the batch
+        size_t add(float phase, float speed, float height, float colorPhase, float colorSpeed);
+
+        size_t size() const { return phase.size(); }
+        void clear();
+    };
+
+    // Function to compute the offsets of every body of a batch at a time, four bodies per SSE step
+    void animateOrbits(OrbitBatch &batch, float time);
+
+    // Function to compute the displacement, color and intensity of every light of a batch at a time
+    void animateLightCycles(LightCycleBatch &batch, float time);
+
+    // Function to time both kernels over count entities against the same loops written with std::sin and std::cos,
+    // and print the time per update and the largest difference between the two
+    void runAnimationBenchmark(size_t count);
+
+} // namespace utils_animation
+
+#endif // ANIMATION_HPP
@@ -0,0 +1,222 @@
+// bvh.cpp
+#include "bvh.hpp"
+#include <algorithm>
+
+namespace utils_scene
+{
+
+    // Objects per leaf before a node is split
+    static const unsigned int MAX_LEAF_OBJECTS = 4;
+
+    // Function to merge two boxes
+    static AABB mergeBounds(const AABB &a, const AABB &b)
+    {
+        return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+    }
+
+    Frustum extractFrustum(const glm::mat4 &viewProjection)
+    {
+        // Rows of the matrix (glm is column major)
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0]; // Left
+        frustum.planes[1] = rows[3] - rows[0]; // Right
+        frustum.planes[2] = rows[3] + rows[1]; // Bottom
+        frustum.planes[3] = rows[3] - rows[1]; // Top
+        frustum.planes[4] = rows[3] + rows[2]; // Near
+        frustum.planes[5] = rows[3] - rows[2]; // Far
+        for (auto &plane : frustum.planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsFrustum(const Frustum &frustum, const AABB &box)
+    {
+        for (const auto &plane : frustum.planes)
+        {
+            // Corner furthest along the plane normal
+            glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x,
+                               plane.y >= 0.0f ? box.max.y : box.min.y,
+                               plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ObjectBVH::build(const SceneStore &store)
+    {
+        nodes.clear();
+        leafIds.resize(store.size());
+        leafOfId.assign(store.size(), -1);
+        for (size_t slot = 0; slot < store.size(); ++slot)
+        {
+            leafIds[slot] = store.idAt(slot);
+        }
+        if (!leafIds.empty())
+        {
+            buildNode(store, 0, static_cast<unsigned int>(leafIds.size()), -1);
+        }
+    }
+
+    int ObjectBVH::buildNode(const SceneStore &store, unsigned int first, unsigned int count, int parent)
+    {
+        int nodeIndex = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+
+        // Bounds of the objects and of their centers
+        AABB bounds = store.bounds[store.slotOf(leafIds[first])];
+        glm::vec3 centerMin = (bounds.min + bounds.max) * 0.5f;
+        glm::vec3 centerMax = centerMin;
+        for (unsigned int i = first + 1; i < first + count; ++i)
+        {
+            const AABB &box = store.bounds[store.slotOf(leafIds[i])];
+            bounds = mergeBounds(bounds, box);
+            centerMin = glm::min(centerMin, (box.min + box.max) * 0.5f);
+            centerMax = glm::max(centerMax, (box.min + box.max) * 0.5f);
+        }
+
+        Node node;
+        node.bounds = bounds;
+        node.parent = parent;
+        node.left = -1;
+        node.right = -1;
+        node.first = first;
+        node.count = count;
+
+        if (count <= MAX_LEAF_OBJECTS)
+        {
+            for (unsigned int i = first; i < first + count; ++i)
+            {
+                leafOfId[leafIds[i]] = nodeIndex;
+            }
+            nodes[nodeIndex] = node;
+            return nodeIndex;
+        }
+
+        // Median split along the longest axis of the centers
+        glm::vec3 extent = centerMax - centerMin;
+        int axis = 0;
+        if (extent.y > extent[axis])
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+
+        unsigned int half = count / 2;
+        std::nth_element(leafIds.begin() + first, leafIds.begin() + first + half, leafIds.begin() + first + count,
+                         [&](ObjectId a, ObjectId b)
+                         {
+                             const AABB &boxA = store.bounds[store.slotOf(a)];
+                             const AABB &boxB = store.bounds[store.slotOf(b)];
+                             return boxA.min[axis] + boxA.max[axis] < boxB.min[axis] + boxB.max[axis];
+                         });
+
+        node.count = 0;
+        nodes[nodeIndex] = node;
+        int left = buildNode(store, first, half, nodeIndex);
+        int right = buildNode(store, first + half, count - half, nodeIndex);
+        nodes[nodeIndex].left = left;
+        nodes[nodeIndex].right = right;
+        return nodeIndex;
+    }
+
+    void ObjectBVH::refit(const SceneStore &store)
+    {
+        for (ObjectId id : store.movedObjects())
+        {
+            if (id >= leafOfId.size() || leafOfId[id] < 0)
+            {
+                continue;
+            }
+
+            // Recompute the leaf from its objects
+            Node &leaf = nodes[leafOfId[id]];
+            leaf.bounds = store.bounds[store.slotOf(leafIds[leaf.first])];
+            for (unsigned int i = leaf.first + 1; i < leaf.first + leaf.count; ++i)
+            {
+                leaf.bounds = mergeBounds(leaf.bounds, store.bounds[store.slotOf(leafIds[i])]);
+            }
+
+            // Then every ancestor up to the root
+            for (int parent = leaf.parent; parent >= 0; parent = nodes[parent].parent)
+            {
+                nodes[parent].bounds = mergeBounds(nodes[nodes[parent].left].bounds, nodes[nodes[parent].right].bounds);
+            }
+        }
+    }
+
+    void ObjectBVH::cull(const SceneStore &store, const Frustum &frustum, std::vector<unsigned char> &visible) const
+    {
+        // Objects added after the build are not in the hierarchy, draw everything rather than lose them
+        if (leafIds.size() != store.size())
+        {
+            visible.assign(store.size(), 1);
+            return;
+        }
+
+        visible.assign(store.size(), 0);
+        if (!nodes.empty())
+        {
+            cullNode(store, 0, frustum, visible);
+        }
+    }
+
+    void ObjectBVH::markSubtree(const SceneStore &store, int nodeIndex, std::vector<unsigned char> &visible) const
+    {
+        const Node &node = nodes[nodeIndex];
+        if (node.left < 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                visible[store.slotOf(leafIds[i])] = 1;
+            }
+            return;
+        }
+        markSubtree(store, node.left, visible);
+        markSubtree(store, node.right, visible);
+    }
+
+    void ObjectBVH::cullNode(const SceneStore &store, int nodeIndex, const Frustum &frustum, std::vector<unsigned char> &visible) const
+    {
+        const Node &node = nodes[nodeIndex];
+
+        bool fullyInside = true;
+        for (const auto &plane : frustum.planes)
+        {
+            glm::vec3 normal(plane);
+            // Corner furthest along the plane normal, and the opposite one
+            glm::vec3 positive(normal.x >= 0.0f ? node.bounds.max.x : node.bounds.min.x,
+                               normal.y >= 0.0f ? node.bounds.max.y : node.bounds.min.y,
+                               normal.z >= 0.0f ? node.bounds.max.z : node.bounds.min.z);
+            glm::vec3 negative(normal.x >= 0.0f ? node.bounds.min.x : node.bounds.max.x,
+                               normal.y >= 0.0f ? node.bounds.min.y : node.bounds.max.y,
+                               normal.z >= 0.0f ? node.bounds.min.z : node.bounds.max.z);
+            if (glm::dot(normal, positive) + plane.w < 0.0f)
+            {
+                return; // Completely outside this plane
+            }
+            if (glm::dot(normal, negative) + plane.w < 0.0f)
+            {
+                fullyInside = false;
+            }
+        }
+
+        if (fullyInside || node.left < 0)
+        {
+            markSubtree(store, nodeIndex, visible);
+            return;
+        }
+        cullNode(store, node.left, frustum, visible);
+        cullNode(store, node.right, frustum, visible);
+    }
+
+} // namespace utils_scene
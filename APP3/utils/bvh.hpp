@@ -0,0 +1,62 @@
+// bvh.hpp
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "scene_store.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace utils_scene
+{
+
+    // View frustum as 6 planes (xyz = inward normal, w = offset)
+    struct Frustum
+    {
+        glm::vec4 planes[6];
+    };
+
+    // Function to extract the frustum planes of a projection * view matrix
+    Frustum extractFrustum(const glm::mat4 &viewProjection);
+
+    // Function to test whether a box is at least partly inside the frustum
+    bool intersectsFrustum(const Frustum &frustum, const AABB &box);
+
+    // Bounding volume hierarchy over the world bounds of a SceneStore.
+    // Leaves reference stable ObjectIds, so the store may be reordered without a rebuild.
+    class ObjectBVH
+    {
+    public:
+        // Function to build the hierarchy from scratch over every object of the store
+        void build(const SceneStore &store);
+
+        // Function to refit the leaves of the objects moved by the last updateMatrices() and their ancestors
+        void refit(const SceneStore &store);
+
+        // Function to flag, per slot, the objects whose bounds intersect the frustum
+        void cull(const SceneStore &store, const Frustum &frustum, std::vector<unsigned char> &visible) const;
+
+        size_t nodeCount() const { return nodes.size(); }
+
+    private:
+        struct Node
+        {
+            AABB bounds;
+            int parent;
+            int left;            // Children, -1 for a leaf
+            int right;
+            unsigned int first;  // Range in leafIds for a leaf
+            unsigned int count;
+        };
+
+        int buildNode(const SceneStore &store, unsigned int first, unsigned int count, int parent);
+        void markSubtree(const SceneStore &store, int nodeIndex, std::vector<unsigned char> &visible) const;
+        void cullNode(const SceneStore &store, int nodeIndex, const Frustum &frustum, std::vector<unsigned char> &visible) const;
+
+        std::vector<Node> nodes;
+        std::vector<ObjectId> leafIds;
+        std::vector<int> leafOfId; // Leaf node index of each ObjectId
+    };
+
+} // namespace utils_scene
+
+#endif // BVH_HPP
@@ -1,4 +1,9 @@
 #include "collision.hpp"
+#include <cmath>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define COLLISION_USE_SSE 1
+#endif
 
 bool checkCollision(const glm::vec3& cylinderBaseCenter, float radius, float height, const AABB& box) {
     float horizontalDistanceSquared = 0.0f;
@@ -22,4 +27,157 @@ bool checkCollision(const glm::vec3& cylinderBaseCenter, float radius, float hei
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+CollisionGrid::CollisionGrid(float cellSize_)
+    : cellSize(cellSize_), queryStamp(0) {}
+
+std::uint64_t CollisionGrid::cellKey(int x, int z) {
+    // Shift the unsigned bit patterns, left-shifting a negative cell index is undefined
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(z);
+}
+
+CollisionGrid::CellRange CollisionGrid::cellRange(const glm::vec3& min, const glm::vec3& max) const {
+    CellRange range;
+    range.minX = static_cast<int>(std::floor(min.x / cellSize));
+    range.minZ = static_cast<int>(std::floor(min.z / cellSize));
+    range.maxX = static_cast<int>(std::floor(max.x / cellSize));
+    range.maxZ = static_cast<int>(std::floor(max.z / cellSize));
+    return range;
+}
+
+void CollisionGrid::insertEntry(std::uint32_t entry) {
+    CellRange range = cellRange(glm::vec3(minX[entry], minY[entry], minZ[entry]),
+                                glm::vec3(maxX[entry], maxY[entry], maxZ[entry]));
+    entryCells[entry] = range;
+    for (int x = range.minX; x <= range.maxX; ++x) {
+        for (int z = range.minZ; z <= range.maxZ; ++z) {
+            cells[cellKey(x, z)].push_back(entry);
+        }
+    }
+}
+
+void CollisionGrid::removeEntry(std::uint32_t entry) {
+    const CellRange& range = entryCells[entry];
+    for (int x = range.minX; x <= range.maxX; ++x) {
+        for (int z = range.minZ; z <= range.maxZ; ++z) {
+            std::vector<std::uint32_t>& cell = cells[cellKey(x, z)];
+            for (size_t i = 0; i < cell.size(); ++i) {
+                if (cell[i] == entry) {
+                    cell[i] = cell.back();
+                    cell.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void CollisionGrid::addStore(const utils_scene::SceneStore& store) {
+    std::uint32_t first = static_cast<std::uint32_t>(minX.size());
+    stores.push_back(&store);
+    storeFirstEntry.push_back(first);
+
+    size_t count = store.size();
+    minX.resize(first + count); minY.resize(first + count); minZ.resize(first + count);
+    maxX.resize(first + count); maxY.resize(first + count); maxZ.resize(first + count);
+    entryCells.resize(first + count);
+    stamps.resize(first + count, 0);
+
+    for (size_t slot = 0; slot < count; ++slot) {
+        std::uint32_t entry = first + store.idAt(slot);
+        const AABB& box = store.bounds[slot];
+        minX[entry] = box.min.x; minY[entry] = box.min.y; minZ[entry] = box.min.z;
+        maxX[entry] = box.max.x; maxY[entry] = box.max.y; maxZ[entry] = box.max.z;
+        insertEntry(entry);
+    }
+}
+
+void CollisionGrid::refresh(const utils_scene::SceneStore& store) {
+    for (size_t k = 0; k < stores.size(); ++k) {
+        if (stores[k] != &store) {
+            continue;
+        }
+        size_t end = (k + 1 < stores.size()) ? storeFirstEntry[k + 1] : minX.size();
+        for (utils_scene::ObjectId id : store.movedObjects()) {
+            std::uint32_t entry = storeFirstEntry[k] + id;
+            if (entry >= end) {
+                continue; // Added after the grid was built
+            }
+            const AABB& box = store.bounds[store.slotOf(id)];
+            removeEntry(entry);
+            minX[entry] = box.min.x; minY[entry] = box.min.y; minZ[entry] = box.min.z;
+            maxX[entry] = box.max.x; maxY[entry] = box.max.y; maxZ[entry] = box.max.z;
+            insertEntry(entry);
+        }
+    }
+}
+
+bool CollisionGrid::collides(const glm::vec3& from, const glm::vec3& to, float radius, float height) {
+    // Broadphase: gather the entries of every cell touched by the swept cylinder, once each
+    glm::vec3 sweepMin = glm::min(from, to) - glm::vec3(radius, 0.0f, radius);
+    glm::vec3 sweepMax = glm::max(from, to) + glm::vec3(radius, 0.0f, radius);
+    CellRange range = cellRange(sweepMin, sweepMax);
+
+    ++queryStamp;
+    candidates.clear();
+    for (int x = range.minX; x <= range.maxX; ++x) {
+        for (int z = range.minZ; z <= range.maxZ; ++z) {
+            auto it = cells.find(cellKey(x, z));
+            if (it == cells.end()) {
+                continue;
+            }
+            for (std::uint32_t entry : it->second) {
+                if (stamps[entry] != queryStamp) {
+                    stamps[entry] = queryStamp;
+                    candidates.push_back(entry);
+                }
+            }
+        }
+    }
+
+    // Narrowphase at the destination, same test as checkCollision
+    float radiusSquared = radius * radius;
+    float cylinderTop = to.y + height / 2.0f;
+    float cylinderBottom = to.y - height / 2.0f;
+    size_t i = 0;
+
+#ifdef COLLISION_USE_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 cx = _mm_set1_ps(to.x);
+    const __m128 cz = _mm_set1_ps(to.z);
+    const __m128 r2 = _mm_set1_ps(radiusSquared);
+    const __m128 top = _mm_set1_ps(cylinderTop);
+    const __m128 bottom = _mm_set1_ps(cylinderBottom);
+    for (; i + 4 <= candidates.size(); i += 4) {
+        const std::uint32_t* e = &candidates[i];
+        __m128 bMinX = _mm_setr_ps(minX[e[0]], minX[e[1]], minX[e[2]], minX[e[3]]);
+        __m128 bMaxX = _mm_setr_ps(maxX[e[0]], maxX[e[1]], maxX[e[2]], maxX[e[3]]);
+        __m128 bMinZ = _mm_setr_ps(minZ[e[0]], minZ[e[1]], minZ[e[2]], minZ[e[3]]);
+        __m128 bMaxZ = _mm_setr_ps(maxZ[e[0]], maxZ[e[1]], maxZ[e[2]], maxZ[e[3]]);
+        __m128 bMinY = _mm_setr_ps(minY[e[0]], minY[e[1]], minY[e[2]], minY[e[3]]);
+        __m128 bMaxY = _mm_setr_ps(maxY[e[0]], maxY[e[1]], maxY[e[2]], maxY[e[3]]);
+
+        // Distance from the cylinder axis to the box on X and Z, zero inside the box
+        __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(bMinX, cx), zero), _mm_max_ps(_mm_sub_ps(cx, bMaxX), zero));
+        __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(bMinZ, cz), zero), _mm_max_ps(_mm_sub_ps(cz, bMaxZ), zero));
+        __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+
+        __m128 hit = _mm_and_ps(_mm_cmple_ps(distanceSquared, r2),
+                                _mm_and_ps(_mm_cmpge_ps(top, bMinY), _mm_cmple_ps(bottom, bMaxY)));
+        if (_mm_movemask_ps(hit) != 0) {
+            return true;
+        }
+    }
+#endif
+
+    // Remaining candidates (or all of them without SSE)
+    for (; i < candidates.size(); ++i) {
+        std::uint32_t e = candidates[i];
+        AABB box(glm::vec3(minX[e], minY[e], minZ[e]), glm::vec3(maxX[e], maxY[e], maxZ[e]));
+        if (checkCollision(to, radius, height, box)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -2,7 +2,55 @@
 #define COLLISION_HPP
 
 #include "utilities.hpp"
+#include "scene_store.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 bool checkCollision(const glm::vec3& cylinderBaseCenter, float radius, float height, const AABB& box);
 
-#endif // COLLISION_HPP
\ No newline at end of file
+// Uniform grid (spatial hash on the XZ plane) over the bounds of scene stores.
+// Boxes are kept as separate coordinate arrays so candidates can be tested four at a time.
+class CollisionGrid {
+public:
+    explicit CollisionGrid(float cellSize = 2.0f);
+
+    // Function to insert every object of a store, call once per store after scene setup
+    void addStore(const utils_scene::SceneStore& store);
+
+    // Function to move the objects of a store reported by its last updateMatrices() to their new cells
+    void refresh(const utils_scene::SceneStore& store);
+
+    // Function to test a camera cylinder moving from 'from' to 'to' against the objects in the cells it sweeps
+    bool collides(const glm::vec3& from, const glm::vec3& to, float radius, float height);
+
+    // Number of boxes tested by the last collides() call
+    size_t lastCandidateCount() const { return candidates.size(); }
+
+private:
+    struct CellRange {
+        int minX, minZ, maxX, maxZ;
+    };
+
+    CellRange cellRange(const glm::vec3& min, const glm::vec3& max) const;
+    static std::uint64_t cellKey(int x, int z);
+    void insertEntry(std::uint32_t entry);
+    void removeEntry(std::uint32_t entry);
+
+    float cellSize;
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t> > cells;
+
+    // Per entry columns
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<CellRange> entryCells;
+    std::vector<std::uint32_t> stamps;
+
+    // First entry of each registered store, entries of a store follow its ObjectIds
+    std::vector<const utils_scene::SceneStore*> stores;
+    std::vector<std::uint32_t> storeFirstEntry;
+
+    std::vector<std::uint32_t> candidates;
+    std::uint32_t queryStamp;
+};
+
+#endif // COLLISION_HPP
@@ -83,6 +83,24 @@ void computeCubeTangents(std::vector<Vertex3D>& vertices, const std::vector<GLui
     }
 }
 
+// Vertex3D layout shared by every cube VAO (locations 0 to 4)
+static void setupVertex3DAttributes() {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, texCoords));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, tangent));
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, bitangent));
+}
+
 void setupCubeBuffers(const std::vector<Vertex3D>& vertices, const std::vector<GLuint>& indices, GLuint& cubeVBO, GLuint& cubeEBO, GLuint& cubeVAO) {
     glGenBuffers(1, &cubeVBO);
     glGenBuffers(1, &cubeEBO);
@@ -96,22 +114,141 @@ void setupCubeBuffers(const std::vector<Vertex3D>& vertices, const std::vector<G
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, position));
+    setupVertex3DAttributes();
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, normal));
+    glBindVertexArray(0);
+}
 
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, texCoords));
+void setupInstancedCubeBuffers(GLuint cubeVAO, const std::vector<glm::mat4>& instanceMatrices, GLuint& instanceVBO, GLuint& instancedVAO) {
+    // Fetch the vertex and index buffers of the source cube so the mesh data is shared, not copied
+    GLint cubeVBO = 0, cubeEBO = 0;
+    glBindVertexArray(cubeVAO);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &cubeVBO);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &cubeEBO);
 
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, tangent));
+    glGenBuffers(1, &instanceVBO);
+    glGenVertexArrays(1, &instancedVAO);
 
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, bitangent));
+    glBindVertexArray(instancedVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(cubeVBO));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLuint>(cubeEBO));
+    setupVertex3DAttributes();
+
+    // Per-instance model matrix, one vec4 column per location (5 to 8)
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceMatrices.size() * sizeof(glm::mat4), instanceMatrices.data(), GL_STATIC_DRAW);
+    for (GLuint column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(5 + column);
+        glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(5 + column, 1);
+    }
 
     glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void createGreedyCubeMesh(const std::vector<int>& cells, const glm::ivec3& dims, int group, const glm::vec3& cellOrigin,
+                          std::vector<Vertex3D>& vertices, std::vector<GLuint>& indices) {
+    vertices.clear();
+    indices.clear();
+
+    // The faces of the unit cube are the template for every quad: same corner order and UV orientation
+    std::vector<Vertex3D> cubeVertices;
+    std::vector<GLuint> cubeIndices;
+    createCube(cubeVertices, cubeIndices);
+
+    auto cellAt = [&](const glm::ivec3& cell) {
+        if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= dims.x || cell.y >= dims.y || cell.z >= dims.z) {
+            return -1;
+        }
+        return cells[cell.x + dims.x * (cell.y + dims.y * cell.z)];
+    };
+
+    std::vector<unsigned char> mask;
+    for (int face = 0; face < 6; ++face) {
+        const glm::vec3 normal = cubeVertices[face * 4].normal;
+        const int d = (normal.x != 0.0f) ? 0 : (normal.y != 0.0f ? 1 : 2);
+        const int direction = (normal[d] > 0.0f) ? 1 : -1;
+        // Texture axes of the face: U along X except on the X faces, V along Y except on the Y faces
+        const int uAxis = (d == 0) ? 2 : 0;
+        const int vAxis = (d == 1) ? 2 : 1;
+
+        mask.assign(dims[uAxis] * dims[vAxis], 0);
+        for (int layer = 0; layer < dims[d]; ++layer) {
+            // Faces of this layer that belong to the group and are not covered by a neighbouring cube
+            for (int v = 0; v < dims[vAxis]; ++v) {
+                for (int u = 0; u < dims[uAxis]; ++u) {
+                    glm::ivec3 cell;
+                    cell[d] = layer;
+                    cell[uAxis] = u;
+                    cell[vAxis] = v;
+                    glm::ivec3 neighbour = cell;
+                    neighbour[d] += direction;
+                    mask[u + dims[uAxis] * v] = (cellAt(cell) == group && cellAt(neighbour) < 0) ? 1 : 0;
+                }
+            }
+
+            // Greedy merge: grow each quad along U, then along V while the whole row is free
+            for (int v = 0; v < dims[vAxis]; ++v) {
+                for (int u = 0; u < dims[uAxis]; ) {
+                    if (!mask[u + dims[uAxis] * v]) {
+                        ++u;
+                        continue;
+                    }
+                    int width = 1;
+                    while (u + width < dims[uAxis] && mask[u + width + dims[uAxis] * v]) {
+                        ++width;
+                    }
+                    int height = 1;
+                    bool canGrow = true;
+                    while (v + height < dims[vAxis] && canGrow) {
+                        for (int k = 0; k < width; ++k) {
+                            if (!mask[u + k + dims[uAxis] * (v + height)]) {
+                                canGrow = false;
+                                break;
+                            }
+                        }
+                        if (canGrow) {
+                            ++height;
+                        }
+                    }
+                    for (int dv = 0; dv < height; ++dv) {
+                        for (int du = 0; du < width; ++du) {
+                            mask[u + du + dims[uAxis] * (v + dv)] = 0;
+                        }
+                    }
+
+                    // Stretch the template face over the quad, UVs scale with it so the texture repeats per cube
+                    glm::vec3 low, high;
+                    low[d] = high[d] = cellOrigin[d] + layer;
+                    low[uAxis] = cellOrigin[uAxis] + u - 0.5f;
+                    high[uAxis] = cellOrigin[uAxis] + u + width - 0.5f;
+                    low[vAxis] = cellOrigin[vAxis] + v - 0.5f;
+                    high[vAxis] = cellOrigin[vAxis] + v + height - 0.5f;
+
+                    GLuint base = static_cast<GLuint>(vertices.size());
+                    for (int corner = 0; corner < 4; ++corner) {
+                        const Vertex3D& source = cubeVertices[face * 4 + corner];
+                        glm::vec3 position;
+                        for (int axis = 0; axis < 3; ++axis) {
+                            position[axis] = (axis == d) ? low[d] + source.position[d]
+                                                         : (source.position[axis] < 0.0f ? low[axis] : high[axis]);
+                        }
+                        glm::vec2 uv = source.texCoords * glm::vec2(static_cast<float>(width), static_cast<float>(height));
+                        vertices.push_back(Vertex3D(position, source.normal, uv));
+                    }
+                    for (int k = 0; k < 6; ++k) {
+                        indices.push_back(base + cubeIndices[face * 6 + k] - face * 4);
+                    }
+
+                    u += width;
+                }
+            }
+        }
+    }
+
+    computeCubeTangents(vertices, indices);
 }
 
 } // namespace utils_object
\ No newline at end of file
@@ -9,6 +9,13 @@ namespace utils_object {
 void createCube(std::vector<Vertex3D>& vertices, std::vector<GLuint>& indices);
 void computeCubeTangents(std::vector<Vertex3D>& vertices, const std::vector<GLuint>& indices);
 void setupCubeBuffers(const std::vector<Vertex3D>& vertices, const std::vector<GLuint>& indices, GLuint& cubeVBO, GLuint& cubeEBO, GLuint& cubeVAO);
+// Builds a VAO reusing the mesh of cubeVAO plus a per-instance model matrix at locations 5 to 8
+void setupInstancedCubeBuffers(GLuint cubeVAO, const std::vector<glm::mat4>& instanceMatrices, GLuint& instanceVBO, GLuint& instancedVAO);
+// Builds the visible faces of the unit cubes of a grid as greedily merged quads with repeating UVs.
+// cells holds a group index per cell (-1 when empty); only faces of cells in 'group' that do not touch
+// another filled cell are emitted. cellOrigin is the center of cell (0, 0, 0) in mesh space.
+void createGreedyCubeMesh(const std::vector<int>& cells, const glm::ivec3& dims, int group, const glm::vec3& cellOrigin,
+                          std::vector<Vertex3D>& vertices, std::vector<GLuint>& indices);
 
 }
 
@@ -0,0 +1,106 @@
+// frame_uniforms.cpp
+#include "frame_uniforms.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace utils_loader
+{
+
+    FrameUniformBuffer::FrameUniformBuffer()
+        : buffer(0), lightOffset(0), maxLights(0) {}
+
+    void FrameUniformBuffer::create(int maxLightCount)
+    {
+        maxLights = maxLightCount;
+
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        lightOffset = ((sizeof(FrameData) + alignment - 1) / alignment) * alignment;
+
+        GLsizeiptr lightSize = maxLights * sizeof(AdditionalLightData);
+        staging.assign(lightOffset + lightSize, 0);
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, buffer, 0, sizeof(FrameData));
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, buffer, lightOffset, lightSize);
+    }
+
+    void FrameUniformBuffer::upload(const FrameData &frame, const utils_light::LightRegistry &registry,
+                                    const std::vector<int> &shadowSlots, const glm::mat4 &viewMatrix)
+    {
+        const std::vector<utils_light::SimplePointLight> &lights = registry.lights();
+        int count = std::min(frame.numAdditionalLights, maxLights);
+
+        std::memcpy(staging.data(), &frame, sizeof(FrameData));
+        AdditionalLightData *lightData = reinterpret_cast<AdditionalLightData *>(staging.data() + lightOffset);
+        for (int i = 0; i < count; ++i)
+        {
+            lightData[i].position = glm::vec4(glm::vec3(viewMatrix * glm::vec4(lights[i].position, 1.0f)), lights[i].intensity);
+            float shadowSlot = i < static_cast<int>(shadowSlots.size()) ? static_cast<float>(shadowSlots[i]) : -1.0f;
+            lightData[i].color = glm::vec4(lights[i].color, shadowSlot);
+            lightData[i].range = glm::vec4(lights[i].radius, static_cast<float>(registry.roomAt(i)), 0.0f, 0.0f);
+        }
+
+        // One update covering the frame block and the lights in use
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, lightOffset + count * sizeof(AdditionalLightData), staging.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void FrameUniformBuffer::bindBlocks(const Shader &shader)
+    {
+        GLuint frameIndex = shader.getUniformBlockIndex("FrameData");
+        GLuint lightIndex = shader.getUniformBlockIndex("LightData");
+        if (frameIndex == GL_INVALID_INDEX || lightIndex == GL_INVALID_INDEX)
+        {
+            std::cerr << "Failed to find the FrameData/LightData uniform blocks in program " << shader.getGLId() << std::endl;
+            return;
+        }
+        glUniformBlockBinding(shader.getGLId(), frameIndex, FRAME_DATA_BINDING);
+        glUniformBlockBinding(shader.getGLId(), lightIndex, LIGHT_DATA_BINDING);
+    }
+
+    ObjectLightUniforms::ObjectLightUniforms()
+        : countLocation(-1), listLocation(-1), mainLightLocation(-1), currentMainLight(-1), skipped(0) {}
+
+    void ObjectLightUniforms::begin(const Shader &shader)
+    {
+        // Reflected lookups, a reloaded program may reuse the id of the one it replaced
+        countLocation = shader.getUniformLocation(Uniform::ObjectLightCount);
+        listLocation = shader.getUniformLocation(Uniform::ObjectLights);
+        mainLightLocation = shader.getUniformLocation(Uniform::ReceivesMainLight);
+        current.clear();
+        currentMainLight = -1;
+        skipped = 0;
+    }
+
+    void ObjectLightUniforms::apply(const utils_light::ObjectLightLists &lists, utils_scene::ObjectId id)
+    {
+        const int *first = lists.lights.data() + lists.offsets[id];
+        const int *last = lists.lights.data() + lists.offsets[id + 1];
+        int mainLight = lists.receivesMainLight[id];
+
+        // Neighbouring objects often share their list
+        if (mainLight == currentMainLight && current.size() == static_cast<size_t>(last - first) && std::equal(first, last, current.begin()))
+        {
+            skipped++;
+            return;
+        }
+        current.assign(first, last);
+        currentMainLight = mainLight;
+
+        GLsizei count = static_cast<GLsizei>(current.size());
+        glUniform1i(countLocation, count);
+        if (count > 0)
+        {
+            glUniform1iv(listLocation, count, current.data());
+        }
+        glUniform1f(mainLightLocation, mainLight ? 1.0f : 0.0f);
+    }
+
+} // namespace utils_loader
@@ -0,0 +1,89 @@
+// frame_uniforms.hpp
+#ifndef FRAME_UNIFORMS_HPP
+#define FRAME_UNIFORMS_HPP
+
+#include "light_registry.hpp"
+#include "shader.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace utils_loader
+{
+
+    // Uniform buffer binding points of the std140 blocks declared by the room shaders
+    const GLuint FRAME_DATA_BINDING = 0;
+    const GLuint LIGHT_DATA_BINDING = 1;
+
+    // Mirror of the FrameData block, each scalar fills the fourth component of the vec3 before it (std140)
+    struct FrameData
+    {
+        glm::vec3 lightPosView;       // Main light position in view space
+        float farPlane;
+        glm::vec3 mainLightIntensity; // Main light color, objects in the other room mask it out
+        float time;
+        glm::vec3 lightPosWorld;
+        int numAdditionalLights;
+        glm::vec3 cameraPosWorld;
+        float padding;
+    };
+
+    // Mirror of one entry of the LightData block
+    struct AdditionalLightData
+    {
+        glm::vec4 position; // xyz position in view space, w intensity
+        glm::vec4 color;    // rgb color, w shadow atlas slot or -1
+        glm::vec4 range;    // x distance past which the light contributes nothing (the light radius), y room side
+    };
+
+    // A single uniform buffer holding both blocks, rewritten with one update per frame
+    class FrameUniformBuffer
+    {
+    public:
+        FrameUniformBuffer();
+
+        // Function to allocate the buffer and attach both blocks to their binding points
+        void create(int maxLights);
+
+        // Function to upload the frame data and the first frame.numAdditionalLights lights (view space positions).
+        // shadowSlots holds the shadow atlas slot of each light, lights past its end are unshadowed.
+        void upload(const FrameData &frame, const utils_light::LightRegistry &registry,
+                    const std::vector<int> &shadowSlots, const glm::mat4 &viewMatrix);
+
+        // Function to point the FrameData and LightData blocks of a program at their binding points
+        static void bindBlocks(const Shader &shader);
+
+    private:
+        GLuint buffer;
+        GLintptr lightOffset; // Start of LightData, aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+        int maxLights;
+        std::vector<unsigned char> staging;
+    };
+
+    // Per-object light list uniforms of the room shaders, only re-uploaded when the list differs from the last one
+    class ObjectLightUniforms
+    {
+    public:
+        ObjectLightUniforms();
+
+        // Function to fetch the locations of a program and forget the last uploaded list, call when a pass starts
+        void begin(const Shader &shader);
+
+        // Function to upload the list of an object unless it matches the current one
+        void apply(const utils_light::ObjectLightLists &lists, utils_scene::ObjectId id);
+
+        // Number of list uploads skipped since the last begin()
+        unsigned int skippedUploads() const { return skipped; }
+
+    private:
+        GLint countLocation;
+        GLint listLocation;
+        GLint mainLightLocation;
+        std::vector<int> current;
+        int currentMainLight;
+        unsigned int skipped;
+    };
+
+} // namespace utils_loader
+
+#endif // FRAME_UNIFORMS_HPP
@@ -0,0 +1,128 @@
+// gbuffer.cpp
+#include "gbuffer.hpp"
+#include <iostream>
+
+namespace utils_scene
+{
+
+    GBuffer::GBuffer()
+        : fbo(0), depth(0), emptyVAO(0), width(0), height(0)
+    {
+        for (int t = 0; t < static_cast<int>(GBufferTarget::Count); ++t)
+        {
+            targets[t] = 0;
+        }
+    }
+
+    // Function to allocate one screen sized texture, sampled texel for texel
+    static GLuint createTarget(GLint internalFormat, GLenum format, GLenum type, int width, int height)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void GBuffer::create(int targetWidth, int targetHeight)
+    {
+        release();
+        width = targetWidth;
+        height = targetHeight;
+
+        targets[static_cast<int>(GBufferTarget::Albedo)] = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+        targets[static_cast<int>(GBufferTarget::Surface)] = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+        targets[static_cast<int>(GBufferTarget::Normal)] = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+        targets[static_cast<int>(GBufferTarget::Specular)] = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+        depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        GLenum drawBuffers[static_cast<int>(GBufferTarget::Count)];
+        for (int t = 0; t < static_cast<int>(GBufferTarget::Count); ++t)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + t, GL_TEXTURE_2D, targets[t], 0);
+            drawBuffers[t] = GL_COLOR_ATTACHMENT0 + t;
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        glDrawBuffers(static_cast<GLsizei>(GBufferTarget::Count), drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "G-buffer framebuffer not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // Core profile draws need a vertex array even without attributes
+        glGenVertexArrays(1, &emptyVAO);
+
+        double megabytes = (4.0 + 4.0 + 8.0 + 4.0 + 4.0) * width * height / (1024.0 * 1024.0);
+        std::cout << "G-buffer: " << width << "x" << height << ", " << megabytes << " MB of video memory" << std::endl;
+    }
+
+    void GBuffer::release()
+    {
+        if (fbo != 0)
+        {
+            glDeleteFramebuffers(1, &fbo);
+            fbo = 0;
+        }
+        for (int t = 0; t < static_cast<int>(GBufferTarget::Count); ++t)
+        {
+            if (targets[t] != 0)
+            {
+                glDeleteTextures(1, &targets[t]);
+                targets[t] = 0;
+            }
+        }
+        if (depth != 0)
+        {
+            glDeleteTextures(1, &depth);
+            depth = 0;
+        }
+        if (emptyVAO != 0)
+        {
+            glDeleteVertexArrays(1, &emptyVAO);
+            emptyVAO = 0;
+        }
+    }
+
+    void GBuffer::bindForWriting() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+
+        // Per-target clears leave the clear color of the default framebuffer alone
+        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const GLfloat farDepth = 1.0f;
+        for (int t = 0; t < static_cast<int>(GBufferTarget::Count); ++t)
+        {
+            glClearBufferfv(GL_COLOR, t, zero);
+        }
+        glClearBufferfv(GL_DEPTH, 0, &farDepth);
+    }
+
+    void GBuffer::bindTextures() const
+    {
+        for (int t = 0; t < static_cast<int>(GBufferTarget::Count); ++t)
+        {
+            glActiveTexture(GL_TEXTURE0 + GBUFFER_FIRST_UNIT + t);
+            glBindTexture(GL_TEXTURE_2D, targets[t]);
+        }
+        glActiveTexture(GL_TEXTURE0 + GBUFFER_FIRST_UNIT + static_cast<int>(GBufferTarget::Count));
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void GBuffer::drawFullScreen() const
+    {
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+    }
+
+} // namespace utils_scene
@@ -0,0 +1,55 @@
+// gbuffer.hpp
+#ifndef GBUFFER_HPP
+#define GBUFFER_HPP
+
+#include <glad/glad.h>
+
+namespace utils_scene
+{
+
+    // Color targets of the G-buffer, in the order of the outputs of deferred_gbuffer.fs
+    enum class GBufferTarget
+    {
+        Albedo,   // RGBA8: rgb albedo, a material alpha
+        Surface,  // RGBA8: rgb texture color, a specular map intensity
+        Normal,   // RGBA16F: xyz view space normal, w shininess
+        Specular, // RGBA8: rgb specular color, a room side of the object over 2
+        Count
+    };
+
+    // First texture unit of the G-buffer in the lighting pass, the targets follow in order and the depth comes last.
+    // Units below it hold the material maps, the shadow maps and the light clusters.
+    const int GBUFFER_FIRST_UNIT = 7;
+
+    // Render targets of the deferred path: every opaque surface attribute the room 1 lighting reads, and depth
+    class GBuffer
+    {
+    public:
+        GBuffer();
+
+        // Function to allocate the targets at the window size and print their video memory
+        void create(int width, int height);
+
+        // Function to delete the targets and the framebuffer
+        void release();
+
+        // Function to draw into the targets, clearing them (depth writes must be enabled)
+        void bindForWriting() const;
+
+        // Function to bind the targets and the depth to GBUFFER_FIRST_UNIT and the units after it
+        void bindTextures() const;
+
+        // Function to draw a triangle covering the screen, positions come from gl_VertexID
+        void drawFullScreen() const;
+
+    private:
+        GLuint fbo;
+        GLuint targets[static_cast<int>(GBufferTarget::Count)];
+        GLuint depth;
+        GLuint emptyVAO;
+        int width, height;
+    };
+
+} // namespace utils_scene
+
+#endif // GBUFFER_HPP
@@ -10,7 +10,15 @@ int numCubesZ = 15;    // Number of cubes along the z-axis
 float spacingX = 1.0f; // Distance between each cube along the x-axis
 float spacingZ = 1.0f; // Distance between each cube along the z-axis
 
-const GLuint SHADOW_WIDTH = 4096, SHADOW_HEIGHT = 4096;
+int shadowTier = 3;
+bool shadowTierChanged = false;
+bool layeredShadows = true;
+int shadowFacesPerFrame = 2;
+bool shadowCameraFacesFirst = true;
+bool deferredShading = false;
+bool weightedTransparency = false;
+
+const float ROOM_BOUNDARY_X = 20.5f; // Room 2 starts past this x coordinate
 
 float cameraRadius = 0.15f; // Radius of the camera sphere for collision detection
 float cameraHeight = 2.0f;  // Height of the camera cylinder
@@ -28,13 +36,6 @@ int MAX_ADDITIONAL_LIGHTS = 100; // Maximum number of additional lights excludin
 
 bool wireframeMode = false;
 
-// Define color masks for RGB channels
-glm::vec3 colorMasks[3] = {
-    glm::vec3(1.0f, 0.0f, 0.0f), // Red
-    glm::vec3(0.0f, 1.0f, 0.0f), // Green
-    glm::vec3(0.0f, 0.0f, 1.0f)  // Blue
-};
-
 float yaw = -90.0f; // Horizontal angle
 float pitch = 0.0f; // Vertical angle
 
@@ -14,8 +14,15 @@ extern int numCubesZ;
 extern float spacingX;
 extern float spacingZ;
 
-extern const GLuint SHADOW_WIDTH;
-extern const GLuint SHADOW_HEIGHT;
+extern int shadowTier;          // Index into utils_shadow::SHADOW_TIERS
+extern bool shadowTierChanged; // Set when the shadow maps must be reallocated at the new tier
+extern bool layeredShadows; // Point shadow drawn in one geometry shader pass instead of one pass per cube face
+extern int shadowFacesPerFrame;     // Stale faces of the static shadow cache refreshed per frame
+extern bool shadowCameraFacesFirst; // Refresh the faces the camera sees before the others, round-robin otherwise
+extern bool deferredShading;        // Room 1 opaque objects drawn through the G-buffer, chosen at startup with --deferred
+extern bool weightedTransparency;   // Transparent objects blended order-independently instead of sorted, chosen with --oit
+
+extern const float ROOM_BOUNDARY_X; // x coordinate of the wall between room 1 and room 2
 
 extern float cameraRadius; // Radius of the camera sphere for collision detection
 extern float cameraHeight; // Height of the camera cylinder
@@ -53,9 +60,6 @@ struct SphereVertex {
     glm::vec3 bitangent;
 };
 
-// Define color masks for RGB channels
-extern glm::vec3 colorMasks[3];
-
 extern float yaw;   // Horizontal angle
 extern float pitch; // Vertical angle
 
@@ -0,0 +1,202 @@
+// light_clusters.cpp
+#include "light_clusters.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace utils_light
+{
+
+    LightClusters::LightClusters()
+        : gridBuffer(0), gridTexture(0), indexBuffer(0), indexTexture(0),
+          boundsProjection(0.0f), lookup(0.0f), bounds(CLUSTER_COUNT),
+          grid(CLUSTER_COUNT * 2, 0), counts(CLUSTER_COUNT, 0)
+    {
+        for (int k = 0; k <= CLUSTER_SLICES; ++k)
+        {
+            sliceDepths[k] = 0.0f;
+        }
+    }
+
+    void LightClusters::create()
+    {
+        release();
+
+        glGenBuffers(1, &gridBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned int), grid.data(), GL_STREAM_DRAW);
+        glGenTextures(1, &gridTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+
+        // Never empty, a texture buffer over an empty store is undefined to sample
+        unsigned int noLight = 0;
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned int), &noLight, GL_STREAM_DRAW);
+        glGenTextures(1, &indexTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        std::cout << "Light clusters: " << CLUSTER_TILES_X << "x" << CLUSTER_TILES_Y << "x" << CLUSTER_SLICES
+                  << " froxels" << std::endl;
+    }
+
+    void LightClusters::release()
+    {
+        if (gridTexture != 0)
+        {
+            glDeleteTextures(1, &gridTexture);
+            gridTexture = 0;
+        }
+        if (indexTexture != 0)
+        {
+            glDeleteTextures(1, &indexTexture);
+            indexTexture = 0;
+        }
+        if (gridBuffer != 0)
+        {
+            glDeleteBuffers(1, &gridBuffer);
+            gridBuffer = 0;
+        }
+        if (indexBuffer != 0)
+        {
+            glDeleteBuffers(1, &indexBuffer);
+            indexBuffer = 0;
+        }
+    }
+
+    void LightClusters::computeBounds(const glm::mat4 &projMatrix)
+    {
+        boundsProjection = projMatrix;
+
+        // Planes and scales of a glm::perspective projection
+        float nearPlane = projMatrix[3][2] / (projMatrix[2][2] - 1.0f);
+        float farPlane = projMatrix[3][2] / (projMatrix[2][2] + 1.0f);
+        float sliceScale = CLUSTER_SLICES / std::log(farPlane / nearPlane);
+        lookup = glm::vec4(projMatrix[0][0], projMatrix[1][1], sliceScale, -std::log(nearPlane) * sliceScale);
+
+        // Exponential slices keep clusters roughly cubic along the view direction
+        for (int k = 0; k <= CLUSTER_SLICES; ++k)
+        {
+            sliceDepths[k] = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(k) / CLUSTER_SLICES);
+        }
+
+        for (int k = 0; k < CLUSTER_SLICES; ++k)
+        {
+            float depths[2] = {sliceDepths[k], sliceDepths[k + 1]};
+            for (int y = 0; y < CLUSTER_TILES_Y; ++y)
+            {
+                float ndcY[2] = {2.0f * y / CLUSTER_TILES_Y - 1.0f, 2.0f * (y + 1) / CLUSTER_TILES_Y - 1.0f};
+                for (int x = 0; x < CLUSTER_TILES_X; ++x)
+                {
+                    float ndcX[2] = {2.0f * x / CLUSTER_TILES_X - 1.0f, 2.0f * (x + 1) / CLUSTER_TILES_X - 1.0f};
+
+                    // The tile edges are lines through the eye, the box spans both ends at both depths
+                    AABB box(glm::vec3(1e30f), glm::vec3(-1e30f));
+                    for (int d = 0; d < 2; ++d)
+                    {
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            glm::vec3 corner(ndcX[c & 1] * depths[d] / lookup.x, ndcY[c >> 1] * depths[d] / lookup.y, -depths[d]);
+                            box.min = glm::min(box.min, corner);
+                            box.max = glm::max(box.max, corner);
+                        }
+                    }
+                    bounds[(k * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x] = box;
+                }
+            }
+        }
+    }
+
+    void LightClusters::build(const std::vector<SimplePointLight> &lights, int lightCount,
+                              const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix)
+    {
+        if (projMatrix != boundsProjection)
+        {
+            computeBounds(projMatrix);
+        }
+
+        // Light-major pass, only the slices a light's depth range overlaps are tested
+        pairs.clear();
+        std::fill(counts.begin(), counts.end(), 0u);
+        for (int i = 0; i < lightCount; ++i)
+        {
+            glm::vec3 center = glm::vec3(viewMatrix * glm::vec4(lights[i].position, 1.0f));
+            float reach = std::max(lights[i].radius, ROOM2_GRAVITY_RANGE);
+            float nearDepth = -center.z - reach;
+            float farDepth = -center.z + reach;
+            if (farDepth < sliceDepths[0] || nearDepth > sliceDepths[CLUSTER_SLICES])
+            {
+                continue;
+            }
+
+            int firstSlice = 0;
+            while (firstSlice < CLUSTER_SLICES - 1 && sliceDepths[firstSlice + 1] < nearDepth)
+            {
+                firstSlice++;
+            }
+            int lastSlice = firstSlice;
+            while (lastSlice < CLUSTER_SLICES - 1 && sliceDepths[lastSlice + 1] < farDepth)
+            {
+                lastSlice++;
+            }
+
+            for (int cluster = firstSlice * CLUSTER_TILES_X * CLUSTER_TILES_Y;
+                 cluster < (lastSlice + 1) * CLUSTER_TILES_X * CLUSTER_TILES_Y; ++cluster)
+            {
+                // Squared distance from the light to the cluster box
+                glm::vec3 closest = glm::clamp(center, bounds[cluster].min, bounds[cluster].max);
+                glm::vec3 delta = closest - center;
+                if (glm::dot(delta, delta) <= reach * reach)
+                {
+                    pairs.push_back(std::make_pair(cluster, i));
+                    counts[cluster]++;
+                }
+            }
+        }
+
+        // Counting sort by cluster, stable so every list stays in ascending light order
+        unsigned int offset = 0;
+        for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+        {
+            grid[2 * cluster] = offset;
+            grid[2 * cluster + 1] = 0;
+            offset += counts[cluster];
+        }
+        indices.assign(pairs.size(), 0u);
+        for (size_t p = 0; p < pairs.size(); ++p)
+        {
+            unsigned int *entry = &grid[2 * pairs[p].first];
+            indices[entry[0] + entry[1]] = static_cast<unsigned int>(pairs[p].second);
+            entry[1]++;
+        }
+
+        // Orphan both stores, the previous frame may still be reading them
+        glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned int), grid.data(), GL_STREAM_DRAW);
+        unsigned int noLight = 0;
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(unsigned int),
+                     indices.empty() ? &noLight : indices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void LightClusters::bindTextures(GLenum gridUnit, GLenum indexUnit) const
+    {
+        glActiveTexture(gridUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+        glActiveTexture(indexUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    }
+
+    void LightClusters::applyUniforms(const utils_loader::Shader &shader) const
+    {
+        glUniform4fv(shader.getUniformLocation(utils_loader::Uniform::ClusterParams), 1, glm::value_ptr(lookup));
+    }
+
+} // namespace utils_light
@@ -0,0 +1,71 @@
+// light_clusters.hpp
+#ifndef LIGHT_CLUSTERS_HPP
+#define LIGHT_CLUSTERS_HPP
+
+#include "lights.hpp"
+#include "shader.hpp"
+#include "utilities.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace utils_light
+{
+
+    // Froxel grid of the camera frustum: screen tiles times exponential depth slices, CLUSTER_* of the room shaders
+    const int CLUSTER_TILES_X = 16;
+    const int CLUSTER_TILES_Y = 9;
+    const int CLUSTER_SLICES = 24;
+    const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+    // Distance over which room 2 pulls and shrinks geometry towards a light, GRAVITY_RANGE of room2.vs.
+    // A light is listed in every cluster within its range or this distance, whichever is larger.
+    const float ROOM2_GRAVITY_RANGE = 3.5f;
+
+    // Per-cluster light lists of the additional lights, rebuilt on the CPU every frame and read by the
+    // room shaders through two texture buffers: (offset, count) per cluster, and the light indices.
+    // Lists are in ascending light order, like the per-object lists they are intersected with.
+    class LightClusters
+    {
+    public:
+        LightClusters();
+
+        // Function to allocate the texture buffers
+        void create();
+
+        // Function to delete the texture buffers
+        void release();
+
+        // Function to assign the first lightCount lights to the clusters they reach and upload the lists.
+        // Cluster bounds are rebuilt when the projection changes.
+        void build(const std::vector<SimplePointLight> &lights, int lightCount,
+                   const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+
+        // Function to bind the grid and the index list to two texture units
+        void bindTextures(GLenum gridUnit, GLenum indexUnit) const;
+
+        // Function to set the cluster lookup parameters of a program, call after build()
+        void applyUniforms(const utils_loader::Shader &shader) const;
+
+        // Light indices stored by the last build(), a light counts once per cluster it reaches
+        size_t indexCount() const { return indices.size(); }
+
+    private:
+        // Function to compute the view space bounds of every cluster from the projection
+        void computeBounds(const glm::mat4 &projMatrix);
+
+        GLuint gridBuffer, gridTexture;
+        GLuint indexBuffer, indexTexture;
+        glm::mat4 boundsProjection;
+        glm::vec4 lookup;                // x, y projection scales, z, w slice = log(depth) * z + w
+        float sliceDepths[CLUSTER_SLICES + 1];
+        std::vector<AABB> bounds;        // View space bounds of each cluster
+        std::vector<unsigned int> grid;  // (offset, count) of each cluster
+        std::vector<unsigned int> indices;
+        std::vector<unsigned int> counts;
+        std::vector<std::pair<int, int> > pairs; // (cluster, light) of the current build
+    };
+
+} // namespace utils_light
+
+#endif // LIGHT_CLUSTERS_HPP
@@ -0,0 +1,191 @@
+// light_registry.cpp
+#include "light_registry.hpp"
+#include <algorithm>
+
+namespace utils_light
+{
+
+    // Sparse entry of an index whose light was removed
+    static const std::uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+    // Generations wrap within the bits left above the index
+    static const std::uint32_t GENERATION_MASK = (1u << (32 - LIGHT_INDEX_BITS)) - 1u;
+
+    LightHandle LightRegistry::add(const glm::vec3 &position, const glm::vec3 &color, float intensity,
+                                   unsigned char lightFlags)
+    {
+        std::uint32_t index;
+        if (!freeIndices.empty())
+        {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else
+        {
+            index = static_cast<std::uint32_t>(sparse.size());
+            sparse.push_back(NO_SLOT);
+            generations.push_back(0);
+        }
+
+        LightHandle handle = (generations[index] << LIGHT_INDEX_BITS) | index;
+        sparse[index] = static_cast<std::uint32_t>(dense.size());
+
+        SimplePointLight light;
+        light.position = position;
+        light.color = color;
+        light.intensity = intensity;
+        light.radius = lightRange(intensity);
+        dense.push_back(light);
+        handles.push_back(handle);
+        flags.push_back(lightFlags);
+        rooms.push_back(static_cast<unsigned char>(roomSide(position.x)));
+        return handle;
+    }
+
+    bool LightRegistry::remove(LightHandle handle)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+
+        // Move the last light into the freed slot
+        std::uint32_t index = handle & LIGHT_INDEX_MASK;
+        size_t slot = sparse[index];
+        size_t last = dense.size() - 1;
+        if (slot != last)
+        {
+            dense[slot] = dense[last];
+            handles[slot] = handles[last];
+            flags[slot] = flags[last];
+            rooms[slot] = rooms[last];
+            sparse[handles[slot] & LIGHT_INDEX_MASK] = static_cast<std::uint32_t>(slot);
+        }
+        dense.pop_back();
+        handles.pop_back();
+        flags.pop_back();
+        rooms.pop_back();
+
+        sparse[index] = NO_SLOT;
+        generations[index] = (generations[index] + 1) & GENERATION_MASK;
+        freeIndices.push_back(index);
+        return true;
+    }
+
+    bool LightRegistry::contains(LightHandle handle) const
+    {
+        std::uint32_t index = handle & LIGHT_INDEX_MASK;
+        return handle != INVALID_LIGHT_HANDLE && index < sparse.size() && sparse[index] != NO_SLOT &&
+               (handle >> LIGHT_INDEX_BITS) == generations[index];
+    }
+
+    bool LightRegistry::setPosition(LightHandle handle, const glm::vec3 &position)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+        size_t slot = slotOf(handle);
+        dense[slot].position = position;
+        rooms[slot] = static_cast<unsigned char>(roomSide(position.x));
+        return true;
+    }
+
+    bool LightRegistry::setColor(LightHandle handle, const glm::vec3 &color)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+        dense[slotOf(handle)].color = color;
+        return true;
+    }
+
+    bool LightRegistry::setIntensity(LightHandle handle, float intensity)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+        SimplePointLight &light = dense[slotOf(handle)];
+        light.intensity = intensity;
+        light.radius = lightRange(intensity);
+        return true;
+    }
+
+    bool LightRegistry::setFlags(LightHandle handle, unsigned char lightFlags)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+        flags[slotOf(handle)] = lightFlags;
+        return true;
+    }
+
+    void LightRegistry::reserve(size_t count)
+    {
+        dense.reserve(count);
+        handles.reserve(count);
+        flags.reserve(count);
+        rooms.reserve(count);
+        sparse.reserve(count);
+        generations.reserve(count);
+        freeIndices.reserve(count);
+    }
+
+    void LightRegistry::clear()
+    {
+        // Every live handle goes stale, the indices are recycled with their next generation
+        for (size_t slot = 0; slot < handles.size(); ++slot)
+        {
+            std::uint32_t index = handles[slot] & LIGHT_INDEX_MASK;
+            sparse[index] = NO_SLOT;
+            generations[index] = (generations[index] + 1) & GENERATION_MASK;
+            freeIndices.push_back(index);
+        }
+        dense.clear();
+        handles.clear();
+        flags.clear();
+        rooms.clear();
+    }
+
+    void initDynamicLights(utils_animation::LightCycleBatch &cycles, size_t count)
+    {
+        // Constants for dynamic behavior
+        const float HEIGHT_AMPLITUDE = 0.004f;      // Max vertical displacement
+        const float COLOR_VARIATION_SPEED = 2.5f;   // Speed of color variation
+        cycles.baseColor = glm::vec3(1.0f, 0.8f, 0.6f); // Base light color
+        cycles.channelPhase = glm::vec3(0.0f, 2.0f, 4.0f); // Offset phase of green by 2, blue by 4
+        cycles.minIntensity = 0.2f;
+        cycles.maxIntensity = 0.8f;
+
+        cycles.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            cycles.add(i * 0.5f, 0.5f, HEIGHT_AMPLITUDE, i * COLOR_VARIATION_SPEED, 1.0f);
+        }
+    }
+
+    void updateDynamicLights(LightRegistry &registry, const std::vector<LightHandle> &handles,
+                             utils_animation::LightCycleBatch &cycles, float currentFrame)
+    {
+        utils_animation::animateLightCycles(cycles, currentFrame);
+
+        // The displacement is added every update, the lights only move vertically so they keep their room
+        size_t count = std::min(handles.size(), cycles.size());
+        for (size_t i = 0; i < count; ++i)
+        {
+            SimplePointLight *light = registry.get(handles[i]);
+            if (light == nullptr)
+            {
+                continue;
+            }
+            light->position.y += cycles.offsetY[i];
+            light->color = glm::vec3(cycles.r[i], cycles.g[i], cycles.b[i]);
+            light->intensity = cycles.intensity[i];
+            light->radius = lightRange(cycles.intensity[i]);
+        }
+    }
+
+} // namespace utils_light
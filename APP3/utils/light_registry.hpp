@@ -0,0 +1,100 @@
+// light_registry.hpp
+#ifndef LIGHT_REGISTRY_HPP
+#define LIGHT_REGISTRY_HPP
+
+#include "lights.hpp"
+#include "animation.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace utils_light
+{
+
+    // Stable handle of a light inside a LightRegistry: a sparse index in the low bits and the generation of
+    // that index in the high bits, so the handle of a removed light never resolves to the light reusing its index
+    typedef std::uint32_t LightHandle;
+    const LightHandle INVALID_LIGHT_HANDLE = 0xFFFFFFFFu;
+    const int LIGHT_INDEX_BITS = 20;
+    const std::uint32_t LIGHT_INDEX_MASK = (1u << LIGHT_INDEX_BITS) - 1u;
+
+    // Per-light flags
+    enum LightFlag : unsigned char
+    {
+        LIGHT_GIZMO = 1 << 0,   // Drawn as a small sphere at its position
+        LIGHT_SHADOWED = 1 << 1 // May hold a shadow atlas slot
+    };
+    const unsigned char DEFAULT_LIGHT_FLAGS = LIGHT_GIZMO | LIGHT_SHADOWED;
+
+    // Sparse-set light storage: lights are packed in a dense array in upload order, handles go through a sparse
+    // index array, so lookup, insertion and removal are O(1). Removal moves the last light into the freed slot,
+    // slots are only valid until the next removal, handles stay valid until their light is removed.
+    class LightRegistry
+    {
+    public:
+        // Function to add a light and return its handle
+        LightHandle add(const glm::vec3 &position, const glm::vec3 &color, float intensity,
+                        unsigned char flags = DEFAULT_LIGHT_FLAGS);
+
+        // Function to remove a light, returns false if the handle is stale
+        bool remove(LightHandle handle);
+
+        bool contains(LightHandle handle) const;
+
+        // Functions to change a light through its handle, keeping its radius and room in sync.
+        // They return false and leave every light untouched if the handle is stale.
+        bool setPosition(LightHandle handle, const glm::vec3 &position);
+        bool setColor(LightHandle handle, const glm::vec3 &color);
+        bool setIntensity(LightHandle handle, float intensity);
+        bool setFlags(LightHandle handle, unsigned char flags);
+
+        // Direct access to a light, nullptr if the handle is stale.
+        // Position changes that may cross the room boundary must go through setPosition
+        SimplePointLight *get(LightHandle handle) { return contains(handle) ? &dense[slotOf(handle)] : nullptr; }
+        const SimplePointLight *get(LightHandle handle) const { return contains(handle) ? &dense[slotOf(handle)] : nullptr; }
+
+        // Function to reserve room for a number of lights, so spawning them later does not reallocate
+        void reserve(size_t count);
+
+        size_t size() const { return dense.size(); }
+        bool empty() const { return dense.empty(); }
+        void clear();
+
+        size_t slotOf(LightHandle handle) const { return sparse[handle & LIGHT_INDEX_MASK]; }
+        LightHandle handleAt(size_t slot) const { return handles[slot]; }
+
+        // Packed lights, indexed by slot, in the order they are uploaded to the shaders
+        const std::vector<SimplePointLight> &lights() const { return dense; }
+
+        unsigned char flagsAt(size_t slot) const { return flags[slot]; }
+
+        // Side of the room boundary of a light, see roomSide
+        int roomAt(size_t slot) const { return rooms[slot]; }
+
+    private:
+        // Dense columns, indexed by slot
+        std::vector<SimplePointLight> dense;
+        std::vector<LightHandle> handles;
+        std::vector<unsigned char> flags;
+        std::vector<unsigned char> rooms;
+
+        // Sparse columns, indexed by the index part of a handle
+        std::vector<std::uint32_t> sparse;
+        std::vector<std::uint32_t> generations;
+        std::vector<std::uint32_t> freeIndices;
+    };
+
+    // ---------------------------
+    // Light animation
+    // ---------------------------
+
+    // Function to fill a batch with the bobbing and color cycling of count lights, entry i animating the i-th light
+    void initDynamicLights(utils_animation::LightCycleBatch &cycles, size_t count);
+
+    // Function to run the batch at a time and apply entry i to the light of handles[i], stale handles are skipped
+    void updateDynamicLights(LightRegistry &registry, const std::vector<LightHandle> &handles,
+                             utils_animation::LightCycleBatch &cycles, float currentFrame);
+
+} // namespace utils_light
+
+#endif // LIGHT_REGISTRY_HPP
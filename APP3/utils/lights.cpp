@@ -1,135 +1,111 @@
 #include "lights.hpp"
+#include "global.hpp"
+#include <algorithm>
+#include <cmath>
 
 namespace utils_light
 {
 
-    // A simple static function-scope variable to auto-increment IDs
-    // Each call returns a new unique integer ID
-    int generateLightID()
-    {
-        static int s_nextLightID = 0;
-        return s_nextLightID++;
-    }
-
-    // Adds a new light to the container
-    // Returns the newly generated light ID
-    int addLight(std::vector<SimplePointLight> &lights,
-                 const glm::vec3 &position,
-                 const glm::vec3 &color,
-                 float intensity)
+    // Simple hash function for pseudo-random generation
+    float pseudoRandom(float seed)
     {
-        SimplePointLight light;
-        light.id = generateLightID();
-        light.position = position;
-        light.color = color;
-        light.intensity = intensity;
-
-        lights.push_back(light);
-        return light.id; // Return the assigned ID
+        return glm::fract(sin(seed) * 43758.5453f);
     }
 
-    // Removes a light from the container by ID
-    // Returns true if found and removed, false otherwise
-    bool removeLight(std::vector<SimplePointLight> &lights, int lightID)
-    {
-        for (auto it = lights.begin(); it != lights.end(); ++it)
-        {
-            if (it->id == lightID)
-            {
-                lights.erase(it);
-                return true;
-            }
-        }
-        return false; // Not found
-    }
+    // Contribution below which a light is considered out of reach, and the clamp keeping ranges
+    // (and the shadow atlas tiles covering them) bounded
+    static const float LIGHT_RANGE_THRESHOLD = 0.05f;
+    static const float MIN_LIGHT_RANGE = 1.0f;
+    static const float MAX_LIGHT_RANGE = 20.0f;
 
-    // Update a light's position by ID
-    void updateLightPosition(std::vector<SimplePointLight> &lights, int lightID, const glm::vec3 &newPosition)
+    float lightRange(float intensity)
     {
-        for (auto &light : lights)
+        // Solve intensity / (1 + 0.06 d + 0.052 d^2) = threshold
+        float a = 0.052f, b = 0.06f, c = 1.0f - intensity / LIGHT_RANGE_THRESHOLD;
+        if (c >= 0.0f)
         {
-            if (light.id == lightID)
-            {
-                light.position = newPosition;
-                break;
-            }
+            return MIN_LIGHT_RANGE;
         }
+        float range = (-b + std::sqrt(b * b - 4.0f * a * c)) / (2.0f * a);
+        return glm::clamp(range, MIN_LIGHT_RANGE, MAX_LIGHT_RANGE);
     }
 
-    // Update a light’s color by ID
-    void updateLightColor(std::vector<SimplePointLight> &lights, int lightID, const glm::vec3 &newColor)
+    int roomSide(float x)
     {
-        for (auto &light : lights)
+        if (x < ROOM_BOUNDARY_X)
         {
-            if (light.id == lightID)
-            {
-                light.color = newColor;
-                break;
-            }
+            return 1;
         }
-    }
-
-    // Update a light’s intensity by ID
-    void updateLightIntensity(std::vector<SimplePointLight> &lights, int lightID, float newIntensity)
-    {
-        for (auto &light : lights)
+        if (x > ROOM_BOUNDARY_X)
         {
-            if (light.id == lightID)
-            {
-                light.intensity = newIntensity;
-                break;
-            }
+            return 2;
         }
+        return 0;
     }
 
-    // Simple hash function for pseudo-random generation
-    float pseudoRandom(float seed)
+    // Contribution of a light at a distance, the additional light attenuation of the room shaders
+    static float lightContribution(const SimplePointLight& light, float distance)
     {
-        return glm::fract(sin(seed) * 43758.5453f);
+        return light.intensity / (1.0f + 0.06f * distance + 0.052f * distance * distance);
     }
 
-    // Update all lights dynamically
-    void updateDynamicLights(std::vector<SimplePointLight*> &lights, float currentFrame)
+    void buildObjectLightLists(const std::vector<SimplePointLight>& lights, int lightCount,
+                               const glm::vec3& mainLightPos, const utils_scene::SceneStore& store,
+                               ObjectLightLists& lists, const std::vector<unsigned char>* visible)
     {
-        // Constants for dynamic behavior
-        const float HEIGHT_AMPLITUDE = 0.004f;          // Max vertical displacement
-        const float COLOR_VARIATION_SPEED = 2.5f;       // Speed of color variation
-        const glm::vec3 BASE_COLOR = glm::vec3(1.0f, 0.8f, 0.6f); // Base light color
-
-        // std::cout << "Debug: Number of lights in updateDynamicLights: " << lights.size() << "\n";
-        // for (size_t i = 0; i < lights.size(); ++i) {
-        //     if (!lights[i]) {
-        //         std::cout << "Light[" << i << "] is null!\n";
-        //     } else {
-        //         std::cout << "Light[" << i << "] Initial Position: (" << lights[i]->position.x << ", "
-        //                 << lights[i]->position.y << ", " << lights[i]->position.z << ")\n";
-        //     }
-        // }
-
+        size_t objectCount = store.size();
+        lists.offsets.resize(objectCount + 1);
+        lists.receivesMainLight.assign(objectCount, 0);
+        lists.lights.clear();
 
-        // Update each light dynamically
-        for (size_t i = 0; i < lights.size(); i++) {
-            auto light = lights[i];
+        // Objects and lights exactly on the boundary are on no side, nothing reaches them
+        int mainSide = roomSide(mainLightPos.x);
 
-            // **Dynamic Vertical Movement**
-            float verticalOffset = sin(currentFrame * 0.5f + i * 0.5f) * HEIGHT_AMPLITUDE;
-            light->position.y += verticalOffset; // Adjust Y-position dynamically
+        std::vector<std::pair<float, int> > candidates;
+        for (size_t id = 0; id < objectCount; ++id)
+        {
+            size_t slot = store.slotOf(static_cast<utils_scene::ObjectId>(id));
+            const AABB& bounds = store.bounds[slot];
+            int side = roomSide(store.transforms[slot].position.x);
 
-            // **Dynamic Color Variation**
-            float colorFactorR = (sin(currentFrame + i * COLOR_VARIATION_SPEED) + 1.0f) / 2.0f;
-            float colorFactorG = (sin(currentFrame + i * COLOR_VARIATION_SPEED + 2.0f) + 1.0f) / 2.0f; // Offset phase by 2
-            float colorFactorB = (sin(currentFrame + i * COLOR_VARIATION_SPEED + 4.0f) + 1.0f) / 2.0f; // Offset phase by 4
+            lists.offsets[id] = static_cast<unsigned int>(lists.lights.size());
+            if (side == 0 || (visible != nullptr && !(*visible)[slot]))
+            {
+                continue;
+            }
+            lists.receivesMainLight[id] = (side == mainSide) ? 1 : 0;
 
-            light->color = glm::vec3(BASE_COLOR.r * colorFactorR,
-                                    BASE_COLOR.g * colorFactorG,
-                                    BASE_COLOR.b * colorFactorB);
+            // Lights whose sphere overlaps the bounds, ranked by their contribution at the closest point
+            candidates.clear();
+            for (int i = 0; i < lightCount; ++i)
+            {
+                if (roomSide(lights[i].position.x) != side)
+                {
+                    continue;
+                }
+                glm::vec3 closest = glm::clamp(lights[i].position, bounds.min, bounds.max);
+                float distance = glm::length(closest - lights[i].position);
+                if (distance <= lights[i].radius)
+                {
+                    candidates.push_back(std::make_pair(lightContribution(lights[i], distance), i));
+                }
+            }
+            if (static_cast<int>(candidates.size()) > MAX_OBJECT_LIGHTS)
+            {
+                std::nth_element(candidates.begin(), candidates.begin() + MAX_OBJECT_LIGHTS, candidates.end(),
+                                 [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+                candidates.resize(MAX_OBJECT_LIGHTS);
+            }
 
-            // **Dynamic Intensity Variation**
-            float intensityFactor = (sin(currentFrame + i * COLOR_VARIATION_SPEED) + 1.0f) / 2.0f;
-            // Clamp the intensity factor to be between 0.2 and 0.8
-            intensityFactor = glm::clamp(intensityFactor, 0.2f, 0.8f);
-            light->intensity = intensityFactor;
+            // The shaders walk the list alongside other ascending lists
+            size_t first = lists.lights.size();
+            for (size_t c = 0; c < candidates.size(); ++c)
+            {
+                lists.lights.push_back(candidates[c].second);
+            }
+            std::sort(lists.lights.begin() + first, lists.lights.end());
         }
+        lists.offsets[objectCount] = static_cast<unsigned int>(lists.lights.size());
     }
 
 } // namespace utils_light
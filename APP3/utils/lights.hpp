@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include "pointer.hpp"
+#include "scene_store.hpp"
 
 namespace utils_light {
 
@@ -13,41 +14,48 @@ namespace utils_light {
     // Struct for a simple point light
     // ---------------------------
     struct SimplePointLight {
-        int id;              // Unique identifier (e.g., auto-incrementing)
         glm::vec3 position;  // Position in world space
         glm::vec3 color;     // Color (could be considered 'diffuse' color)
         float intensity;     // Brightness multiplier
+        float radius;        // Influence radius, lightRange(intensity), kept in sync by LightRegistry
     };
 
     // ---------------------------
-    // Light management functions
+    // Light helper functions (lights are stored and animated in a LightRegistry, see light_registry.hpp)
     // ---------------------------
-    
-    // Generates a unique ID for a light
-    int generateLightID();
 
-    // Adds a new light to the container, returns assigned ID
-    int addLight(std::vector<SimplePointLight>& lights, 
-                 const glm::vec3& position, 
-                 const glm::vec3& color, 
-                 float intensity);
+    // Generates a pseudo-random value based on a seed
+    float pseudoRandom(float seed);
 
-    // Removes an existing light by ID, returns true on success
-    bool removeLight(std::vector<SimplePointLight>& lights, int lightID);
+    // Distance at which a light of this intensity falls below a visible contribution, following the
+    // additional light attenuation of the room shaders; lights contribute nothing past it
+    float lightRange(float intensity);
+
+    // ---------------------------
+    // Per-object light lists
+    // ---------------------------
 
-    // Moves a light’s position
-    void updateLightPosition(std::vector<SimplePointLight>& lights, int lightID, const glm::vec3& newPosition);
+    // Size of the uObjectLights array of the room shaders
+    const int MAX_OBJECT_LIGHTS = 32;
 
-    // Changes a light’s color
-    void updateLightColor(std::vector<SimplePointLight>& lights, int lightID, const glm::vec3& newColor);
+    // Lights reaching each object of a store, indexed by ObjectId so they survive the store being reordered
+    struct ObjectLightLists {
+        std::vector<unsigned int> offsets;            // Start of each object's list, one extra entry ends the last one
+        std::vector<int> lights;                      // Every list back to back, each in ascending light order
+        std::vector<unsigned char> receivesMainLight;
+    };
 
-    // Changes a light’s intensity
-    void updateLightIntensity(std::vector<SimplePointLight>& lights, int lightID, float newIntensity);
+    // Side of the room boundary of a world x coordinate: 1 for room 1, 2 for room 2, 0 exactly on it
+    int roomSide(float x);
 
-    // Generates a pseudo-random value based on a seed
-    float pseudoRandom(float seed);
+    // Rebuilds the lists of a store from the first lightCount lights. A light reaches an object when its
+    // influence sphere overlaps the object's world bounds; the wall between the rooms still blocks it.
+    // Objects reached by more than MAX_OBJECT_LIGHTS lights keep the strongest ones, objects whose visible flag
+    // (per slot, when given) is cleared get an empty list.
+    void buildObjectLightLists(const std::vector<SimplePointLight>& lights, int lightCount,
+                               const glm::vec3& mainLightPos, const utils_scene::SceneStore& store,
+                               ObjectLightLists& lists, const std::vector<unsigned char>* visible = nullptr);
 
-    // void update simple light pso and colors
-    void updateDynamicLights(std::vector<SimplePointLight*> &lights, float currentFrame);} // namespace utils_light
+} // namespace utils_light
 
 #endif // LIGHTS_HPP
@@ -1184,3 +1184,41 @@ void setupSceneObjects(GLuint sphereVAO, GLuint sphereVertexCount, GLuint cubeVA
 
 
 }
+
+void setupRoomCells(utils_scene::CellGraph &cells, const utils_loader::Shader *room1Program, const utils_loader::Shader *room2Program) {
+
+    // Outer faces of the walls and floor built above (cubes are centered on their grid positions)
+    const float minX = -1.5f, maxX = 42.5f;
+    const float minZ = -1.5f, maxZ = 24.5f;
+    const float floorBottom = -0.5f;
+    const float wallTop = 3.5f;
+
+    // Doorway left between the separation walls Z3 and Z4
+    const float doorMinZ = 9.5f, doorMaxZ = 13.5f;
+    const float doorBottom = 0.5f;
+
+    // Rooms split at the middle of the separation wall, the sky covers everything above the walls
+    int room1Cell = cells.addCell("room1", AABB(glm::vec3(minX, floorBottom, minZ), glm::vec3(ROOM_BOUNDARY_X, wallTop, maxZ)), room1Program);
+    int room2Cell = cells.addCell("room2", AABB(glm::vec3(ROOM_BOUNDARY_X, floorBottom, minZ), glm::vec3(maxX, wallTop, maxZ)), room2Program);
+    int skyCell = cells.addCell("sky", AABB(glm::vec3(-1000.0f, wallTop, -1000.0f), glm::vec3(1000.0f)), nullptr);
+
+    cells.addPortal(room1Cell, room2Cell, {
+        glm::vec3(ROOM_BOUNDARY_X, doorBottom, doorMinZ),
+        glm::vec3(ROOM_BOUNDARY_X, doorBottom, doorMaxZ),
+        glm::vec3(ROOM_BOUNDARY_X, wallTop, doorMaxZ),
+        glm::vec3(ROOM_BOUNDARY_X, wallTop, doorMinZ)});
+
+    // The rooms have no ceiling
+    cells.addPortal(room1Cell, skyCell, {
+        glm::vec3(minX, wallTop, minZ),
+        glm::vec3(ROOM_BOUNDARY_X, wallTop, minZ),
+        glm::vec3(ROOM_BOUNDARY_X, wallTop, maxZ),
+        glm::vec3(minX, wallTop, maxZ)});
+    cells.addPortal(room2Cell, skyCell, {
+        glm::vec3(ROOM_BOUNDARY_X, wallTop, minZ),
+        glm::vec3(maxX, wallTop, minZ),
+        glm::vec3(maxX, wallTop, maxZ),
+        glm::vec3(ROOM_BOUNDARY_X, wallTop, maxZ)});
+
+    std::cout << "Room cells: " << cells.cellCount() << " cells" << std::endl;
+}
@@ -4,7 +4,11 @@
 #include "material_setup.hpp"
 #include "scene_object.hpp"
 #include "material_manager.hpp"
+#include "portal_visibility.hpp"
 
 void setupSceneObjects(GLuint sphereVAO, GLuint sphereVertexCount, GLuint cubeVAO, GLuint cubeIndexCount);
 
+// Function to describe the two rooms, the open space above them and the openings between them as cells and portals
+void setupRoomCells(utils_scene::CellGraph &cells, const utils_loader::Shader *room1Program, const utils_loader::Shader *room2Program);
+
 #endif // SCENE_OBJECTS_HPP
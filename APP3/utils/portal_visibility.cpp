@@ -0,0 +1,263 @@
+// portal_visibility.cpp
+#include "portal_visibility.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <limits>
+
+namespace utils_scene
+{
+
+    // Distance to a portal plane under which the camera is treated as standing in the portal
+    static const float PORTAL_NEAR_MARGIN = 0.5f;
+
+    // Function to test whether two boxes overlap
+    static bool overlaps(const AABB &a, const AABB &b)
+    {
+        return a.min.x < b.max.x && a.max.x > b.min.x &&
+               a.min.y < b.max.y && a.max.y > b.min.y &&
+               a.min.z < b.max.z && a.max.z > b.min.z;
+    }
+
+    int CellGraph::addCell(const std::string &name, const AABB &bounds, const utils_loader::Shader *program)
+    {
+        Cell cell;
+        cell.name = name;
+        cell.bounds = bounds;
+        cell.program = program;
+        cells.push_back(cell);
+        return static_cast<int>(cells.size()) - 1;
+    }
+
+    int CellGraph::addPortal(int cellA, int cellB, const std::vector<glm::vec3> &polygon)
+    {
+        if (polygon.size() < 3)
+        {
+            std::cerr << "Portal between " << cells[cellA].name << " and " << cells[cellB].name
+                      << " needs at least 3 vertices" << std::endl;
+            return -1;
+        }
+
+        Portal portal;
+        portal.cells[0] = cellA;
+        portal.cells[1] = cellB;
+        portal.polygon = polygon;
+        portal.normal = glm::normalize(glm::cross(polygon[1] - polygon[0], polygon[2] - polygon[0]));
+        portal.offset = glm::dot(portal.normal, polygon[0]);
+        portal.bounds = AABB(polygon[0], polygon[0]);
+        for (const auto &vertex : polygon)
+        {
+            portal.bounds.min = glm::min(portal.bounds.min, vertex);
+            portal.bounds.max = glm::max(portal.bounds.max, vertex);
+        }
+        portals.push_back(portal);
+
+        int index = static_cast<int>(portals.size()) - 1;
+        cells[cellA].portals.push_back(index);
+        cells[cellB].portals.push_back(index);
+        return index;
+    }
+
+    int CellGraph::cellAt(const glm::vec3 &position) const
+    {
+        for (size_t c = 0; c < cells.size(); ++c)
+        {
+            const AABB &bounds = cells[c].bounds;
+            if (glm::all(glm::greaterThanEqual(position, bounds.min)) && glm::all(glm::lessThanEqual(position, bounds.max)))
+            {
+                return static_cast<int>(c);
+            }
+        }
+        return -1;
+    }
+
+    void CellGraph::computeVisibility(const glm::vec3 &cameraPos, const glm::mat4 &viewProjection)
+    {
+        cameraFrustum = extractFrustum(viewProjection);
+        cellVisible.assign(cells.size(), 0);
+        cellRects.resize(cells.size());
+        cellFrusta.resize(cells.size());
+        onPath.assign(cells.size(), 0);
+
+        camera = cellAt(cameraPos);
+        if (camera < 0)
+        {
+            return;
+        }
+
+        ScreenRect fullScreen;
+        fullScreen.min = glm::vec2(-1.0f);
+        fullScreen.max = glm::vec2(1.0f);
+        visit(camera, fullScreen, cameraPos, viewProjection);
+
+        // Frustum of each visible cell: the camera frustum with its sides moved in to the cell's rectangle
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+        for (size_t c = 0; c < cells.size(); ++c)
+        {
+            if (!cellVisible[c])
+            {
+                continue;
+            }
+            const ScreenRect &rect = cellRects[c];
+            Frustum &frustum = cellFrusta[c];
+            frustum.planes[0] = rows[0] - rect.min.x * rows[3]; // Left
+            frustum.planes[1] = rect.max.x * rows[3] - rows[0]; // Right
+            frustum.planes[2] = rows[1] - rect.min.y * rows[3]; // Bottom
+            frustum.planes[3] = rect.max.y * rows[3] - rows[1]; // Top
+            frustum.planes[4] = cameraFrustum.planes[4];
+            frustum.planes[5] = cameraFrustum.planes[5];
+            for (int p = 0; p < 4; ++p)
+            {
+                frustum.planes[p] /= glm::length(glm::vec3(frustum.planes[p]));
+            }
+        }
+    }
+
+    void CellGraph::visit(int cellIndex, const ScreenRect &rect, const glm::vec3 &cameraPos, const glm::mat4 &viewProjection)
+    {
+        // A cell reached through several portals is seen through all of their rectangles
+        if (cellVisible[cellIndex])
+        {
+            cellRects[cellIndex].min = glm::min(cellRects[cellIndex].min, rect.min);
+            cellRects[cellIndex].max = glm::max(cellRects[cellIndex].max, rect.max);
+        }
+        else
+        {
+            cellVisible[cellIndex] = 1;
+            cellRects[cellIndex] = rect;
+        }
+
+        onPath[cellIndex] = 1;
+        const Cell &cell = cells[cellIndex];
+        glm::vec3 cellCenter = (cell.bounds.min + cell.bounds.max) * 0.5f;
+        for (int portalIndex : cell.portals)
+        {
+            const Portal &portal = portals[portalIndex];
+            int next = portal.cells[0] == cellIndex ? portal.cells[1] : portal.cells[0];
+            if (onPath[next])
+            {
+                continue;
+            }
+
+            // Portals are one-sided: the camera must be on this cell's side of the plane to look through
+            float cellSide = glm::dot(portal.normal, cellCenter) - portal.offset;
+            float cameraSide = glm::dot(portal.normal, cameraPos) - portal.offset;
+            bool standingIn = std::abs(cameraSide) < PORTAL_NEAR_MARGIN &&
+                              glm::all(glm::greaterThanEqual(cameraPos, portal.bounds.min - glm::vec3(PORTAL_NEAR_MARGIN))) &&
+                              glm::all(glm::lessThanEqual(cameraPos, portal.bounds.max + glm::vec3(PORTAL_NEAR_MARGIN)));
+            if (!standingIn && cameraSide * cellSide <= 0.0f)
+            {
+                continue;
+            }
+
+            // Standing in the portal, its projection degenerates, the next cell is seen through the whole rectangle
+            ScreenRect portalRect = rect;
+            if (!standingIn)
+            {
+                // Clip the polygon against the near plane (z >= -w) in clip space, then bound its projection
+                std::vector<glm::vec4> clip;
+                clip.reserve(portal.polygon.size());
+                for (const auto &vertex : portal.polygon)
+                {
+                    clip.push_back(viewProjection * glm::vec4(vertex, 1.0f));
+                }
+                std::vector<glm::vec4> clipped;
+                for (size_t v = 0; v < clip.size(); ++v)
+                {
+                    const glm::vec4 &a = clip[v];
+                    const glm::vec4 &b = clip[(v + 1) % clip.size()];
+                    float da = a.z + a.w;
+                    float db = b.z + b.w;
+                    if (da >= 0.0f)
+                    {
+                        clipped.push_back(a);
+                    }
+                    if ((da >= 0.0f) != (db >= 0.0f))
+                    {
+                        clipped.push_back(a + (b - a) * (da / (da - db)));
+                    }
+                }
+
+                if (clipped.empty())
+                {
+                    continue;
+                }
+
+                ScreenRect projected;
+                projected.min = glm::vec2(std::numeric_limits<float>::max());
+                projected.max = glm::vec2(-std::numeric_limits<float>::max());
+                for (const auto &vertex : clipped)
+                {
+                    glm::vec2 ndc = glm::vec2(vertex) / std::max(vertex.w, 1e-6f);
+                    projected.min = glm::min(projected.min, ndc);
+                    projected.max = glm::max(projected.max, ndc);
+                }
+
+                portalRect.min = glm::max(rect.min, projected.min);
+                portalRect.max = glm::min(rect.max, projected.max);
+                if (portalRect.min.x >= portalRect.max.x || portalRect.min.y >= portalRect.max.y)
+                {
+                    continue;
+                }
+            }
+
+            visit(next, portalRect, cameraPos, viewProjection);
+        }
+        onPath[cellIndex] = 0;
+    }
+
+    bool CellGraph::isVisible(const AABB &box) const
+    {
+        if (camera < 0)
+        {
+            return intersectsFrustum(cameraFrustum, box);
+        }
+
+        bool inAnyCell = false;
+        for (size_t c = 0; c < cells.size(); ++c)
+        {
+            if (!overlaps(cells[c].bounds, box))
+            {
+                continue;
+            }
+            inAnyCell = true;
+            if (cellVisible[c] && intersectsFrustum(cellFrusta[c], box))
+            {
+                return true;
+            }
+        }
+        return !inAnyCell && intersectsFrustum(cameraFrustum, box);
+    }
+
+    void CellGraph::cullStore(const SceneStore &store, std::vector<unsigned char> &visible) const
+    {
+        for (size_t slot = 0; slot < store.size() && slot < visible.size(); ++slot)
+        {
+            if (visible[slot] && !isVisible(store.bounds[slot]))
+            {
+                visible[slot] = 0;
+            }
+        }
+    }
+
+    const utils_loader::Shader *CellGraph::programFor(const AABB &box) const
+    {
+        const utils_loader::Shader *cameraProgram = camera >= 0 ? cells[camera].program : nullptr;
+        int cell = cellAt((box.min + box.max) * 0.5f);
+        if (cell >= 0 && cells[cell].program != nullptr)
+        {
+            return cells[cell].program;
+        }
+        return cameraProgram;
+    }
+
+    size_t CellGraph::visibleCellCount() const
+    {
+        return static_cast<size_t>(std::count(cellVisible.begin(), cellVisible.end(), 1));
+    }
+
+} // namespace utils_scene
@@ -0,0 +1,88 @@
+// portal_visibility.hpp
+#ifndef PORTAL_VISIBILITY_HPP
+#define PORTAL_VISIBILITY_HPP
+
+#include "bvh.hpp"
+#include "shader.hpp"
+#include "scene_store.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace utils_scene
+{
+
+    // Convex region of the scene, only seen from the other cells through its portals
+    struct Cell
+    {
+        std::string name;
+        AABB bounds;
+        const utils_loader::Shader *program; // Program shading the cell's objects, nullptr for the camera cell's one
+        std::vector<int> portals;
+    };
+
+    // Convex planar opening between two cells
+    struct Portal
+    {
+        int cells[2];
+        std::vector<glm::vec3> polygon;
+        glm::vec3 normal;
+        float offset; // Plane: dot(normal, p) == offset
+        AABB bounds;
+    };
+
+    // Cells linked by portals. Each frame, the cells seen from the camera cell are found by walking the portals and
+    // narrowing the screen rectangle every portal is seen through; objects and lights are then tested against the
+    // frustum of the rectangles their cell was reached through.
+    class CellGraph
+    {
+    public:
+        // Function to add a cell and return its index
+        int addCell(const std::string &name, const AABB &bounds, const utils_loader::Shader *program);
+
+        // Function to link two cells by a convex polygon and return the portal index
+        int addPortal(int cellA, int cellB, const std::vector<glm::vec3> &polygon);
+
+        // Function to find the cell containing a point, -1 if none does (the first cell added wins on shared faces)
+        int cellAt(const glm::vec3 &position) const;
+
+        // Function to find the visible cells and their frusta from a camera
+        void computeVisibility(const glm::vec3 &cameraPos, const glm::mat4 &viewProjection);
+
+        // Function to test whether a box may be seen through the visible cells it overlaps.
+        // Boxes outside every cell, or a camera outside every cell, fall back to the camera frustum.
+        bool isVisible(const AABB &box) const;
+
+        // Function to clear the flags, per slot, of the objects outside every visible cell
+        void cullStore(const SceneStore &store, std::vector<unsigned char> &visible) const;
+
+        // Function to pick the program of the cell holding the center of a box, or the camera cell's program
+        const utils_loader::Shader *programFor(const AABB &box) const;
+
+        int cameraCell() const { return camera; }
+        size_t cellCount() const { return cells.size(); }
+        size_t visibleCellCount() const;
+
+    private:
+        struct ScreenRect
+        {
+            glm::vec2 min, max;
+        };
+
+        void visit(int cellIndex, const ScreenRect &rect, const glm::vec3 &cameraPos, const glm::mat4 &viewProjection);
+
+        std::vector<Cell> cells;
+        std::vector<Portal> portals;
+
+        // Per-frame state
+        int camera = -1;
+        Frustum cameraFrustum;
+        std::vector<unsigned char> cellVisible;
+        std::vector<ScreenRect> cellRects; // Union of the rectangles each cell was reached through
+        std::vector<Frustum> cellFrusta;
+        std::vector<unsigned char> onPath;
+    };
+
+} // namespace utils_scene
+
+#endif // PORTAL_VISIBILITY_HPP
@@ -0,0 +1,119 @@
+// render_queue.cpp
+#include "render_queue.hpp"
+#include <algorithm>
+
+namespace utils_scene
+{
+
+    std::uint64_t makeSortKey(RenderPass pass, unsigned int shader, int materialIndex, GLuint vaoID, float depth)
+    {
+        // Quantize the normalized depth, front to back inside a state bucket
+        float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+        std::uint64_t depthBits = static_cast<std::uint64_t>(clampedDepth * 0xFFFFFF);
+
+        std::uint64_t key = 0;
+        key |= (static_cast<std::uint64_t>(pass) & 0xF) << 60;
+        key |= (static_cast<std::uint64_t>(shader) & 0xFF) << 52;
+        key |= (static_cast<std::uint64_t>(materialIndex) & 0xFFF) << 40;
+        key |= (static_cast<std::uint64_t>(vaoID) & 0xFFFF) << 24;
+        key |= depthBits & 0xFFFFFF;
+        return key;
+    }
+
+    void RenderQueue::push(std::uint64_t key, size_t slot)
+    {
+        DrawCommand command;
+        command.key = key;
+        command.slot = static_cast<std::uint32_t>(slot);
+        commands.push_back(command);
+    }
+
+    void RenderQueue::sort()
+    {
+        std::sort(commands.begin(), commands.end(),
+                  [](const DrawCommand &a, const DrawCommand &b)
+                  {
+                      return a.key < b.key;
+                  });
+    }
+
+    RenderStateCache::RenderStateCache()
+    {
+        invalidate();
+        beginFrame();
+    }
+
+    void RenderStateCache::beginFrame()
+    {
+        frameStats.draws = 0;
+        frameStats.materialChanges = 0;
+        frameStats.bindsIssued = 0;
+        frameStats.bindsAvoided = 0;
+    }
+
+    void RenderStateCache::invalidate()
+    {
+        boundVAO = 0;
+        for (GLuint unit = 0; unit < TEXTURE_UNITS; ++unit)
+        {
+            boundTextures[unit] = 0xFFFFFFFFu; // Unknown, the first bind is always issued
+        }
+        activeUnit = 0xFFFFFFFFu;
+        currentMaterial = -1;
+    }
+
+    bool RenderStateCache::bindTexture(GLuint unit, GLuint textureID)
+    {
+        if (unit < TEXTURE_UNITS && boundTextures[unit] == textureID)
+        {
+            frameStats.bindsAvoided++;
+            return false;
+        }
+        if (activeUnit != unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        if (unit < TEXTURE_UNITS)
+        {
+            boundTextures[unit] = textureID;
+        }
+        frameStats.bindsIssued++;
+        return true;
+    }
+
+    bool RenderStateCache::useMaterial(int materialIndex)
+    {
+        if (materialIndex == currentMaterial)
+        {
+            return false;
+        }
+        currentMaterial = materialIndex;
+        frameStats.materialChanges++;
+        return true;
+    }
+
+    void RenderStateCache::draw(const RenderItem &item)
+    {
+        if (item.vaoID != boundVAO)
+        {
+            glBindVertexArray(item.vaoID);
+            boundVAO = item.vaoID;
+            frameStats.bindsIssued++;
+        }
+        else
+        {
+            frameStats.bindsAvoided++;
+        }
+        frameStats.draws++;
+        issueDrawCall(item);
+    }
+
+    void RenderStateCache::endPass()
+    {
+        glBindVertexArray(0);
+        boundVAO = 0;
+    }
+
+} // namespace utils_scene
@@ -0,0 +1,96 @@
+// render_queue.hpp
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include "scene_store.hpp"
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+namespace utils_scene
+{
+
+    // Passes in submission order, the pass is the most significant part of a sort key
+    enum class RenderPass
+    {
+        Shadow = 0,
+        Opaque = 1,
+        Transparent = 2
+    };
+
+    // Function to build a 64-bit sort key, most to least significant:
+    // pass (4 bits) | shader (8) | material (12) | VAO (16) | depth (24, 0 = near)
+    std::uint64_t makeSortKey(RenderPass pass, unsigned int shader, int materialIndex, GLuint vaoID, float depth);
+
+    // One draw of a pass, slot indexes the SceneStore the queue was filled from
+    struct DrawCommand
+    {
+        std::uint64_t key;
+        std::uint32_t slot;
+    };
+
+    // Per-frame list of draws, sorted by key so that draws sharing state end up next to each other
+    class RenderQueue
+    {
+    public:
+        void clear() { commands.clear(); }
+        void push(std::uint64_t key, size_t slot);
+
+        // Function to sort the draws by key
+        void sort();
+
+        const std::vector<DrawCommand> &draws() const { return commands; }
+        size_t size() const { return commands.size(); }
+
+    private:
+        std::vector<DrawCommand> commands;
+    };
+
+    // Binds issued and skipped by a RenderStateCache since its last beginFrame()
+    struct RenderStateStats
+    {
+        unsigned int draws;
+        unsigned int materialChanges;
+        unsigned int bindsIssued;
+        unsigned int bindsAvoided;
+    };
+
+    // Shadow of the GL binding state, a bind is only issued when the bound object actually changes
+    class RenderStateCache
+    {
+    public:
+        RenderStateCache();
+
+        // Function to reset the statistics, call once per frame
+        void beginFrame();
+
+        // Function to forget the bound state, call when other code may have changed the bindings
+        void invalidate();
+
+        // Function to bind a texture on a unit (GL_TEXTURE_2D), returns false when it was already bound
+        bool bindTexture(GLuint unit, GLuint textureID);
+
+        // Function to switch material, returns true when the material uniforms must be set
+        bool useMaterial(int materialIndex);
+
+        // Function to draw an item, keeping its VAO bound for the next draw
+        void draw(const RenderItem &item);
+
+        // Function to unbind the VAO at the end of a pass
+        void endPass();
+
+        const RenderStateStats &stats() const { return frameStats; }
+
+    private:
+        static const GLuint TEXTURE_UNITS = 4;
+
+        GLuint boundVAO;
+        GLuint boundTextures[TEXTURE_UNITS];
+        GLuint activeUnit;
+        int currentMaterial;
+        RenderStateStats frameStats;
+    };
+
+} // namespace utils_scene
+
+#endif // RENDER_QUEUE_HPP
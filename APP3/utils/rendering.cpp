@@ -10,62 +10,70 @@ void dynamic_loop(float &deltaTime, float &lastFrame, float &currentFrame,
                   double frequency, double radius, double length,
                   float cameraHeight) {
 
-    // Update dynamic only objects before rendering
-    for (auto& object : utils_scene::sceneObjects) {
-        if (!object.isStatic) {
+    // Update dynamic only objects before rendering, found through the name index instead of a scan
+    utils_scene::SceneStore &objects = utils_scene::sceneObjects;
+    for (const auto &handle : utils_scene::findObjects("rocking_chair")) {
+        if (handle.store != utils_scene::StoreKind::Opaque) {
+            continue;
+        }
+        size_t i = objects.slotOf(handle.id);
+        if (!objects.isStatic[i]) {
             // we place here all objects that we want to move
-            if (object.name == "rocking_chair") {
-                double adjustedTime = currentFrame - rockingChairStartTime;
-                if (isRockingChairPaused) {
-                    adjustedTime = rockingChairPausedTime - rockingChairStartTime;
-                }
+            double adjustedTime = currentFrame - rockingChairStartTime;
+            if (isRockingChairPaused) {
+                adjustedTime = rockingChairPausedTime - rockingChairStartTime;
+            }
 
-                glm::vec3 offsetPosition;
-                glm::vec3 rotation;
-                float rotationAngleRadians;
-                utils_object::GetRockingChairPositionAndRotation(
-                    adjustedTime,
-                    frequency,
-                    radius,
-                    length,
-                    offsetPosition,
-                    rotation
-                );
+            glm::vec3 offsetPosition;
+            glm::vec3 rotation;
+            float rotationAngleRadians;
+            utils_object::GetRockingChairPositionAndRotation(
+                adjustedTime,
+                frequency,
+                radius,
+                length,
+                offsetPosition,
+                rotation
+            );
 
-                // Update position and rotation
-                object.position = object.initialPosition + offsetPosition;
+            // Update position and rotation
+            utils_scene::Transform &transform = objects.transforms[i];
+            transform.position = objects.initialPositions[i] + offsetPosition;
 
-                object.rotationAngle = rotation.z; // Rotation around Z-axis
-                object.rotationAxis = glm::vec3(1.0f, 0.0f, 0.0f); // Rotation around X-axis
-            }
-            // if (object.name == "") {
-                
-            // }
+            transform.rotationAngle = rotation.z; // Rotation around Z-axis
+            transform.rotationAxis = glm::vec3(1.0f, 0.0f, 0.0f); // Rotation around X-axis
+            objects.markDirty(i);
         }
     }
 
     // Update dynamic objects
-    for (auto& object : utils_scene::sceneObjectsSkybox) {
-        if (!object.isStatic) {
-            if (object.name == "sky") {
-                // Keep skybox centered on the camera
-                object.position = cameraPos;
-
-                // Increment the rotation angle based on speed and deltaTime
-                skyboxRotation.currentAngle += skyboxRotation.speedDegrees * deltaTime;
+    utils_scene::SceneStore &skyObjects = utils_scene::sceneObjectsSkybox;
+    for (const auto &handle : utils_scene::findObjects("sky")) {
+        if (handle.store != utils_scene::StoreKind::Skybox) {
+            continue;
+        }
+        size_t i = skyObjects.slotOf(handle.id);
+        if (!skyObjects.isStatic[i]) {
+            utils_scene::Transform &transform = skyObjects.transforms[i];
 
-                // Wrap the angle within [0, 360) degrees
-                if (skyboxRotation.currentAngle >= 360.0f) {
-                    skyboxRotation.currentAngle -= 360.0f;
-                }
+            // Keep skybox centered on the camera
+            transform.position = cameraPos;
 
-                // Apply the updated rotation angle to the object
-                object.rotationAngle = skyboxRotation.currentAngle;
-                object.rotationAxis = skyboxRotation.axis;
+            // Increment the rotation angle based on speed and deltaTime
+            skyboxRotation.currentAngle += skyboxRotation.speedDegrees * deltaTime;
 
-                // Debug output
-                // std::cout << "Skybox rotation angle: " << object.rotationAngle << " degrees" << std::endl;
+            // Wrap the angle within [0, 360) degrees
+            if (skyboxRotation.currentAngle >= 360.0f) {
+                skyboxRotation.currentAngle -= 360.0f;
             }
+
+            // Apply the updated rotation angle to the object
+            transform.rotationAngle = skyboxRotation.currentAngle;
+            transform.rotationAxis = skyboxRotation.axis;
+            skyObjects.markDirty(i);
+
+            // Debug output
+            // std::cout << "Skybox rotation angle: " << transform.rotationAngle << " degrees" << std::endl;
         }
     }
 }
@@ -255,11 +255,11 @@ void loadTextures(std::vector<utils_loader::TextureInfo>& textureList,
 }
 
 // Setup depth cube map
-void setupDepthCubeMap(GLuint& depthCubeMap, GLuint& shadowMapFBO, int resolution) {
+void setupDepthCubeMap(GLuint& depthCubeMap, GLuint& shadowMapFBO, int resolution, GLenum depthFormat) {
     glGenTextures(1, &depthCubeMap);
     glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
     for (unsigned int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, depthFormat, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -42,7 +42,7 @@ void loadTextures(GLuint& textureID, GLuint& stoneTextureID, GLuint& brownTerrac
 void loadTextures(std::vector<TextureInfo>& textureList, const glimac::FilePath& applicationPath, std::vector<GLuint>& selectedSkyboxTextures);
 
 // Function to set up a depth cube map
-void setupDepthCubeMap(GLuint& depthCubeMap, GLuint& shadowMapFBO, int resolution = 4096);
+void setupDepthCubeMap(GLuint& depthCubeMap, GLuint& shadowMapFBO, int resolution = 4096, GLenum depthFormat = GL_DEPTH_COMPONENT32F);
 
 } // namespace utils_loader
 
@@ -1,5 +1,9 @@
 // scene_object.cpp
 #include "scene_object.hpp"
+#include "cube.hpp"
+#include "animation.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <unordered_map>
 
 namespace utils_scene
 {
@@ -7,6 +11,20 @@ namespace utils_scene
     // **Define** the map for planet spiral parameters
     std::map<std::string, PlanetSpiralParams> planetSpiralParameters;
 
+    // Display planets rotated every frame, and whether they use the atmosphere rotation
+    struct DisplayPlanet {
+        ObjectHandle handle;
+        bool isAtmosphere;
+    };
+    static std::vector<DisplayPlanet> displayPlanets;
+
+    // Orbits of the planets, entry i moving the objects of planetOrbitHandles[i]
+    static utils_animation::OrbitBatch planetOrbits;
+    static std::vector<std::vector<ObjectHandle> > planetOrbitHandles;
+
+    // Name to handles index, filled as objects are added
+    static std::unordered_map<std::string, std::vector<ObjectHandle> > objectIndex;
+
     // Base Values
     const float BASE_EARTH_SPEED = 0.2f;  // Base speed for Earth revolution (arbitrary)
     const float MIN_DISTANCE = 2.0f;      // Minimum scaled distance (Mercury)
@@ -54,28 +72,50 @@ namespace utils_scene
             float scaledDistance = MIN_DISTANCE + (MAX_DISTANCE - MIN_DISTANCE) * distanceScale[planet];
             float scaledHeight = MIN_HEIGHT + (MAX_HEIGHT - MIN_HEIGHT) * distanceScale[planet];
 
-            planetSpiralParameters[planet] = {
-                scaledDistance,               // Scaled Radius
-                BASE_EARTH_SPEED * speed,     // Scaled Speed
-                scaledHeight                  // Scaled Height
-            };
+            PlanetSpiralParams &params = planetSpiralParameters[planet];
+            params.spiralRadius = scaledDistance;           // Scaled Radius
+            params.spiralSpeed = BASE_EARTH_SPEED * speed;  // Scaled Speed
+            params.fixedHeight = scaledHeight;              // Scaled Height
+            params.handles = findObjects(planet);
+        }
+
+        planetOrbits.clear();
+        planetOrbitHandles.clear();
+        for (const auto &pair : planetSpiralParameters) {
+            const PlanetSpiralParams &params = pair.second;
+            planetOrbits.add(0.0f, params.spiralSpeed, params.spiralRadius, params.fixedHeight);
+            planetOrbitHandles.push_back(params.handles);
+        }
+
+        // List of planet display names
+        const std::vector<std::string> displayPlanetNames = {
+            "mercury_display", "venus_display", "venus_atmosphere_display",
+            "earth_display", "earth_atmosphere_display", "mars_display",
+            "jupiter_display", "saturn_display", "saturn_ring_display",
+            "uranus_display", "neptune_display"
+        };
+
+        displayPlanets.clear();
+        for (const auto &planetName : displayPlanetNames) {
+            bool isAtmosphere = planetName == "earth_atmosphere_display" || planetName == "venus_atmosphere_display";
+            for (const auto &handle : findObjects(planetName)) {
+                displayPlanets.push_back({handle, isAtmosphere});
+            }
         }
     }
 
     // **Update planet positions dynamically**
     void updatePlanetPositions(float currentFrame, const glm::vec3& spiralCenter) {
-        for (const auto& pair : planetSpiralParameters) {
-            const std::string& planetName = pair.first;
-            const PlanetSpiralParams& params = pair.second;
+        // Calculate the spiral motion of every planet at once
+        utils_animation::animateOrbits(planetOrbits, currentFrame);
 
-            // Calculate new position based on spiral motion
-            glm::vec3 newPosition;
-            newPosition.x = spiralCenter.x + params.spiralRadius * cos(currentFrame * params.spiralSpeed);
-            newPosition.y = spiralCenter.y + params.fixedHeight;
-            newPosition.z = spiralCenter.z + params.spiralRadius * sin(currentFrame * params.spiralSpeed);
+        for (size_t i = 0; i < planetOrbits.size(); ++i) {
+            glm::vec3 newPosition = spiralCenter + glm::vec3(planetOrbits.x[i], planetOrbits.y[i], planetOrbits.z[i]);
 
             // Apply the new position
-            setObjectPosition(planetName, newPosition);
+            for (const auto &handle : planetOrbitHandles[i]) {
+                setObjectPosition(handle, newPosition);
+            }
         }
     }
 
@@ -88,41 +128,111 @@ namespace utils_scene
         const float ATMOSPHERE_ROTATION_SPEED = 0.8f; // Slower rotation for atmosphere
         const glm::vec3 ATMOSPHERE_ROTATION_AXIS = glm::vec3(0.0f, 1.0f, 0.0f); // Vertical rotation
 
-        // List of planet display names
-        std::vector<std::string> displayPlanets = {
-            "mercury_display", "venus_display", "venus_atmosphere_display",
-            "earth_display", "earth_atmosphere_display", "mars_display",
-            "jupiter_display", "saturn_display", "saturn_ring_display",
-            "uranus_display", "neptune_display"
-        };
-
         // Apply rotation to each display planet
-        for (const auto &planetName : displayPlanets) {
-            if (planetName == "earth_atmosphere_display" || planetName == "venus_atmosphere_display") {
+        for (const auto &planet : displayPlanets) {
+            if (planet.isAtmosphere) {
                 // Custom rotation for atmospheres
                 float rotationAngle = currentFrame * ATMOSPHERE_ROTATION_SPEED; 
-                setObjectRotation(planetName, ATMOSPHERE_ROTATION_AXIS, rotationAngle);
+                setObjectRotation(planet.handle, ATMOSPHERE_ROTATION_AXIS, rotationAngle);
             } else {
                 // Default rotation for other planets
                 float rotationAngle = currentFrame * ROTATION_SPEED; 
-                setObjectRotation(planetName, ROTATION_AXIS, rotationAngle);
+                setObjectRotation(planet.handle, ROTATION_AXIS, rotationAngle);
             }
         }
     }
 
-    std::vector<SceneObject> sceneObjects;
-    std::vector<SceneObject> sceneObjectsTransparent;
-    std::vector<SceneObject> sceneObjectsSkybox;
-
-    void addCube(const std::string &name,
-                const glm::vec3 &position,
-                const glm::vec3 &scale,
-                const Material &material,
-                const glm::vec3 &rotationAxis,
-                float rotationAngle,
-                GLuint vaoID,
-                GLsizei indexCount,
-                bool isStatic)
+    SceneStore sceneObjects;
+    SceneStore sceneObjectsTransparent;
+    SceneStore sceneObjectsSkybox;
+
+    std::vector<GLuint> compositeMeshBuffers;
+    std::vector<GLuint> compositeMeshVAOs;
+
+    SceneStore &getStore(StoreKind store)
+    {
+        switch (store)
+        {
+        case StoreKind::Transparent:
+            return sceneObjectsTransparent;
+        case StoreKind::Skybox:
+            return sceneObjectsSkybox;
+        default:
+            return sceneObjects;
+        }
+    }
+
+    void updateSceneMatrices()
+    {
+        sceneObjects.updateMatrices();
+        sceneObjectsTransparent.updateMatrices();
+        sceneObjectsSkybox.updateMatrices();
+    }
+
+    void clearSceneObjects()
+    {
+        sceneObjects.clear();
+        sceneObjectsTransparent.clear();
+        sceneObjectsSkybox.clear();
+        objectIndex.clear();
+        displayPlanets.clear();
+        planetSpiralParameters.clear();
+    }
+
+    const std::vector<ObjectHandle> &findObjects(const std::string &name)
+    {
+        static const std::vector<ObjectHandle> noObjects;
+        auto it = objectIndex.find(name);
+        return it != objectIndex.end() ? it->second : noObjects;
+    }
+
+    ObjectHandle findObject(const std::string &name, StoreKind store)
+    {
+        for (const auto &handle : findObjects(name))
+        {
+            if (handle.store == store)
+            {
+                return handle;
+            }
+        }
+        return ObjectHandle();
+    }
+
+    // Function to split a built object into the columns of a store and register its name
+    static ObjectHandle storeObject(StoreKind storeKind, const SceneObject &object)
+    {
+        SceneStore &store = getStore(storeKind);
+
+        Transform transform;
+        transform.position = object.position;
+        transform.scale = object.scale;
+        transform.rotationAxis = object.rotationAxis;
+        transform.rotationAngle = object.rotationAngle;
+
+        RenderItem renderItem;
+        renderItem.type = object.type;
+        renderItem.vaoID = object.vaoID;
+        renderItem.indexCount = object.indexCount;
+        renderItem.instanceCount = object.instanceCount;
+        renderItem.materialIndex = object.materialIndex;
+
+        ObjectId id = store.add(object.name, transform, object.boundingBox, renderItem, object.isStatic, object.instanceVBO);
+        store.initialPositions[store.slotOf(id)] = object.initialPosition;
+
+        ObjectHandle handle(storeKind, id);
+        objectIndex[object.name].push_back(handle);
+        return handle;
+    }
+
+    ObjectHandle addCube(const std::string &name,
+                         const glm::vec3 &position,
+                         const glm::vec3 &scale,
+                         const Material &material,
+                         const glm::vec3 &rotationAxis,
+                         float rotationAngle,
+                         GLuint vaoID,
+                         GLsizei indexCount,
+                         bool isStatic)
     {
         SceneObject cube;
         cube.name = name;
@@ -148,18 +258,18 @@ namespace utils_scene
         }
         cube.materialIndex = materialIndex;
 
-        sceneObjects.push_back(cube);
+        return storeObject(StoreKind::Opaque, cube);
     }
 
-    void addTransparentCube(const std::string &name,
-                            const glm::vec3 &position,
-                            const glm::vec3 &scale,
-                            const Material &material,
-                            const glm::vec3 &rotationAxis,
-                            float rotationAngle,
-                            GLuint vaoID,
-                            GLsizei indexCount,
-                            bool isStatic)
+    ObjectHandle addTransparentCube(const std::string &name,
+                                    const glm::vec3 &position,
+                                    const glm::vec3 &scale,
+                                    const Material &material,
+                                    const glm::vec3 &rotationAxis,
+                                    float rotationAngle,
+                                    GLuint vaoID,
+                                    GLsizei indexCount,
+                                    bool isStatic)
     {
         SceneObject cube;
         cube.name = name;
@@ -185,16 +295,16 @@ namespace utils_scene
         }
         cube.materialIndex = materialIndex;
 
-        sceneObjectsTransparent.push_back(cube);
+        return storeObject(StoreKind::Transparent, cube);
     }
 
-    void addSphere(const std::string &name,
-                   const glm::vec3 &position,
-                   float radius,
-                   const Material &material,
-                   GLuint vaoID,
-                   GLsizei vertexCount,
-                   bool isStatic)
+    ObjectHandle addSphere(const std::string &name,
+                           const glm::vec3 &position,
+                           float radius,
+                           const Material &material,
+                           GLuint vaoID,
+                           GLsizei vertexCount,
+                           bool isStatic)
     {
         SceneObject sphereObject;
         sphereObject.name = name;
@@ -208,6 +318,9 @@ namespace utils_scene
         sphereObject.indexCount = vertexCount;
         sphereObject.isStatic = isStatic;
 
+        // Calculate bounding box, the sphere mesh has a radius of 1
+        sphereObject.boundingBox.min = position - sphereObject.scale;
+        sphereObject.boundingBox.max = position + sphereObject.scale;
 
         // Assign material using MaterialManager
         int materialIndex = MaterialManager::getInstance().findMaterial(material);
@@ -216,17 +329,17 @@ namespace utils_scene
         }
         sphereObject.materialIndex = materialIndex;
 
-        sceneObjects.push_back(sphereObject);
+        return storeObject(StoreKind::Opaque, sphereObject);
     }
 
     // transparent sphere
-    void addTransparentSphere(const std::string &name,
-                   const glm::vec3 &position,
-                   float radius,
-                   const Material &material,
-                   GLuint vaoID,
-                   GLsizei vertexCount,
-                   bool isStatic)
+    ObjectHandle addTransparentSphere(const std::string &name,
+                                      const glm::vec3 &position,
+                                      float radius,
+                                      const Material &material,
+                                      GLuint vaoID,
+                                      GLsizei vertexCount,
+                                      bool isStatic)
     {
         SceneObject sphereObject;
         sphereObject.name = name;
@@ -245,6 +358,10 @@ namespace utils_scene
         sphereObject.indexCount = vertexCount;
         sphereObject.isStatic = isStatic;
 
+        // Calculate bounding box, the sphere mesh has a radius of 1
+        sphereObject.boundingBox.min = position - sphereObject.scale;
+        sphereObject.boundingBox.max = position + sphereObject.scale;
+
         // Assign material using MaterialManager
         int materialIndex = MaterialManager::getInstance().findMaterial(material);
         if (materialIndex == -1) {
@@ -252,17 +369,17 @@ namespace utils_scene
         }
         sphereObject.materialIndex = materialIndex;
 
-        sceneObjectsTransparent.push_back(sphereObject);
+        return storeObject(StoreKind::Transparent, sphereObject);
     }
     
     // add sphere no bounding box
-    void addSkySphere(const std::string &name,
-                   const glm::vec3 &position,
-                   float radius,
-                   const Material &material,
-                   GLuint vaoID,
-                   GLsizei vertexCount,
-                   bool isStatic)
+    ObjectHandle addSkySphere(const std::string &name,
+                              const glm::vec3 &position,
+                              float radius,
+                              const Material &material,
+                              GLuint vaoID,
+                              GLsizei vertexCount,
+                              bool isStatic)
     {
         SceneObject sphereObject;
         sphereObject.name = name;
@@ -283,48 +400,133 @@ namespace utils_scene
         }
         sphereObject.materialIndex = materialIndex;
 
-        sceneObjectsSkybox.push_back(sphereObject);
+        ObjectHandle handle = storeObject(StoreKind::Skybox, sphereObject);
         // sceneObjects.push_back(sphereObject);
         // print object name
         std::cout << "Skybox sphere name: " << sphereObject.name << std::endl;
+        return handle;
     }
 
-    void createCompositeCube(const std::string &name,
-                             const glm::vec3 &origin,
-                             const glm::vec3 &size,
-                             const Material &material,
-                             GLuint vaoID,
-                             GLsizei indexCount,
-                             bool isStatic)
+    // Function to build the objects of a composite volume, one per room so per-room light masking stays per object.
+    // Room 1 gets a single mesh without the faces shared between cubes and with coplanar faces merged.
+    // Room 2 keeps one instance per cube: its vertex shader distorts each cube's triangles around the lights.
+    static void buildCompositeCubeObjects(const std::string &name,
+                                          const glm::vec3 &origin,
+                                          const glm::vec3 &size,
+                                          const Material &material,
+                                          GLuint vaoID,
+                                          GLsizei indexCount,
+                                          bool isStatic,
+                                          StoreKind target)
     {
-        int numCubesX = static_cast<int>(size.x);
-        int numCubesY = static_cast<int>(size.y);
-        int numCubesZ = static_cast<int>(size.z);
-
-        for (int x = 0; x < numCubesX; ++x)
+        glm::ivec3 dims(static_cast<int>(size.x), static_cast<int>(size.y), static_cast<int>(size.z));
+        if (dims.x <= 0 || dims.y <= 0 || dims.z <= 0)
+            return;
+
+        // Room of every cube, the whole volume occludes so faces against the other room's cubes are dropped too
+        std::vector<int> cells(dims.x * dims.y * dims.z);
+        std::vector<glm::vec3> roomCubes[2];
+        for (int z = 0; z < dims.z; ++z)
         {
-            for (int y = 0; y < numCubesY; ++y)
+            for (int y = 0; y < dims.y; ++y)
             {
-                for (int z = 0; z < numCubesZ; ++z)
+                for (int x = 0; x < dims.x; ++x)
                 {
                     glm::vec3 position = origin + glm::vec3(x, y, z);
-                    std::string cubeName = name + "_" + std::to_string(x) + "_" + std::to_string(y) + "_" + std::to_string(z);
-                    addCube(
-                        cubeName,        // Name
-                        position,        // Position
-                        glm::vec3(1.0f), // Scale (individual cubes are 1x1x1 units)
-                        material,        // Material
-                        glm::vec3(0.0f), // Rotation axis
-                        0.0f,            // Rotation angle
-                        vaoID,           // VAO ID
-                        indexCount,      // Index count
-                        isStatic         // Is static
-                    );
+                    int room = (position.x < ROOM_BOUNDARY_X) ? 0 : 1;
+                    cells[x + dims.x * (y + dims.y * z)] = room;
+                    roomCubes[room].push_back(position);
+                }
+            }
+        }
+
+        // Ensure material is reused
+        int materialIndex = MaterialManager::getInstance().findMaterial(material);
+        if (materialIndex == -1) {
+            materialIndex = MaterialManager::getInstance().addOrGetMaterial(material);
+        }
+
+        for (int room = 0; room < 2; ++room)
+        {
+            const std::vector<glm::vec3> &cubes = roomCubes[room];
+            if (cubes.empty())
+                continue;
+
+            // Bounding box of the room's cubes, individual cubes are 1x1x1 units
+            AABB boundingBox;
+            boundingBox.min = cubes.front();
+            boundingBox.max = cubes.front();
+            for (const auto &position : cubes)
+            {
+                boundingBox.min = glm::min(boundingBox.min, position);
+                boundingBox.max = glm::max(boundingBox.max, position);
+            }
+            boundingBox.min -= glm::vec3(0.5f);
+            boundingBox.max += glm::vec3(0.5f);
+            glm::vec3 center = (boundingBox.min + boundingBox.max) * 0.5f;
+
+            SceneObject object;
+            object.name = name;
+            object.type = ObjectType::Cube;
+            object.position = center;
+            object.initialPosition = center;
+            object.scale = glm::vec3(1.0f);
+            object.rotationAxis = glm::vec3(0.0f);
+            object.rotationAngle = 0.0f;
+            object.isStatic = isStatic;
+            object.boundingBox = boundingBox;
+            object.materialIndex = materialIndex;
+
+            if (room == 0)
+            {
+                // Vertices are relative to the center, which acts as the object position
+                std::vector<Vertex3D> vertices;
+                std::vector<GLuint> indices;
+                utils_object::createGreedyCubeMesh(cells, dims, room, origin - center, vertices, indices);
+                if (indices.empty())
+                    continue;
+
+                GLuint meshVBO, meshEBO;
+                utils_object::setupCubeBuffers(vertices, indices, meshVBO, meshEBO, object.vaoID);
+                compositeMeshBuffers.push_back(meshVBO);
+                compositeMeshBuffers.push_back(meshEBO);
+                compositeMeshVAOs.push_back(object.vaoID);
+                object.indexCount = static_cast<GLsizei>(indices.size());
+
+                storeObject(target, object);
+                std::cout << "Merged mesh " << name << ": " << indices.size() / 3 << " triangles for "
+                          << cubes.size() << " cubes" << std::endl;
+            }
+            else
+            {
+                // Instance matrices are relative to the group center
+                std::vector<glm::mat4> instanceMatrices;
+                instanceMatrices.reserve(cubes.size());
+                for (const auto &position : cubes)
+                {
+                    instanceMatrices.push_back(glm::translate(glm::mat4(1.0f), position - center));
                 }
+                object.indexCount = indexCount;
+                object.instanceCount = static_cast<GLsizei>(cubes.size());
+                utils_object::setupInstancedCubeBuffers(vaoID, instanceMatrices, object.instanceVBO, object.vaoID);
+
+                storeObject(target, object);
+                std::cout << "Instanced group " << name << ": " << object.instanceCount << " cubes" << std::endl;
             }
         }
     }
 
+    void createCompositeCube(const std::string &name,
+                             const glm::vec3 &origin,
+                             const glm::vec3 &size,
+                             const Material &material,
+                             GLuint vaoID,
+                             GLsizei indexCount,
+                             bool isStatic)
+    {
+        buildCompositeCubeObjects(name, origin, size, material, vaoID, indexCount, isStatic, StoreKind::Opaque);
+    }
+
     void createTransparentCompositeCube(const std::string &name,
                                         const glm::vec3 &origin,
                                         const glm::vec3 &size,
@@ -333,44 +535,19 @@ namespace utils_scene
                                         GLsizei indexCount,
                                         bool isStatic)
     {
-        int numCubesX = static_cast<int>(size.x);
-        int numCubesY = static_cast<int>(size.y);
-        int numCubesZ = static_cast<int>(size.z);
-
-        for (int x = 0; x < numCubesX; ++x)
-        {
-            for (int y = 0; y < numCubesY; ++y)
-            {
-                for (int z = 0; z < numCubesZ; ++z)
-                {
-                    glm::vec3 position = origin + glm::vec3(x, y, z);
-                    std::string cubeName = name + "_" + std::to_string(x) + "_" + std::to_string(y) + "_" + std::to_string(z);
-                    addTransparentCube(
-                        cubeName,        // Name
-                        position,        // Position
-                        glm::vec3(1.0f), // Scale (individual cubes are 1x1x1 units)
-                        material,        // Material
-                        glm::vec3(0.0f), // Rotation axis
-                        0.0f,            // Rotation angle
-                        vaoID,           // VAO ID
-                        indexCount,      // Index count
-                        isStatic         // Is static
-                    );
-                }
-            }
-        }
+        buildCompositeCubeObjects(name, origin, size, material, vaoID, indexCount, isStatic, StoreKind::Transparent);
     }
 
-    void addModel(const std::string &name,
-                  const glm::vec3 &position,
-                  const glm::vec3 &scale,
-                  const Material &material,
-                  GLuint vaoID,
-                  GLsizei indexCount,
-                  const AABB &boundingBox,
-                  const glm::vec3 &rotationAxis,
-                  float rotationAngle,
-                  bool isStatic)
+    ObjectHandle addModel(const std::string &name,
+                          const glm::vec3 &position,
+                          const glm::vec3 &scale,
+                          const Material &material,
+                          GLuint vaoID,
+                          GLsizei indexCount,
+                          const AABB &boundingBox,
+                          const glm::vec3 &rotationAxis,
+                          float rotationAngle,
+                          bool isStatic)
     {
         SceneObject obj;
         obj.name = name;
@@ -393,51 +570,65 @@ namespace utils_scene
         }
         obj.materialIndex = materialIndex;
 
-        sceneObjects.push_back(obj);
+        return storeObject(StoreKind::Opaque, obj);
     }
 
-    // getTransparentObjectPosition
-    glm::vec3 getTransparentObjectPosition(const std::string &name)
+    glm::vec3 getObjectPosition(ObjectHandle handle)
     {
-        for (const auto &obj : sceneObjectsTransparent)
+        if (!handle.isValid())
         {
-            if (obj.name == name)
-            {
-                return obj.position;
-            }
+            return glm::vec3(0.0f);
         }
-        return glm::vec3(0.0f);
+        SceneStore &store = getStore(handle.store);
+        return store.transforms[store.slotOf(handle.id)].position;
     }
 
-    // getObjectPosition
-    glm::vec3 getObjectPosition(const std::string &name)
+    void setObjectPosition(ObjectHandle handle, const glm::vec3 &position)
     {
-        for (const auto &obj : sceneObjects)
+        if (!handle.isValid())
         {
-            if (obj.name == name)
-            {
-                return obj.position;
-            }
+            return;
         }
-        return glm::vec3(0.0f);
+        SceneStore &store = getStore(handle.store);
+        size_t slot = store.slotOf(handle.id);
+        store.transforms[slot].position = position;
+        store.markDirty(slot);
     }
 
-    // setObjectPosition
-    void setObjectPosition(const std::string &name, const glm::vec3 &position)
+    void setObjectRotation(ObjectHandle handle, const glm::vec3 &rotationAxis, float rotationAngle)
     {
-        for (auto &obj : sceneObjects)
+        if (!handle.isValid())
         {
-            if (obj.name == name)
-            {
-                obj.position = position;
-            }
+            return;
         }
-        // for transparent objects
-        for (auto &obj : sceneObjectsTransparent)
+        SceneStore &store = getStore(handle.store);
+        size_t slot = store.slotOf(handle.id);
+        store.transforms[slot].rotationAxis = rotationAxis;
+        store.transforms[slot].rotationAngle = rotationAngle;
+        store.markDirty(slot);
+    }
+
+    // getTransparentObjectPosition
+    glm::vec3 getTransparentObjectPosition(const std::string &name)
+    {
+        return getObjectPosition(findObject(name, StoreKind::Transparent));
+    }
+
+    // getObjectPosition
+    glm::vec3 getObjectPosition(const std::string &name)
+    {
+        return getObjectPosition(findObject(name, StoreKind::Opaque));
+    }
+
+    // setObjectPosition
+    void setObjectPosition(const std::string &name, const glm::vec3 &position)
+    {
+        // applies to opaque and transparent objects sharing the name
+        for (const auto &handle : findObjects(name))
         {
-            if (obj.name == name)
+            if (handle.store != StoreKind::Skybox)
             {
-                obj.position = position;
+                setObjectPosition(handle, position);
             }
         }
     }
@@ -445,21 +636,12 @@ namespace utils_scene
     // set obect rotation
     void setObjectRotation(const std::string &name, const glm::vec3 &rotationAxis, float rotationAngle)
     {
-        for (auto &obj : sceneObjects)
-        {
-            if (obj.name == name)
-            {
-                obj.rotationAxis = rotationAxis;
-                obj.rotationAngle = rotationAngle;
-            }
-        }
-        // for transparent objects
-        for (auto &obj : sceneObjectsTransparent)
+        // applies to opaque and transparent objects sharing the name
+        for (const auto &handle : findObjects(name))
         {
-            if (obj.name == name)
+            if (handle.store != StoreKind::Skybox)
             {
-                obj.rotationAxis = rotationAxis;
-                obj.rotationAngle = rotationAngle;
+                setObjectRotation(handle, rotationAxis, rotationAngle);
             }
         }
     }
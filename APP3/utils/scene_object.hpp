@@ -3,6 +3,7 @@
 #define SCENE_OBJECT_HPP
 
 #include "utilities.hpp"
+#include "scene_store.hpp"
 #include "global.hpp"
 #include "material.hpp"  
 #include "material_manager.hpp"
@@ -13,11 +14,23 @@
 namespace utils_scene
 {
 
-    enum class ObjectType
+    // Which store an object lives in
+    enum class StoreKind : unsigned char
     {
-        Cube,
-        Sphere,
-        Model
+        Opaque,
+        Transparent,
+        Skybox
+    };
+
+    // Typed reference to an object: its store and its stable id inside that store
+    struct ObjectHandle
+    {
+        StoreKind store;
+        ObjectId id;
+
+        ObjectHandle() : store(StoreKind::Opaque), id(INVALID_OBJECT_ID) {}
+        ObjectHandle(StoreKind store_, ObjectId id_) : store(store_), id(id_) {}
+        bool isValid() const { return id != INVALID_OBJECT_ID; }
     };
 
 // Define a struct to hold spiral parameters for planets
@@ -25,12 +38,13 @@ namespace utils_scene
         float spiralRadius;
         float spiralSpeed;
         float fixedHeight;
+        std::vector<ObjectHandle> handles; // Objects moved by this planet, resolved once
     };
 
     // Map to hold parameters for each planet
     extern std::map<std::string, PlanetSpiralParams> planetSpiralParameters;
 
-    // Function to initialize planet spiral parameters
+    // Function to initialize planet spiral parameters and resolve planet handles (call after scene setup)
     void initializePlanetSpiralParameters();
 
     // Function to update planet positions
@@ -39,6 +53,7 @@ namespace utils_scene
     // Function to update display planet positions
     void updateDisplayPlanetPositions(float currentFrame);
 
+    // Description of an object while it is being built, stored column-wise in a SceneStore
     struct SceneObject
     {
         std::string name;
@@ -51,6 +66,8 @@ namespace utils_scene
         AABB boundingBox;
         GLuint vaoID;
         GLsizei indexCount;
+        GLsizei instanceCount; // Number of instances when drawn as an instanced group, 0 otherwise
+        GLuint instanceVBO;    // Per-instance model matrices of an instanced group
         bool isStatic;
 
         // Material reference
@@ -60,57 +77,77 @@ namespace utils_scene
         SceneObject()
             : position(0.0f), initialPosition(0.0f), scale(1.0f),
               rotationAxis(0.0f), rotationAngle(0.0f), vaoID(0),
-              indexCount(0), isStatic(false), materialIndex(-1) {}
+              indexCount(0), instanceCount(0), instanceVBO(0),
+              isStatic(false), materialIndex(-1) {}
     };
 
-    extern std::vector<SceneObject> sceneObjects;
-    extern std::vector<SceneObject> sceneObjectsTransparent;
-    extern std::vector<SceneObject> sceneObjectsSkybox;
+    extern SceneStore sceneObjects;
+    extern SceneStore sceneObjectsTransparent;
+    extern SceneStore sceneObjectsSkybox;
+
+    // Buffers and VAOs of the merged composite cube meshes, owned here and deleted at shutdown
+    extern std::vector<GLuint> compositeMeshBuffers;
+    extern std::vector<GLuint> compositeMeshVAOs;
+
+    // Function to get the store a handle refers to
+    SceneStore &getStore(StoreKind store);
+
+    // Function to rebuild the cached matrices of every object moved since the last call
+    void updateSceneMatrices();
+
+    // Function to empty every store and the name index
+    void clearSceneObjects();
+
+    // Function to get every object registered under a name, in insertion order (hash lookup)
+    const std::vector<ObjectHandle> &findObjects(const std::string &name);
+
+    // Function to get the first object registered under a name in a given store, invalid handle if none
+    ObjectHandle findObject(const std::string &name, StoreKind store);
 
     // Updated function declarations to accept Material
-    void addCube(const std::string &name,
-                 const glm::vec3 &position,
-                 const glm::vec3 &scale,
-                 const Material &material,
-                 const glm::vec3 &rotationAxis = glm::vec3(0.0f),
-                 float rotationAngle = 0.0f,
-                 GLuint vaoID = 0,
-                 GLsizei indexCount = 0,
-                 bool isStatic = false);
-
-    void addTransparentCube(const std::string &name,
-                            const glm::vec3 &position,
-                            const glm::vec3 &scale,
-                            const Material &material,
-                            const glm::vec3 &rotationAxis = glm::vec3(0.0f),
-                            float rotationAngle = 0.0f,
-                            GLuint vaoID = 0,
-                            GLsizei indexCount = 0,
-                            bool isStatic = false);
-
-    void addSphere(const std::string &name,
-                   const glm::vec3 &position,
-                   float radius,
-                   const Material &material,
-                   GLuint vaoID = 0,
-                   GLsizei vertexCount = 0,
-                   bool isStatic = false);
-
-    void addTransparentSphere(const std::string &name,
-                      const glm::vec3 &position,
-                      float radius,
-                      const Material &material,
-                      GLuint vaoID = 0,
-                      GLsizei vertexCount = 0,
-                      bool isStatic = false);
-
-    void addSkySphere(const std::string &name,
-                      const glm::vec3 &position,
-                      float radius,
-                      const Material &material,
-                      GLuint vaoID = 0,
-                      GLsizei vertexCount = 0,
-                      bool isStatic = false);
+    ObjectHandle addCube(const std::string &name,
+                         const glm::vec3 &position,
+                         const glm::vec3 &scale,
+                         const Material &material,
+                         const glm::vec3 &rotationAxis = glm::vec3(0.0f),
+                         float rotationAngle = 0.0f,
+                         GLuint vaoID = 0,
+                         GLsizei indexCount = 0,
+                         bool isStatic = false);
+
+    ObjectHandle addTransparentCube(const std::string &name,
+                                    const glm::vec3 &position,
+                                    const glm::vec3 &scale,
+                                    const Material &material,
+                                    const glm::vec3 &rotationAxis = glm::vec3(0.0f),
+                                    float rotationAngle = 0.0f,
+                                    GLuint vaoID = 0,
+                                    GLsizei indexCount = 0,
+                                    bool isStatic = false);
+
+    ObjectHandle addSphere(const std::string &name,
+                           const glm::vec3 &position,
+                           float radius,
+                           const Material &material,
+                           GLuint vaoID = 0,
+                           GLsizei vertexCount = 0,
+                           bool isStatic = false);
+
+    ObjectHandle addTransparentSphere(const std::string &name,
+                                      const glm::vec3 &position,
+                                      float radius,
+                                      const Material &material,
+                                      GLuint vaoID = 0,
+                                      GLsizei vertexCount = 0,
+                                      bool isStatic = false);
+
+    ObjectHandle addSkySphere(const std::string &name,
+                              const glm::vec3 &position,
+                              float radius,
+                              const Material &material,
+                              GLuint vaoID = 0,
+                              GLsizei vertexCount = 0,
+                              bool isStatic = false);
 
     void createCompositeCube(const std::string &name,
                              const glm::vec3 &origin,
@@ -128,16 +165,21 @@ namespace utils_scene
                                         GLsizei indexCount,
                                         bool isStatic);
 
-    void addModel(const std::string &name,
-                  const glm::vec3 &position,
-                  const glm::vec3 &scale,
-                  const Material &material,
-                  GLuint vaoID,
-                  GLsizei indexCount,
-                  const AABB &boundingBox,
-                  const glm::vec3 &rotationAxis = glm::vec3(0.0f),
-                  float rotationAngle = 0.0f,
-                  bool isStatic = false);
+    ObjectHandle addModel(const std::string &name,
+                          const glm::vec3 &position,
+                          const glm::vec3 &scale,
+                          const Material &material,
+                          GLuint vaoID,
+                          GLsizei indexCount,
+                          const AABB &boundingBox,
+                          const glm::vec3 &rotationAxis = glm::vec3(0.0f),
+                          float rotationAngle = 0.0f,
+                          bool isStatic = false);
+
+    // Handle based accessors, O(1) per call
+    glm::vec3 getObjectPosition(ObjectHandle handle);
+    void setObjectPosition(ObjectHandle handle, const glm::vec3 &position);
+    void setObjectRotation(ObjectHandle handle, const glm::vec3 &rotationAxis, float rotationAngle);
 
     // getTransparentObjectPosition
     glm::vec3 getTransparentObjectPosition(const std::string &name);
@@ -0,0 +1,157 @@
+// scene_store.cpp
+#include "scene_store.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace utils_scene
+{
+
+    // Function to apply a slot permutation to one column
+    template <typename T>
+    static void permuteColumn(std::vector<T> &column, const std::vector<size_t> &order)
+    {
+        std::vector<T> permuted;
+        permuted.reserve(column.size());
+        for (size_t slot : order)
+        {
+            permuted.push_back(column[slot]);
+        }
+        column.swap(permuted);
+    }
+
+    // Function to compute the axis aligned box enclosing a transformed box
+    static AABB transformBounds(const glm::mat4 &matrix, const AABB &box)
+    {
+        glm::vec3 newMin(matrix[3]);
+        glm::vec3 newMax(matrix[3]);
+        for (int column = 0; column < 3; ++column)
+        {
+            for (int row = 0; row < 3; ++row)
+            {
+                float a = matrix[column][row] * box.min[column];
+                float b = matrix[column][row] * box.max[column];
+                newMin[row] += glm::min(a, b);
+                newMax[row] += glm::max(a, b);
+            }
+        }
+        return AABB(newMin, newMax);
+    }
+
+    // Function to build the model matrix of a transform
+    static glm::mat4 computeModelMatrix(const Transform &transform)
+    {
+        glm::mat4 modelMatrix = glm::mat4(1.0f);
+        modelMatrix = glm::translate(modelMatrix, transform.position);
+        if (transform.rotationAngle != 0.0f)
+        {
+            modelMatrix = glm::rotate(modelMatrix, glm::radians(transform.rotationAngle), transform.rotationAxis);
+        }
+        return glm::scale(modelMatrix, transform.scale);
+    }
+
+    ObjectId SceneStore::add(const std::string &name,
+                             const Transform &transform,
+                             const AABB &boundingBox,
+                             const RenderItem &renderItem,
+                             bool isStaticObject,
+                             GLuint instanceVBO)
+    {
+        ObjectId id = static_cast<ObjectId>(idToSlot.size());
+        idToSlot.push_back(static_cast<std::uint32_t>(transforms.size()));
+        slotToId.push_back(id);
+
+        transforms.push_back(transform);
+        worldMatrices.push_back(glm::mat4(1.0f));
+        normalMatrices.push_back(glm::mat3(1.0f));
+        dirty.push_back(1);
+        bounds.push_back(boundingBox);
+        localBounds.push_back(transformBounds(glm::inverse(computeModelMatrix(transform)), boundingBox));
+        renderItems.push_back(renderItem);
+        isStatic.push_back(isStaticObject ? 1 : 0);
+        initialPositions.push_back(transform.position);
+        instanceVBOs.push_back(instanceVBO);
+        names.push_back(name);
+        return id;
+    }
+
+    void SceneStore::clear()
+    {
+        transforms.clear();
+        worldMatrices.clear();
+        normalMatrices.clear();
+        dirty.clear();
+        bounds.clear();
+        localBounds.clear();
+        moved.clear();
+        renderItems.clear();
+        isStatic.clear();
+        initialPositions.clear();
+        instanceVBOs.clear();
+        names.clear();
+        slotToId.clear();
+        idToSlot.clear();
+    }
+
+    void SceneStore::updateMatrices()
+    {
+        moved.clear();
+        for (size_t slot = 0; slot < transforms.size(); ++slot)
+        {
+            if (!dirty[slot])
+            {
+                continue;
+            }
+
+            glm::mat4 modelMatrix = computeModelMatrix(transforms[slot]);
+            worldMatrices[slot] = modelMatrix;
+            normalMatrices[slot] = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+            bounds[slot] = transformBounds(modelMatrix, localBounds[slot]);
+            dirty[slot] = 0;
+            moved.push_back(slotToId[slot]);
+        }
+    }
+
+    void SceneStore::reorder(const std::vector<size_t> &order)
+    {
+        permuteColumn(transforms, order);
+        permuteColumn(worldMatrices, order);
+        permuteColumn(normalMatrices, order);
+        permuteColumn(dirty, order);
+        permuteColumn(bounds, order);
+        permuteColumn(localBounds, order);
+        permuteColumn(renderItems, order);
+        permuteColumn(isStatic, order);
+        permuteColumn(initialPositions, order);
+        permuteColumn(instanceVBOs, order);
+        permuteColumn(names, order);
+        permuteColumn(slotToId, order);
+
+        for (size_t slot = 0; slot < slotToId.size(); ++slot)
+        {
+            idToSlot[slotToId[slot]] = static_cast<std::uint32_t>(slot);
+        }
+    }
+
+    void drawRenderItem(const RenderItem &item)
+    {
+        glBindVertexArray(item.vaoID);
+        issueDrawCall(item);
+        glBindVertexArray(0);
+    }
+
+    void issueDrawCall(const RenderItem &item)
+    {
+        if (item.type == ObjectType::Sphere)
+        {
+            glDrawArrays(GL_TRIANGLES, 0, item.indexCount);
+        }
+        else if (item.instanceCount > 0)
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0, item.instanceCount);
+        }
+        else
+        {
+            glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+        }
+    }
+
+} // namespace utils_scene
@@ -0,0 +1,104 @@
+// scene_store.hpp
+#ifndef SCENE_STORE_HPP
+#define SCENE_STORE_HPP
+
+#include "utilities.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include <string>
+
+namespace utils_scene
+{
+
+    enum class ObjectType
+    {
+        Cube,
+        Sphere,
+        Model
+    };
+
+    // Hot per-frame transform data of an object
+    struct Transform
+    {
+        glm::vec3 position;
+        glm::vec3 scale;
+        glm::vec3 rotationAxis;
+        float rotationAngle;
+    };
+
+    // Everything a pass needs to issue the draw call of an object
+    struct RenderItem
+    {
+        ObjectType type;
+        GLuint vaoID;
+        GLsizei indexCount;
+        GLsizei instanceCount; // Number of instances when drawn as an instanced group, 0 otherwise
+        int materialIndex;     // Index into MaterialManager's material list
+    };
+
+    // Stable identifier of an object inside a SceneStore, unaffected by reordering
+    typedef std::uint32_t ObjectId;
+    const ObjectId INVALID_OBJECT_ID = 0xFFFFFFFFu;
+
+    // Structure-of-arrays object storage: each column is a contiguous array indexed by slot,
+    // so a pass only walks the columns it reads. Slots can be reordered, ids stay valid.
+    class SceneStore
+    {
+    public:
+        // Columns, all indexed by slot
+        std::vector<Transform> transforms;
+        std::vector<glm::mat4> worldMatrices;  // Cached model matrices, valid after updateMatrices()
+        std::vector<glm::mat3> normalMatrices; // Cached world space inverse-transpose of worldMatrices
+        std::vector<AABB> bounds;      // World space bounds, follow the object when its matrices are rebuilt
+        std::vector<AABB> localBounds; // Bounds in object space, derived from the bounds given at creation
+        std::vector<RenderItem> renderItems;
+        std::vector<unsigned char> isStatic;
+        std::vector<glm::vec3> initialPositions;
+        std::vector<GLuint> instanceVBOs; // Instance matrices of an instanced group, 0 otherwise, released at shutdown
+        std::vector<std::string> names;
+
+        ObjectId add(const std::string &name,
+                     const Transform &transform,
+                     const AABB &boundingBox,
+                     const RenderItem &renderItem,
+                     bool isStatic,
+                     GLuint instanceVBO = 0);
+
+        size_t size() const { return transforms.size(); }
+        bool empty() const { return transforms.empty(); }
+        void clear();
+
+        size_t slotOf(ObjectId id) const { return idToSlot[id]; }
+        ObjectId idAt(size_t slot) const { return slotToId[slot]; }
+
+        // Function to flag an object whose transform was written so its matrices get rebuilt
+        void markDirty(size_t slot) { dirty[slot] = 1; }
+
+        // Function to rebuild the cached matrices and world bounds of dirty objects only
+        void updateMatrices();
+
+        // Objects whose matrices were rebuilt by the last updateMatrices() call
+        const std::vector<ObjectId> &movedObjects() const { return moved; }
+
+        // Function to permute every column so that new slot i holds the object previously at order[i].
+        // Copies every column, meant for structural changes; per-frame draw orders sort slot indices instead.
+        void reorder(const std::vector<size_t> &order);
+
+    private:
+        std::vector<unsigned char> dirty;
+        std::vector<ObjectId> moved;
+        std::vector<ObjectId> slotToId;
+        std::vector<std::uint32_t> idToSlot;
+    };
+
+    // Function to draw an object with its VAO, instanced groups use a single instanced draw call
+    void drawRenderItem(const RenderItem &item);
+
+    // Function to issue the draw call of an object whose VAO is already bound
+    void issueDrawCall(const RenderItem &item);
+
+} // namespace utils_scene
+
+#endif // SCENE_STORE_HPP
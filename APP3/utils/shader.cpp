@@ -1,10 +1,52 @@
 #include "shader.hpp"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <glimac/FilePath.hpp>
 
 namespace utils_loader {
 
-Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
+// GLSL names of the Uniform keys, in enum order
+static const char* const UNIFORM_NAMES[] = {
+    "uModelMatrix", "uMVPMatrix", "uMVMatrix", "uNormalMatrix", "uUseInstancing",
+    "uTexture", "uUseTexture", "uKd", "uKs", "uShininess", "uAlpha",
+    "uNormalMap", "uUseNormalMap", "uSpecularMap", "uUseSpecularMap",
+    "depthMap", "lightSpaceMatrix", "uColorMask", "uChromaticPass", "uOITPass", "uShadowAtlas",
+    "uObjectLightCount", "uObjectLights", "uReceivesMainLight",
+    "uClusterGrid", "uClusterLights", "uClusterParams",
+    "uObjectSide", "uInverseProjection", "uInverseView", "uMainLightSide",
+    "farPlane", "lightPos", "shadowMatrix", "model", "uFaceMask"
+};
+static_assert(sizeof(UNIFORM_NAMES) / sizeof(UNIFORM_NAMES[0]) == static_cast<size_t>(Uniform::Count),
+              "UNIFORM_NAMES must list every Uniform key");
+
+// Function to read a shader file and insert defines right after its #version line
+static std::string readSourceWithDefines(const std::string& path, const std::string& defines) {
+    std::ifstream input(path.c_str());
+    if (!input) {
+        throw std::runtime_error("Unable to load the file " + path);
+    }
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    std::string source = buffer.str();
+
+    size_t insertAt = 0;
+    size_t version = source.find("#version");
+    if (version != std::string::npos) {
+        size_t lineEnd = source.find('\n', version);
+        if (lineEnd == std::string::npos) {
+            source += '\n';
+            lineEnd = source.size() - 1;
+        }
+        insertAt = lineEnd + 1;
+    }
+    return source.insert(insertAt, defines);
+}
+
+Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
+    : m_vertexPath(vertexPath), m_fragmentPath(fragmentPath) {
     glimac::FilePath vPath(vertexPath.c_str());
     glimac::FilePath fPath(fragmentPath.c_str());
 
@@ -17,6 +59,111 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
     if (m_program.getGLId() == 0) {
         std::cerr << "Failed to load shader program: " << vertexPath << " and " << fragmentPath << std::endl;
     }
+    reflect();
+}
+
+Shader::Shader(const std::string& vertexPath, const std::string& geometryPath, const std::string& fragmentPath)
+    : m_vertexPath(vertexPath), m_geometryPath(geometryPath), m_fragmentPath(fragmentPath) {
+    glimac::FilePath vPath(vertexPath.c_str());
+    glimac::FilePath gPath(geometryPath.c_str());
+    glimac::FilePath fPath(fragmentPath.c_str());
+
+    // Debugging: Print paths
+    std::cout << "Loading vertex shader: " << vPath.dirPath() << std::endl;
+    std::cout << "Loading geometry shader: " << gPath.dirPath() << std::endl;
+    std::cout << "Loading fragment shader: " << fPath.dirPath() << std::endl;
+
+    // Load shader program
+    m_program = glimac::loadProgram(vPath, gPath, fPath);
+    if (m_program.getGLId() == 0) {
+        std::cerr << "Failed to load shader program: " << vertexPath << ", " << geometryPath << " and " << fragmentPath << std::endl;
+    }
+    reflect();
+}
+
+bool Shader::reload(const std::string& defines) {
+    try {
+        std::string vsSource = readSourceWithDefines(m_vertexPath, defines);
+        std::string fsSource = readSourceWithDefines(m_fragmentPath, defines);
+        std::string gsSource = m_geometryPath.empty() ? std::string() : readSourceWithDefines(m_geometryPath, defines);
+        glimac::Program program = m_geometryPath.empty()
+            ? glimac::buildProgram(vsSource.c_str(), fsSource.c_str())
+            : glimac::buildProgram(vsSource.c_str(), gsSource.c_str(), fsSource.c_str());
+
+        // glimac's move assignment does not release the program it replaces
+        glDeleteProgram(m_program.getGLId());
+        m_program = std::move(program);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to reload shader program " << m_vertexPath << ": " << e.what() << std::endl;
+        return false;
+    }
+    reflect();
+    return true;
+}
+
+void Shader::reflect() {
+    m_uniforms.clear();
+    m_blocks.clear();
+    std::fill(m_locations, m_locations + static_cast<size_t>(Uniform::Count), -1);
+
+    GLuint program = m_program.getGLId();
+    if (program == 0) {
+        return;
+    }
+
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, static_cast<GLuint>(i), maxNameLength, &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        // Members of uniform blocks have no location
+        GLint location = glGetUniformLocation(program, name.c_str());
+        if (location == -1) {
+            continue;
+        }
+
+        // Arrays are reported as "name[0]", register the bare name as well
+        UniformInfo info = {hashUniformName(name.c_str()), location};
+        m_uniforms.push_back(info);
+        size_t bracket = name.find('[');
+        if (bracket != std::string::npos) {
+            UniformInfo arrayInfo = {hashUniformName(name.substr(0, bracket).c_str()), location};
+            m_uniforms.push_back(arrayInfo);
+        }
+    }
+
+    std::sort(m_uniforms.begin(), m_uniforms.end(),
+              [](const UniformInfo& a, const UniformInfo& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < m_uniforms.size(); ++i) {
+        if (m_uniforms[i].hash == m_uniforms[i - 1].hash && m_uniforms[i].location != m_uniforms[i - 1].location) {
+            std::cerr << "Uniform name hash collision in program " << program << std::endl;
+        }
+    }
+
+    for (size_t key = 0; key < static_cast<size_t>(Uniform::Count); ++key) {
+        m_locations[key] = getUniformLocation(hashUniformName(UNIFORM_NAMES[key]));
+    }
+
+    GLint blockCount = 0;
+    GLint maxBlockNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+
+    std::vector<GLchar> blockNameBuffer(std::max(maxBlockNameLength, 1));
+    for (GLint i = 0; i < blockCount; ++i) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(program, static_cast<GLuint>(i), maxBlockNameLength, &length, blockNameBuffer.data());
+        BlockInfo block = {std::string(blockNameBuffer.data(), length), static_cast<GLuint>(i)};
+        m_blocks.push_back(block);
+    }
 }
 
 // Shader::~Shader() {
@@ -34,8 +181,27 @@ GLuint Shader::getID() const {
     return m_program.getGLId();
 }
 
+GLint Shader::getUniformLocation(std::uint32_t nameHash) const {
+    std::vector<UniformInfo>::const_iterator it = std::lower_bound(
+        m_uniforms.begin(), m_uniforms.end(), nameHash,
+        [](const UniformInfo& info, std::uint32_t hash) { return info.hash < hash; });
+    if (it == m_uniforms.end() || it->hash != nameHash) {
+        return -1;
+    }
+    return it->location;
+}
+
 GLint Shader::getUniformLocation(const std::string& name) const {
-    return glGetUniformLocation(m_program.getGLId(), name.c_str());
+    return getUniformLocation(hashUniformName(name.c_str()));
+}
+
+GLuint Shader::getUniformBlockIndex(const std::string& name) const {
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        if (m_blocks[i].name == name) {
+            return m_blocks[i].index;
+        }
+    }
+    return GL_INVALID_INDEX;
 }
 
 GLuint Shader::getGLId() const { // New method implementation
@@ -2,27 +2,83 @@
 #define SHADER_HPP
 
 #include <glimac/Program.hpp>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace utils_loader {
 
+// Uniforms used by the render loop, their locations are resolved once when the program is loaded
+enum class Uniform {
+    ModelMatrix, MVPMatrix, MVMatrix, NormalMatrix, UseInstancing,
+    Texture, UseTexture, Kd, Ks, Shininess, Alpha,
+    NormalMap, UseNormalMap, SpecularMap, UseSpecularMap,
+    DepthMap, LightSpaceMatrix, ColorMask, ChromaticPass, OITPass, ShadowAtlas,
+    ObjectLightCount, ObjectLights, ReceivesMainLight,
+    ClusterGrid, ClusterLights, ClusterParams,
+    ObjectSide, InverseProjection, InverseView, MainLightSide,
+    FarPlane, LightPos, ShadowMatrix, Model, FaceMask,
+    Count
+};
+
+// FNV-1a hash of a uniform name, usable at compile time to pre-hash names
+constexpr std::uint32_t hashUniformName(const char* name, std::uint32_t hash = 2166136261u) {
+    return *name ? hashUniformName(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u) : hash;
+}
+
 class Shader {
 public:
     Shader(const std::string& vertexPath, const std::string& fragmentPath);
+    Shader(const std::string& vertexPath, const std::string& geometryPath, const std::string& fragmentPath);
 
     // ~Shader();
 
     void use() const;
     GLuint getID() const;
-    GLint getUniformLocation(const std::string& name) const;
     GLuint getGLId() const;
 
+    // Location of a known uniform, -1 when the program does not use it
+    GLint getUniformLocation(Uniform uniform) const { return m_locations[static_cast<size_t>(uniform)]; }
+
+    // Location of any active uniform by pre-hashed name (see hashUniformName)
+    GLint getUniformLocation(std::uint32_t nameHash) const;
+
+    // Location of any active uniform by name, read from the reflected table
+    GLint getUniformLocation(const std::string& name) const;
+
+    // Index of an active uniform block, GL_INVALID_INDEX when the program has none by that name
+    GLuint getUniformBlockIndex(const std::string& name) const;
+
+    // Function to rebuild the program from its files with #define lines inserted after #version.
+    // Keeps the current program and returns false when compilation fails. Uniform values,
+    // sampler units and block bindings of the old program are lost and must be set again.
+    bool reload(const std::string& defines);
+
     // void deleteProgram();
 
 private:
+    struct UniformInfo {
+        std::uint32_t hash;
+        GLint location;
+    };
+
+    struct BlockInfo {
+        std::string name;
+        GLuint index;
+    };
+
+    // Function to enumerate the active uniforms and blocks of the linked program
+    void reflect();
+
     glimac::Program m_program;
+    std::string m_vertexPath;
+    std::string m_geometryPath; // Empty without a geometry stage
+    std::string m_fragmentPath;
+    std::vector<UniformInfo> m_uniforms; // Sorted by hash
+    std::vector<BlockInfo> m_blocks;
+    GLint m_locations[static_cast<size_t>(Uniform::Count)];
 };
 
 } // namespace utils_loader
 
-#endif // SHADER_HPP
\ No newline at end of file
+#endif // SHADER_HPP
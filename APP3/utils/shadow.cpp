@@ -0,0 +1,450 @@
+// shadow.cpp
+#include "shadow.hpp"
+#include "resource_loader.hpp"
+#include "bvh.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace utils_shadow
+{
+
+    const ShadowTier SHADOW_TIERS[SHADOW_TIER_COUNT] = {
+        {"Low", 512, GL_DEPTH_COMPONENT16, 16, 2, ShadowFilter::PCF, 4},
+        {"Medium", 1024, GL_DEPTH_COMPONENT24, 24, 4, ShadowFilter::Exponential, 0},
+        {"High", 2048, GL_DEPTH_COMPONENT24, 24, 4, ShadowFilter::Adaptive, 16},
+        {"Ultra", 4096, GL_DEPTH_COMPONENT32F, 32, 4, ShadowFilter::Sampled, 0}};
+
+    static const char *const SHADOW_FILTER_NAMES[] = {"sampled", "PCF", "adaptive PCF", "exponential"};
+
+    size_t shadowCubeMapBytes(const ShadowTier &tier)
+    {
+        return static_cast<size_t>(tier.resolution) * tier.resolution * CUBE_FACES * tier.bytesPerTexel;
+    }
+
+    size_t momentCubeMapBytes(const ShadowTier &tier)
+    {
+        if (tier.filter != ShadowFilter::Exponential)
+        {
+            return 0;
+        }
+        // One 32-bit float per texel, the mip chain adds a third
+        return static_cast<size_t>(tier.resolution) * tier.resolution * CUBE_FACES * 4 * 4 / 3;
+    }
+
+    std::string shadowFilterDefines(const ShadowTier &tier)
+    {
+        std::ostringstream defines;
+        defines << "#define SHADOW_FILTER " << static_cast<int>(tier.filter) << "\n";
+        if (tier.filterTaps > 0)
+        {
+            defines << "#define SHADOW_FILTER_TAPS " << tier.filterTaps << "\n";
+        }
+        defines << "#define ESM_EXPONENT " << std::fixed << ESM_EXPONENT << "\n";
+        return defines.str();
+    }
+
+    void clearShadowTarget(bool moments)
+    {
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (moments)
+        {
+            // exp(c * d) of the far plane, so empty texels never shadow
+            const GLfloat farMoment[4] = {std::exp(ESM_EXPONENT), 0.0f, 0.0f, 0.0f};
+            glClearBufferfv(GL_COLOR, 0, farMoment);
+        }
+    }
+
+    // Function to allocate a mipmapped single channel float cube map and attach it as the color target of a layered framebuffer
+    static void setupMomentCubeMap(GLuint &momentMap, GLuint fbo, int resolution)
+    {
+        glGenTextures(1, &momentMap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, momentMap);
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentMap, 0);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "Moment framebuffer not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void computeCubeFaceMatrices(const glm::vec3 &lightPos, const glm::mat4 &shadowProj, glm::mat4 faceMatrices[CUBE_FACES])
+    {
+        faceMatrices[0] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0));
+        faceMatrices[1] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0));
+        faceMatrices[2] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0));
+        faceMatrices[3] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0));
+        faceMatrices[4] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0));
+        faceMatrices[5] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0));
+    }
+
+    void computeFaceMasks(const utils_scene::SceneStore &store, const glm::mat4 faceMatrices[CUBE_FACES], std::vector<unsigned char> &masks)
+    {
+        utils_scene::Frustum faceFrusta[CUBE_FACES];
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            faceFrusta[face] = utils_scene::extractFrustum(faceMatrices[face]);
+        }
+
+        masks.assign(store.size(), 0);
+        for (size_t slot = 0; slot < store.size(); ++slot)
+        {
+            unsigned char mask = 0;
+            for (int face = 0; face < CUBE_FACES; ++face)
+            {
+                if (utils_scene::intersectsFrustum(faceFrusta[face], store.bounds[slot]))
+                {
+                    mask |= static_cast<unsigned char>(1u << face);
+                }
+            }
+            masks[slot] = mask;
+        }
+    }
+
+    unsigned char visibleFaces(const std::vector<unsigned char> &masks, const std::vector<unsigned char> &visible)
+    {
+        if (visible.size() != masks.size())
+        {
+            return ALL_CUBE_FACES;
+        }
+        unsigned char faces = 0;
+        for (size_t slot = 0; slot < masks.size() && faces != ALL_CUBE_FACES; ++slot)
+        {
+            if (visible[slot])
+            {
+                faces |= masks[slot];
+            }
+        }
+        return faces;
+    }
+
+    void ShadowFaceStats::reset()
+    {
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            faceDraws[face] = 0;
+        }
+        drawCalls = 0;
+        culled = 0;
+    }
+
+    void ShadowFaceStats::record(unsigned char mask)
+    {
+        if (mask == 0)
+        {
+            culled++;
+            return;
+        }
+        drawCalls++;
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            if (mask & (1u << face))
+            {
+                faceDraws[face]++;
+            }
+        }
+    }
+
+    std::string ShadowFaceStats::summary() const
+    {
+        std::string text;
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            if (face > 0)
+            {
+                text += "/";
+            }
+            text += std::to_string(faceDraws[face]);
+        }
+        return text;
+    }
+
+    ShadowMatrixBuffer::ShadowMatrixBuffer()
+        : buffer(0) {}
+
+    void ShadowMatrixBuffer::create()
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, CUBE_FACES * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_DATA_BINDING, buffer);
+    }
+
+    void ShadowMatrixBuffer::upload(const glm::mat4 faceMatrices[CUBE_FACES])
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, CUBE_FACES * sizeof(glm::mat4), faceMatrices);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void ShadowMatrixBuffer::bindBlock(const utils_loader::Shader &shader)
+    {
+        GLuint index = shader.getUniformBlockIndex("ShadowData");
+        if (index == GL_INVALID_INDEX)
+        {
+            std::cerr << "Failed to find the ShadowData uniform block in program " << shader.getGLId() << std::endl;
+            return;
+        }
+        glUniformBlockBinding(shader.getGLId(), index, SHADOW_DATA_BINDING);
+    }
+
+    StaticShadowCache::StaticShadowCache()
+        : cubeMap(0), momentMap(0), fbo(0), readFBO(0), drawFBO(0), resolution(0), staleFaces(ALL_CUBE_FACES), emptyFaces(ALL_CUBE_FACES),
+          facesPerFrame(2), order(ShadowUpdateOrder::CameraFirst), cachedLightPos(0.0f), updates(0)
+    {
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            faceAge[face] = 0;
+        }
+    }
+
+    void StaticShadowCache::setSchedule(int perFrame, ShadowUpdateOrder updateOrder)
+    {
+        facesPerFrame = perFrame;
+        order = updateOrder;
+    }
+
+    void StaticShadowCache::create(int size, GLenum depthFormat, bool moments)
+    {
+        release();
+        resolution = size;
+        utils_loader::setupDepthCubeMap(cubeMap, fbo, resolution, depthFormat);
+        if (moments)
+        {
+            setupMomentCubeMap(momentMap, fbo, resolution);
+        }
+
+        glGenFramebuffers(1, &readFBO);
+        glGenFramebuffers(1, &drawFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, readFBO);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(moments ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, drawFBO);
+        glDrawBuffer(moments ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        staleFaces = emptyFaces = ALL_CUBE_FACES;
+    }
+
+    void StaticShadowCache::release()
+    {
+        if (cubeMap != 0)
+        {
+            glDeleteTextures(1, &cubeMap);
+            glDeleteTextures(1, &momentMap); // Zero is silently ignored
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteFramebuffers(1, &readFBO);
+            glDeleteFramebuffers(1, &drawFBO);
+            cubeMap = momentMap = fbo = readFBO = drawFBO = 0;
+        }
+        staleFaces = emptyFaces = ALL_CUBE_FACES;
+    }
+
+    void StaticShadowCache::track(const utils_scene::SceneStore &store, const std::vector<unsigned char> &faceMasks)
+    {
+        if (dynamicIds.size() < store.size())
+        {
+            dynamicIds.resize(store.size(), 0);
+            casterFaces.resize(store.size(), 0);
+            for (size_t slot = 0; slot < store.size(); ++slot)
+            {
+                if (!store.isStatic[slot])
+                {
+                    dynamicIds[store.idAt(slot)] = 1;
+                }
+            }
+            staleFaces = ALL_CUBE_FACES;
+        }
+
+        // An object flagged static that moves anyway leaves the cache for good, only the faces holding its old shadow are refreshed
+        const std::vector<utils_scene::ObjectId> &moved = store.movedObjects();
+        for (size_t i = 0; i < moved.size(); ++i)
+        {
+            utils_scene::ObjectId id = moved[i];
+            if (id < dynamicIds.size() && !dynamicIds[id])
+            {
+                dynamicIds[id] = 1;
+                staleFaces |= casterFaces[id];
+            }
+        }
+
+        // Static bounds never change, so these masks only differ from the cached ones once the light moved and every face is stale anyway
+        for (size_t slot = 0; slot < store.size() && slot < faceMasks.size(); ++slot)
+        {
+            utils_scene::ObjectId id = store.idAt(slot);
+            if (id < casterFaces.size() && !dynamicIds[id])
+            {
+                casterFaces[id] = faceMasks[slot];
+            }
+        }
+    }
+
+    unsigned char StaticShadowCache::scheduleFaces(const glm::vec3 &lightPos, unsigned char cameraFaces)
+    {
+        if (lightPos != cachedLightPos)
+        {
+            staleFaces = ALL_CUBE_FACES;
+            cachedLightPos = lightPos;
+        }
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            if (staleFaces & (1u << face))
+            {
+                faceAge[face]++;
+            }
+        }
+
+        // Empty faces would leave holes in the shadow, they do not wait for the budget
+        unsigned char faces = emptyFaces;
+        for (int picked = 0; picked < facesPerFrame; ++picked)
+        {
+            // Starving faces first, then faces the camera sees, then the longest waiting
+            int best = -1;
+            int bestRank = -1;
+            for (int face = 0; face < CUBE_FACES; ++face)
+            {
+                unsigned char bit = static_cast<unsigned char>(1u << face);
+                if (!(staleFaces & bit) || (faces & bit))
+                {
+                    continue;
+                }
+                int rank = 0;
+                if (faceAge[face] >= STALE_FACE_MAX_AGE)
+                {
+                    rank = 2;
+                }
+                else if (order == ShadowUpdateOrder::CameraFirst && (cameraFaces & bit))
+                {
+                    rank = 1;
+                }
+                if (rank > bestRank || (rank == bestRank && faceAge[face] > faceAge[best]))
+                {
+                    best = face;
+                    bestRank = rank;
+                }
+            }
+            if (best < 0)
+            {
+                break;
+            }
+            faces |= static_cast<unsigned char>(1u << best);
+        }
+        return faces;
+    }
+
+    void StaticShadowCache::beginUpdate(unsigned char faces)
+    {
+        // A layered clear would wipe every face, so each refreshed face is cleared through its own attachment
+        glBindFramebuffer(GL_FRAMEBUFFER, drawFBO);
+        glViewport(0, 0, resolution, resolution);
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            if (!(faces & (1u << face)))
+            {
+                continue;
+            }
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubeMap, 0);
+            if (momentMap != 0)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, momentMap, 0);
+            }
+            clearShadowTarget(momentMap != 0);
+            faceAge[face] = 0;
+            updates++;
+        }
+        staleFaces &= static_cast<unsigned char>(~faces);
+        emptyFaces &= static_cast<unsigned char>(~faces);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    }
+
+    bool StaticShadowCache::isDynamic(const utils_scene::SceneStore &store, size_t slot) const
+    {
+        utils_scene::ObjectId id = store.idAt(slot);
+        return id >= dynamicIds.size() || dynamicIds[id];
+    }
+
+    void StaticShadowCache::copyTo(GLuint targetCubeMap, GLuint targetMomentMap) const
+    {
+        bool moments = momentMap != 0 && targetMomentMap != 0;
+        GLbitfield mask = moments ? (GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT) : GL_DEPTH_BUFFER_BIT;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubeMap, 0);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, targetCubeMap, 0);
+            if (moments)
+            {
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, momentMap, 0);
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, targetMomentMap, 0);
+            }
+            glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, mask, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void allocateShadowMaps(const ShadowTier &tier, GLuint &depthCubeMap, GLuint &momentCubeMap, GLuint &shadowMapFBO, StaticShadowCache &staticCache)
+    {
+        if (depthCubeMap != 0)
+        {
+            glDeleteTextures(1, &depthCubeMap);
+            glDeleteTextures(1, &momentCubeMap);
+            glDeleteFramebuffers(1, &shadowMapFBO);
+            momentCubeMap = 0;
+        }
+        utils_loader::setupDepthCubeMap(depthCubeMap, shadowMapFBO, tier.resolution, tier.depthFormat);
+
+        bool moments = tier.filter == ShadowFilter::Exponential;
+        if (moments)
+        {
+            setupMomentCubeMap(momentCubeMap, shadowMapFBO, tier.resolution);
+        }
+        else if (tier.filter != ShadowFilter::Sampled)
+        {
+            // samplerCubeShadow lookups, linear filtering returns the 2x2 percentage of passing comparisons
+            glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        }
+        staticCache.create(tier.resolution, tier.depthFormat, moments);
+
+        // Filtered lookups blend across face edges, the sampled filter keeps the original per-face reads
+        if (tier.filter == ShadowFilter::Sampled)
+        {
+            glDisable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        }
+        else
+        {
+            glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        }
+
+        // The shadow map and the static cache hold one cube map each, and one moment map each when filtering exponentially
+        double megabytes = 2.0 * (shadowCubeMapBytes(tier) + momentCubeMapBytes(tier)) / (1024.0 * 1024.0);
+        std::cout << "Shadow tier " << tier.name << ": " << tier.resolution << "x" << tier.resolution
+                  << ", " << tier.depthBits << "-bit depth, " << SHADOW_FILTER_NAMES[static_cast<int>(tier.filter)]
+                  << " filtering, " << megabytes << " MB of video memory" << std::endl;
+    }
+
+} // namespace utils_shadow
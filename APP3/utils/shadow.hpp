@@ -0,0 +1,187 @@
+// shadow.hpp
+#ifndef SHADOW_HPP
+#define SHADOW_HPP
+
+#include "shader.hpp"
+#include "scene_store.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace utils_shadow
+{
+
+    // Uniform buffer binding point of the ShadowData block of the layered depth shader
+    const GLuint SHADOW_DATA_BINDING = 2;
+
+    // Number of faces of the point light cube map
+    const int CUBE_FACES = 6;
+
+    // Face mask with every cube face set
+    const unsigned char ALL_CUBE_FACES = (1u << CUBE_FACES) - 1;
+
+    // Frames a stale face of the static cache may wait before it is refreshed ahead of the faces the camera sees
+    const unsigned int STALE_FACE_MAX_AGE = 6;
+
+    // Shadow filtering of the room shaders, compiled in through their SHADOW_FILTER define
+    enum class ShadowFilter
+    {
+        Sampled = 0,    // Kernel of depth reads compared in the shader, the original look
+        PCF = 1,        // Hardware depth comparison over a fixed Poisson kernel
+        Adaptive = 2,   // 4 comparison taps, the full kernel only in penumbrae
+        Exponential = 3 // Single read of a mipmapped exponential moment map
+    };
+
+    // Exponent of the exponential shadow map, higher values sharpen contacts, exp(ESM_EXPONENT) must fit a float
+    const float ESM_EXPONENT = 80.0f;
+
+    // Shadow map resolution, depth precision and filtering, selectable at runtime
+    struct ShadowTier
+    {
+        const char *name;
+        int resolution;      // Width and height of each cube map face
+        GLenum depthFormat;
+        int depthBits;
+        int bytesPerTexel;   // Storage per texel, 24-bit depth is padded to 4 bytes by drivers
+        ShadowFilter filter;
+        int filterTaps;      // Comparison taps of the PCF and adaptive filters
+    };
+
+    const int SHADOW_TIER_COUNT = 4;
+    extern const ShadowTier SHADOW_TIERS[SHADOW_TIER_COUNT];
+
+    // Video memory of one cube map at the given tier, in bytes
+    size_t shadowCubeMapBytes(const ShadowTier &tier);
+
+    // Video memory of one mipmapped moment cube map at the given tier, in bytes, 0 unless the tier filters exponentially
+    size_t momentCubeMapBytes(const ShadowTier &tier);
+
+    // Preprocessor lines selecting the filter of a tier, prepended to the room and depth shaders
+    std::string shadowFilterDefines(const ShadowTier &tier);
+
+    // Function to clear the bound shadow framebuffer, moments are cleared to the value of the far plane
+    void clearShadowTarget(bool moments);
+
+    // Function to compute the view-projection matrix of each cube face, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order
+    void computeCubeFaceMatrices(const glm::vec3 &lightPos, const glm::mat4 &shadowProj, glm::mat4 faceMatrices[CUBE_FACES]);
+
+    // Function to compute, per slot, the cube faces whose frustum the caster's bounds overlap (bit f for face f)
+    void computeFaceMasks(const utils_scene::SceneStore &store, const glm::mat4 faceMatrices[CUBE_FACES], std::vector<unsigned char> &masks);
+
+    // Function to combine the masks of the slots flagged visible, the faces holding shadows the camera can see.
+    // Every face is returned while no visibility is known yet.
+    unsigned char visibleFaces(const std::vector<unsigned char> &masks, const std::vector<unsigned char> &visible);
+
+    // Shadow caster draws of a frame, per cube face
+    struct ShadowFaceStats
+    {
+        unsigned int faceDraws[CUBE_FACES]; // Casters rendered into each face
+        unsigned int drawCalls;
+        unsigned int culled;                // Casters overlapping no face
+
+        ShadowFaceStats() { reset(); }
+
+        // Function to clear the counters, call when a frame starts
+        void reset();
+
+        // Function to count a caster drawn into the faces of its mask
+        void record(unsigned char mask);
+
+        // Per-face counts as "+X/-X/+Y/-Y/+Z/-Z"
+        std::string summary() const;
+    };
+
+    // Uniform buffer holding the six face matrices read by the layered depth shader
+    class ShadowMatrixBuffer
+    {
+    public:
+        ShadowMatrixBuffer();
+
+        // Function to allocate the buffer and attach it to SHADOW_DATA_BINDING
+        void create();
+
+        // Function to upload the face matrices of the current frame
+        void upload(const glm::mat4 faceMatrices[CUBE_FACES]);
+
+        // Function to point the ShadowData block of a program at SHADOW_DATA_BINDING
+        static void bindBlock(const utils_loader::Shader &shader);
+
+    private:
+        GLuint buffer;
+    };
+
+    // Order in which stale faces of the static cache are refreshed
+    enum class ShadowUpdateOrder
+    {
+        RoundRobin, // Longest waiting face first
+        CameraFirst // Faces holding receivers the camera sees first, then the longest waiting
+    };
+
+    // Depth cube map holding the casters that never moved, only re-rendered when the light or one of them moves.
+    // Each frame it is copied into the shadow map and the moving casters are drawn on top.
+    // Stale faces are refreshed a few per frame so a moving light or caster does not re-render all six at once.
+    class StaticShadowCache
+    {
+    public:
+        StaticShadowCache();
+
+        // Function to set how many stale faces are refreshed per frame and in which order
+        void setSchedule(int facesPerFrame, ShadowUpdateOrder order);
+
+        // Function to allocate the cached cube map, its moment map if requested and the framebuffers used to copy them, releasing previous ones
+        void create(int resolution, GLenum depthFormat, bool moments);
+
+        // Function to delete the cube map and framebuffers
+        void release();
+
+        // Function to turn the objects moved by the last updateMatrices() of the store into dynamic casters,
+        // the faces they were cached in become stale. faceMasks are the per-slot masks of computeFaceMasks().
+        void track(const utils_scene::SceneStore &store, const std::vector<unsigned char> &faceMasks);
+
+        // Function to pick the faces to re-render this frame, all of them become stale when the light moved.
+        // Faces never rendered are always picked, stale ones within the per-frame budget, cameraFaces first.
+        unsigned char scheduleFaces(const glm::vec3 &lightPos, unsigned char cameraFaces);
+
+        // Function to mark every face stale, e.g. after static geometry was added or removed
+        void invalidate() { staleFaces = ALL_CUBE_FACES; }
+
+        // Function to clear the given faces of the cached map and bind it for rendering, casters are then drawn with their mask limited to these faces
+        void beginUpdate(unsigned char faces);
+
+        // True when the object in this slot is drawn every frame instead of being cached
+        bool isDynamic(const utils_scene::SceneStore &store, size_t slot) const;
+
+        // Function to copy every face of the cached map, and of its moment map when both exist, into the target cube maps
+        void copyTo(GLuint targetCubeMap, GLuint targetMomentMap) const;
+
+        // Number of cube faces rendered into the cached map
+        unsigned int updateCount() const { return updates; }
+
+        // Faces whose cached content is out of date
+        unsigned char pendingFaces() const { return staleFaces; }
+
+    private:
+        GLuint cubeMap;
+        GLuint momentMap; // Only allocated for exponential filtering
+        GLuint fbo;
+        GLuint readFBO, drawFBO; // Single face attachments used by copyTo()
+        int resolution;
+        unsigned char staleFaces;
+        unsigned char emptyFaces;             // Faces not rendered since the map was allocated
+        unsigned int faceAge[CUBE_FACES];     // Frames each stale face has waited
+        int facesPerFrame;
+        ShadowUpdateOrder order;
+        glm::vec3 cachedLightPos;
+        std::vector<unsigned char> dynamicIds; // Indexed by ObjectId
+        std::vector<unsigned char> casterFaces; // Faces each static caster is cached in, indexed by ObjectId
+        unsigned int updates;
+    };
+
+    // Function to (re)allocate the shadow map and the static cache at a tier and print their video memory.
+    // momentCubeMap is only allocated, and attached to shadowMapFBO, for exponential filtering and is 0 otherwise.
+    void allocateShadowMaps(const ShadowTier &tier, GLuint &depthCubeMap, GLuint &momentCubeMap, GLuint &shadowMapFBO, StaticShadowCache &staticCache);
+
+} // namespace utils_shadow
+
+#endif // SHADOW_HPP
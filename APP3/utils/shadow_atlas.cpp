@@ -0,0 +1,321 @@
+// shadow_atlas.cpp
+#include "shadow_atlas.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace utils_shadow
+{
+
+    // Near plane of the atlas faces
+    static const float SHADOW_ATLAS_NEAR = 0.05f;
+
+    // Ranking bonus of a light already holding a slot, avoids trading slots back and forth between close scores
+    static const float SLOT_KEEP_BONUS = 1.25f;
+
+    ShadowAtlas::ShadowAtlas()
+        : texture(0), fbo(0), buffer(0), facesRendered(0)
+    {
+        for (int s = 0; s < MAX_SHADOWED_LIGHTS; ++s)
+        {
+            slots[s].light = -1;
+            slots[s].handle = utils_light::INVALID_LIGHT_HANDLE;
+            slots[s].renderedFaces = 0;
+        }
+    }
+
+    void ShadowAtlas::create()
+    {
+        release();
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "Shadow atlas framebuffer not complete!" << std::endl;
+        }
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowAtlasData), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_ATLAS_BINDING, buffer);
+
+        for (int s = 0; s < MAX_SHADOWED_LIGHTS; ++s)
+        {
+            slots[s].light = -1;
+            slots[s].handle = utils_light::INVALID_LIGHT_HANDLE;
+            slots[s].renderedFaces = 0;
+        }
+        publishedSlots.clear();
+
+        double megabytes = 4.0 * SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE / (1024.0 * 1024.0);
+        std::cout << "Shadow atlas: " << SHADOW_ATLAS_SIZE << "x" << SHADOW_ATLAS_SIZE << ", " << MAX_SHADOWED_LIGHTS
+                  << " light slots of " << SHADOW_ATLAS_TILE << "x" << SHADOW_ATLAS_TILE << " faces, "
+                  << megabytes << " MB of video memory" << std::endl;
+    }
+
+    void ShadowAtlas::release()
+    {
+        if (texture != 0)
+        {
+            glDeleteTextures(1, &texture);
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteBuffers(1, &buffer);
+            texture = fbo = buffer = 0;
+        }
+    }
+
+    void ShadowAtlas::assignSlots(const utils_light::LightRegistry &registry, int lightCount,
+                                  const glm::vec3 &cameraPos, const utils_scene::CellGraph &visibility)
+    {
+        const std::vector<utils_light::SimplePointLight> &lights = registry.lights();
+        lightCount = std::min(lightCount, static_cast<int>(lights.size()));
+
+        // Find the lights holding slots where they are this frame, slots of removed lights are freed below
+        std::vector<int> lightToSlot(lightCount, -1);
+        for (int s = 0; s < MAX_SHADOWED_LIGHTS; ++s)
+        {
+            if (slots[s].light < 0)
+            {
+                continue;
+            }
+            slots[s].light = registry.contains(slots[s].handle) ? static_cast<int>(registry.slotOf(slots[s].handle)) : lightCount;
+            if (slots[s].light < lightCount)
+            {
+                lightToSlot[slots[s].light] = s;
+            }
+        }
+
+        // Rank the lights whose reach is seen through the visible cells by the size of that reach as seen from the camera
+        std::vector<std::pair<float, int> > ranked;
+        for (int i = 0; i < lightCount; ++i)
+        {
+            if (!(registry.flagsAt(i) & utils_light::LIGHT_SHADOWED))
+            {
+                continue;
+            }
+            float radius = lights[i].radius;
+            AABB reach(lights[i].position - glm::vec3(radius), lights[i].position + glm::vec3(radius));
+            if (!visibility.isVisible(reach))
+            {
+                continue;
+            }
+            float score = radius / std::max(glm::length(lights[i].position - cameraPos), 1.0f);
+            if (lightToSlot[i] >= 0)
+            {
+                score *= SLOT_KEEP_BONUS;
+            }
+            ranked.push_back(std::make_pair(score, i));
+        }
+        size_t kept = std::min(ranked.size(), static_cast<size_t>(MAX_SHADOWED_LIGHTS));
+        std::partial_sort(ranked.begin(), ranked.begin() + kept, ranked.end(),
+                          [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+                          { return a.first > b.first; });
+
+        std::vector<unsigned char> keep(lightCount, 0);
+        for (size_t r = 0; r < kept; ++r)
+        {
+            keep[ranked[r].second] = 1;
+        }
+
+        // Free the slots of lights that dropped out, their tiles are simply overwritten later
+        for (int s = 0; s < MAX_SHADOWED_LIGHTS; ++s)
+        {
+            if (slots[s].light >= 0 && (slots[s].light >= lightCount || !keep[slots[s].light]))
+            {
+                slots[s].light = -1;
+                slots[s].renderedFaces = 0;
+            }
+        }
+
+        for (size_t r = 0; r < kept; ++r)
+        {
+            int light = ranked[r].second;
+            int s = lightToSlot[light];
+            if (s < 0 || slots[s].light != light)
+            {
+                // At most MAX_SHADOWED_LIGHTS lights are kept, so a slot is free
+                s = 0;
+                while (slots[s].light >= 0)
+                {
+                    ++s;
+                }
+                slots[s].light = light;
+                slots[s].handle = registry.handleAt(light);
+                slots[s].renderedFaces = 0;
+                for (int face = 0; face < CUBE_FACES; ++face)
+                {
+                    slots[s].faceAge[face] = 0;
+                }
+            }
+            slots[s].position = lights[light].position;
+            slots[s].range = lights[light].radius;
+            slots[s].score = ranked[r].first;
+        }
+
+        publishedSlots.assign(lightCount, -1);
+    }
+
+    unsigned char ShadowAtlas::staleFaces(const Slot &slot) const
+    {
+        unsigned char stale = 0;
+        for (int face = 0; face < CUBE_FACES; ++face)
+        {
+            unsigned char bit = static_cast<unsigned char>(1u << face);
+            if (!(slot.renderedFaces & bit) || glm::length(slot.position - slot.facePosition[face]) > SHADOW_ATLAS_MOVE_TOLERANCE)
+            {
+                stale |= bit;
+            }
+        }
+        return stale;
+    }
+
+    void ShadowAtlas::render(const utils_loader::Shader &depthShader, const utils_scene::SceneStore &casters)
+    {
+        facesRendered = 0;
+
+        // Most urgent faces first, a light's score weighted by how long the face has waited
+        std::vector<std::pair<float, int> > pending;
+        for (int s = 0; s < MAX_SHADOWED_LIGHTS; ++s)
+        {
+            if (slots[s].light < 0)
+            {
+                continue;
+            }
+            unsigned char stale = staleFaces(slots[s]);
+            for (int face = 0; face < CUBE_FACES; ++face)
+            {
+                if (stale & (1u << face))
+                {
+                    slots[s].faceAge[face]++;
+                    pending.push_back(std::make_pair(slots[s].score * slots[s].faceAge[face], s * CUBE_FACES + face));
+                }
+            }
+        }
+        size_t budget = std::min(pending.size(), static_cast<size_t>(SHADOW_ATLAS_FACES_PER_FRAME));
+        std::partial_sort(pending.begin(), pending.begin() + budget, pending.end(),
+                          [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+                          { return a.first > b.first; });
+        // Group the faces of a light so its face masks are computed once
+        std::sort(pending.begin(), pending.begin() + budget,
+                  [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+                  { return a.second < b.second; });
+
+        if (budget > 0)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glEnable(GL_SCISSOR_TEST);
+
+            depthShader.use();
+            GLint farPlaneLocation = depthShader.getUniformLocation(utils_loader::Uniform::FarPlane);
+            GLint lightPosLocation = depthShader.getUniformLocation(utils_loader::Uniform::LightPos);
+            GLint shadowMatrixLocation = depthShader.getUniformLocation(utils_loader::Uniform::ShadowMatrix);
+            GLint modelLocation = depthShader.getUniformLocation(utils_loader::Uniform::Model);
+            GLint instancingLocation = depthShader.getUniformLocation(utils_loader::Uniform::UseInstancing);
+
+            int currentSlot = -1;
+            glm::mat4 faceMatrices[CUBE_FACES];
+            for (size_t p = 0; p < budget; ++p)
+            {
+                int tile = pending[p].second;
+                int s = tile / CUBE_FACES;
+                int face = tile % CUBE_FACES;
+                Slot &slot = slots[s];
+
+                if (s != currentSlot)
+                {
+                    currentSlot = s;
+                    glm::mat4 faceProj = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_ATLAS_NEAR, slot.range);
+                    computeCubeFaceMatrices(slot.position, faceProj, faceMatrices);
+                    computeFaceMasks(casters, faceMatrices, faceMasks);
+                    glUniform1f(farPlaneLocation, slot.range);
+                    glUniform3fv(lightPosLocation, 1, glm::value_ptr(slot.position));
+                }
+
+                int x = (tile % SHADOW_ATLAS_TILES_PER_ROW) * SHADOW_ATLAS_TILE;
+                int y = (tile / SHADOW_ATLAS_TILES_PER_ROW) * SHADOW_ATLAS_TILE;
+                glViewport(x, y, SHADOW_ATLAS_TILE, SHADOW_ATLAS_TILE);
+                glScissor(x, y, SHADOW_ATLAS_TILE, SHADOW_ATLAS_TILE);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                glUniformMatrix4fv(shadowMatrixLocation, 1, GL_FALSE, glm::value_ptr(faceMatrices[face]));
+
+                for (size_t c = 0; c < casters.size(); ++c)
+                {
+                    const AABB &box = casters.bounds[c];
+                    // A lamp enclosing its light would shadow everything around it
+                    bool enclosesLight = glm::all(glm::greaterThanEqual(slot.position, box.min)) && glm::all(glm::lessThanEqual(slot.position, box.max));
+                    if (!(faceMasks[c] & (1u << face)) || enclosesLight)
+                    {
+                        continue;
+                    }
+                    const utils_scene::RenderItem &item = casters.renderItems[c];
+                    glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(casters.worldMatrices[c]));
+                    glUniform1f(instancingLocation, item.instanceCount > 0 ? 1.0f : 0.0f);
+                    utils_scene::drawRenderItem(item);
+                }
+
+                slot.facePosition[face] = slot.position;
+                slot.renderedFaces |= static_cast<unsigned char>(1u << face);
+                slot.faceAge[face] = 0;
+                data.faceMatrices[tile] = faceMatrices[face];
+                data.faceLights[tile] = glm::vec4(slot.position, slot.range);
+                facesRendered++;
+            }
+
+            glDisable(GL_SCISSOR_TEST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        // Lights are only shadowed once all their faces exist
+        for (int s = 0; s < MAX_SHADOWED_LIGHTS; ++s)
+        {
+            const Slot &slot = slots[s];
+            if (slot.light >= 0 && slot.light < static_cast<int>(publishedSlots.size()) && slot.renderedFaces == ALL_CUBE_FACES)
+            {
+                publishedSlots[slot.light] = s;
+                data.lights[s] = glm::vec4(slot.position, slot.range);
+            }
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowAtlasData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void ShadowAtlas::bindTexture(GLenum unit) const
+    {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    void ShadowAtlas::bindBlock(const utils_loader::Shader &shader)
+    {
+        GLuint index = shader.getUniformBlockIndex("ShadowAtlasData");
+        if (index == GL_INVALID_INDEX)
+        {
+            std::cerr << "Failed to find the ShadowAtlasData uniform block in program " << shader.getGLId() << std::endl;
+            return;
+        }
+        glUniformBlockBinding(shader.getGLId(), index, SHADOW_ATLAS_BINDING);
+    }
+
+} // namespace utils_shadow
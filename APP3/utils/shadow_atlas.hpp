@@ -0,0 +1,101 @@
+// shadow_atlas.hpp
+#ifndef SHADOW_ATLAS_HPP
+#define SHADOW_ATLAS_HPP
+
+#include "shadow.hpp"
+#include "light_registry.hpp"
+#include "portal_visibility.hpp"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace utils_shadow
+{
+
+    // Uniform buffer binding point of the ShadowAtlasData block of the room shaders
+    const GLuint SHADOW_ATLAS_BINDING = 3;
+
+    // Texel budget of the additional light shadows: one square depth texture split in square cube face tiles
+    const int SHADOW_ATLAS_SIZE = 2048;
+    const int SHADOW_ATLAS_TILE = 256;
+    const int SHADOW_ATLAS_TILES_PER_ROW = SHADOW_ATLAS_SIZE / SHADOW_ATLAS_TILE;
+
+    // Lights holding a slot of six tiles, MAX_SHADOWED_LIGHTS of the room shaders
+    const int MAX_SHADOWED_LIGHTS = SHADOW_ATLAS_TILES_PER_ROW * SHADOW_ATLAS_TILES_PER_ROW / CUBE_FACES;
+
+    // Faces rendered into the atlas per frame at most, stale faces beyond it wait for the next frames
+    const int SHADOW_ATLAS_FACES_PER_FRAME = 12;
+
+    // Distance a light may drift from where a face was rendered before the face is stale
+    const float SHADOW_ATLAS_MOVE_TOLERANCE = 0.05f;
+
+    // Mirror of the ShadowAtlasData block (std140)
+    struct ShadowAtlasData
+    {
+        glm::mat4 faceMatrices[MAX_SHADOWED_LIGHTS * CUBE_FACES]; // View-projection each tile was rendered with
+        glm::vec4 faceLights[MAX_SHADOWED_LIGHTS * CUBE_FACES];   // xyz light position each tile was rendered from, w far plane
+        glm::vec4 lights[MAX_SHADOWED_LIGHTS];                    // xyz light position used to pick the face of a lookup
+    };
+
+    // Shadow atlas of the additional point lights. Lights are ranked by their influence on screen, the best
+    // MAX_SHADOWED_LIGHTS keep a slot of six tiles, and stale tiles are re-rendered within a per-frame budget.
+    class ShadowAtlas
+    {
+    public:
+        ShadowAtlas();
+
+        // Function to allocate the atlas texture, its framebuffer and uniform buffer, and print their video memory
+        void create();
+
+        // Function to delete the atlas texture, framebuffer and uniform buffer
+        void release();
+
+        // Function to rank the first lightCount lights flagged LIGHT_SHADOWED whose reach is visible and hand out the slots,
+        // lights keeping their rank keep their slot and tiles (slots follow light handles, so they survive lights moving
+        // in the registry)
+        void assignSlots(const utils_light::LightRegistry &registry, int lightCount,
+                         const glm::vec3 &cameraPos, const utils_scene::CellGraph &visibility);
+
+        // Function to re-render the most urgent stale faces with the per-face depth shader and upload the tile data
+        void render(const utils_loader::Shader &depthShader, const utils_scene::SceneStore &casters);
+
+        // Atlas slot of each light, -1 while the light is unshadowed or its six faces are not all rendered yet
+        const std::vector<int> &lightSlots() const { return publishedSlots; }
+
+        // Function to bind the atlas to a texture unit
+        void bindTexture(GLenum unit) const;
+
+        // Function to point the ShadowAtlasData block of a program at SHADOW_ATLAS_BINDING
+        static void bindBlock(const utils_loader::Shader &shader);
+
+        // Faces rendered by the last render() call
+        unsigned int lastFaceCount() const { return facesRendered; }
+
+    private:
+        struct Slot
+        {
+            int light;                        // Registry slot of the light this frame, -1 when free
+            utils_light::LightHandle handle;  // Light holding the slot
+            glm::vec3 position;               // Current light position
+            float range;                      // Current far plane
+            float score;
+            glm::vec3 facePosition[CUBE_FACES]; // Light position each face was rendered from
+            unsigned char renderedFaces;      // Faces holding a render of this light
+            unsigned int faceAge[CUBE_FACES]; // Frames each stale face has waited
+        };
+
+        unsigned char staleFaces(const Slot &slot) const;
+
+        GLuint texture;
+        GLuint fbo;
+        GLuint buffer;
+        Slot slots[MAX_SHADOWED_LIGHTS];
+        std::vector<int> publishedSlots;
+        ShadowAtlasData data;
+        std::vector<unsigned char> faceMasks;
+        unsigned int facesRendered;
+    };
+
+} // namespace utils_shadow
+
+#endif // SHADOW_ATLAS_HPP
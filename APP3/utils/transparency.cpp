@@ -0,0 +1,128 @@
+// transparency.cpp
+#include "transparency.hpp"
+#include <iostream>
+
+namespace utils_scene
+{
+
+    WeightedTransparency::WeightedTransparency()
+        : fbo(0), accumulation(0), weights(0), depth(0), emptyVAO(0), width(0), height(0)
+    {
+    }
+
+    // Function to allocate one screen sized texture, sampled texel for texel
+    static GLuint createTarget(GLint internalFormat, GLenum format, GLenum type, int width, int height)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void WeightedTransparency::create(int targetWidth, int targetHeight)
+    {
+        release();
+        width = targetWidth;
+        height = targetHeight;
+
+        accumulation = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+        weights = createTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+        depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weights, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "Transparency framebuffer not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // Core profile draws need a vertex array even without attributes
+        glGenVertexArrays(1, &emptyVAO);
+
+        double megabytes = (8.0 + 8.0 + 4.0) * width * height / (1024.0 * 1024.0);
+        std::cout << "Transparency targets: " << width << "x" << height << ", " << megabytes << " MB of video memory" << std::endl;
+    }
+
+    void WeightedTransparency::release()
+    {
+        if (fbo != 0)
+        {
+            glDeleteFramebuffers(1, &fbo);
+            fbo = 0;
+        }
+        GLuint *textures[3] = {&accumulation, &weights, &depth};
+        for (GLuint *texture : textures)
+        {
+            if (*texture != 0)
+            {
+                glDeleteTextures(1, texture);
+                *texture = 0;
+            }
+        }
+        if (emptyVAO != 0)
+        {
+            glDeleteVertexArrays(1, &emptyVAO);
+            emptyVAO = 0;
+        }
+    }
+
+    void WeightedTransparency::beginAccumulation() const
+    {
+        // Transparent fragments behind the opaque frame are rejected by its depth, copied rather than blitted so
+        // the format of the default depth buffer does not matter
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+
+        // Nothing accumulated and everything revealed
+        const GLfloat empty[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, empty);
+        glClearBufferfv(GL_COLOR, 1, zero);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    void WeightedTransparency::composite(const utils_loader::Shader &compositeShader) const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+
+        compositeShader.use();
+        glActiveTexture(GL_TEXTURE0 + TRANSPARENCY_FIRST_UNIT);
+        glBindTexture(GL_TEXTURE_2D, accumulation);
+        glActiveTexture(GL_TEXTURE0 + TRANSPARENCY_FIRST_UNIT + 1);
+        glBindTexture(GL_TEXTURE_2D, weights);
+        glActiveTexture(GL_TEXTURE0);
+
+        glDisable(GL_DEPTH_TEST);
+        glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+} // namespace utils_scene
@@ -0,0 +1,49 @@
+// transparency.hpp
+#ifndef TRANSPARENCY_HPP
+#define TRANSPARENCY_HPP
+
+#include "gbuffer.hpp"
+#include "shader.hpp"
+#include <glad/glad.h>
+
+namespace utils_scene
+{
+
+    // Texture units of the accumulation and weight targets in the composite pass, after the G-buffer and its depth
+    const int TRANSPARENCY_FIRST_UNIT = GBUFFER_FIRST_UNIT + static_cast<int>(GBufferTarget::Count) + 1;
+
+    // Targets of weighted blended order-independent transparency. Every transparent fragment adds its premultiplied
+    // color times a depth weight to the accumulation target and multiplies its revealage (alpha channel) by one minus
+    // its coverage; the weights are summed per channel in a second target. OpenGL 3.3 has a single blend state for
+    // every draw buffer, so both targets share (ONE, ONE) on color and (ZERO, ONE_MINUS_SRC_ALPHA) on alpha.
+    class WeightedTransparency
+    {
+    public:
+        WeightedTransparency();
+
+        // Function to allocate the targets at the window size and print their video memory
+        void create(int width, int height);
+
+        // Function to delete the targets and the framebuffer
+        void release();
+
+        // Function to copy the depth of the default framebuffer, clear the targets and set the accumulation
+        // blending; depth writes are disabled, the transparent objects are then drawn in any order
+        void beginAccumulation() const;
+
+        // Function to blend the averaged transparent color over the default framebuffer and restore the usual
+        // blending and depth state
+        void composite(const utils_loader::Shader &compositeShader) const;
+
+    private:
+        GLuint fbo;
+        GLuint accumulation; // RGBA16F
+        GLuint weights;      // RGBA16F
+        GLuint depth;
+        GLuint emptyVAO;
+        int width, height;
+    };
+
+} // namespace utils_scene
+
+#endif // TRANSPARENCY_HPP
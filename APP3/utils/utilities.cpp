@@ -1,5 +1,6 @@
 #include "utilities.hpp"
 #include "global.hpp"
+#include "shadow.hpp"
 
 
 #include <glm/glm.hpp>
@@ -74,6 +75,11 @@ void eventHandler(glimac::SDLWindowManager &windowManager, bool &done, bool &isR
             {
                 isLightPaused = !isLightPaused;
             }
+            else if (e.key.keysym.sym == SDLK_u)
+            {
+                shadowTier = (shadowTier + 1) % utils_shadow::SHADOW_TIER_COUNT;
+                shadowTierChanged = true;
+            }
         }
 
         // Mouse movement
@@ -52,8 +52,14 @@ private:
 // Build a GLSL program from source code
 Program buildProgram(const GLchar* vsSrc, const GLchar* fsSrc);
 
+// Build a GLSL program with a geometry stage from source code
+Program buildProgram(const GLchar* vsSrc, const GLchar* gsSrc, const GLchar* fsSrc);
+
 // Load source code from files and build a GLSL program
 Program loadProgram(const FilePath& vsFile, const FilePath& fsFile);
 
+// Load source code from files and build a GLSL program with a geometry stage
+Program loadProgram(const FilePath& vsFile, const FilePath& gsFile, const FilePath& fsFile);
+
 
 }
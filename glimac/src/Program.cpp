@@ -47,6 +47,41 @@ Program buildProgram(const GLchar* vsSrc, const GLchar* fsSrc) {
 	return program;
 }
 
+// Build a GLSL program with a geometry stage from source code
+Program buildProgram(const GLchar* vsSrc, const GLchar* gsSrc, const GLchar* fsSrc) {
+	Shader vs(GL_VERTEX_SHADER);
+	vs.setSource(vsSrc);
+
+	if(!vs.compile()) {
+		throw std::runtime_error("Compilation error for vertex shader: " + vs.getInfoLog());
+	}
+
+	Shader gs(GL_GEOMETRY_SHADER);
+	gs.setSource(gsSrc);
+
+	if(!gs.compile()) {
+		throw std::runtime_error("Compilation error for geometry shader: " + gs.getInfoLog());
+	}
+
+	Shader fs(GL_FRAGMENT_SHADER);
+	fs.setSource(fsSrc);
+
+	if(!fs.compile()) {
+		throw std::runtime_error("Compilation error for fragment shader: " + fs.getInfoLog());
+	}
+
+	Program program;
+	program.attachShader(vs);
+	program.attachShader(gs);
+	program.attachShader(fs);
+
+	if(!program.link()) {
+		throw std::runtime_error("Link error: " + program.getInfoLog());
+	}
+
+	return program;
+}
+
 // Load source code from files and build a GLSL program
 Program loadProgram(const FilePath& vsFile, const FilePath& fsFile) {
 	Shader vs = loadShader(GL_VERTEX_SHADER, vsFile);
@@ -71,4 +106,34 @@ Program loadProgram(const FilePath& vsFile, const FilePath& fsFile) {
 	return program;
 }
 
+// Load source code from files and build a GLSL program with a geometry stage
+Program loadProgram(const FilePath& vsFile, const FilePath& gsFile, const FilePath& fsFile) {
+	Shader vs = loadShader(GL_VERTEX_SHADER, vsFile);
+	Shader gs = loadShader(GL_GEOMETRY_SHADER, gsFile);
+	Shader fs = loadShader(GL_FRAGMENT_SHADER, fsFile);
+
+	if(!vs.compile()) {
+		throw std::runtime_error("Compilation error for vertex shader (from file " + std::string(vsFile) + "): " + vs.getInfoLog());
+	}
+
+	if(!gs.compile()) {
+		throw std::runtime_error("Compilation error for geometry shader (from file " + std::string(gsFile) + "): " + gs.getInfoLog());
+	}
+
+	if(!fs.compile()) {
+		throw std::runtime_error("Compilation error for fragment shader (from file " + std::string(fsFile) + "): " + fs.getInfoLog());
+	}
+
+	Program program;
+	program.attachShader(vs);
+	program.attachShader(gs);
+	program.attachShader(fs);
+
+	if(!program.link()) {
+        throw std::runtime_error("Link error (for files " + vsFile.str() + ", " + gsFile.str() + " and " + fsFile.str() + "): " + program.getInfoLog());
+	}
+
+	return program;
+}
+
 }